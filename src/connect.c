@@ -42,6 +42,45 @@ static virConnectAuth virtDBusConnectAuth = {
     NULL,
 };
 
+/* Maximum age of cached XML descriptions in microseconds.  Domains and
+ * networks are invalidated by events, allocation of storage pools and
+ * volumes changes all the time without any. */
+#define VIRT_DBUS_CONNECT_XML_CACHE_MAX_AGE (10 * 60 * G_USEC_PER_SEC)
+#define VIRT_DBUS_CONNECT_STORAGE_XML_CACHE_MAX_AGE (5 * G_USEC_PER_SEC)
+
+/* Lifetime of cached host information in microseconds.  Versions, host
+ * name and security model change only together with the daemon which
+ * flushes the cache by reconnecting, capabilities report host resources
+ * which may be changed at runtime. */
+#define VIRT_DBUS_CONNECT_HOST_CACHE_TTL (10 * 60 * G_USEC_PER_SEC)
+#define VIRT_DBUS_CONNECT_CAPABILITIES_CACHE_TTL (60 * G_USEC_PER_SEC)
+
+static void
+virtDBusConnectClearCaches(virtDBusConnect *connect)
+{
+    virtDBusUtilHandleCacheClear(connect->domainCache);
+    virtDBusUtilHandleCacheClear(connect->domainSnapshotCache);
+    virtDBusUtilHandleCacheClear(connect->interfaceCache);
+    virtDBusUtilHandleCacheClear(connect->networkCache);
+    virtDBusUtilHandleCacheClear(connect->nodeDevCache);
+    virtDBusUtilHandleCacheClear(connect->nwfilterCache);
+    virtDBusUtilHandleCacheClear(connect->secretCache);
+    virtDBusUtilHandleCacheClear(connect->storagePoolCache);
+    virtDBusUtilHandleCacheClear(connect->storageVolCache);
+
+    virtDBusUtilXMLCacheClear(connect->domainXMLCache);
+    virtDBusUtilXMLCacheClear(connect->networkXMLCache);
+    virtDBusUtilXMLCacheClear(connect->storagePoolXMLCache);
+    virtDBusUtilXMLCacheClear(connect->storageVolXMLCache);
+
+    virtDBusStatsCacheClear(connect->statsCache);
+
+    virtDBusDomainStateClear(connect);
+    virtDBusDomainAgentCacheClear(connect);
+
+    virtDBusGDBusFlushCache(connect->connectPath);
+}
+
 static void
 virtDBusConnectClose(virtDBusConnect *connect,
                      gboolean deregisterEvents)
@@ -97,6 +136,8 @@ virtDBusConnectClose(virtDBusConnect *connect,
         }
     }
 
+    virtDBusConnectClearCaches(connect);
+
     virConnectClose(connect->connection);
     connect->connection = NULL;
 }
@@ -126,6 +167,19 @@ virtDBusConnectOpen(virtDBusConnect *connect,
 
     virtDBusEventsRegister(connect);
 
+    /* Objects may have changed while we were not receiving events.  The
+     * first invalidation also enables background refreshes of the subtree
+     * so that they never open the connection themselves. */
+    virtDBusGDBusInvalidateSubtree(connect->domainPath);
+    virtDBusGDBusInvalidateSubtree(connect->domainSnapshotPath);
+    virtDBusGDBusInvalidateSubtree(connect->interfacePath);
+    virtDBusGDBusInvalidateSubtree(connect->networkPath);
+    virtDBusGDBusInvalidateSubtree(connect->nodeDevPath);
+    virtDBusGDBusInvalidateSubtree(connect->nwfilterPath);
+    virtDBusGDBusInvalidateSubtree(connect->secretPath);
+    virtDBusGDBusInvalidateSubtree(connect->storagePoolPath);
+    virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
     return TRUE;
 }
 
@@ -248,6 +302,34 @@ virtDBusConnectGetCapabilities(GVariant *inArgs G_GNUC_UNUSED,
     *outArgs = g_variant_new("(s)", capabilities);
 }
 
+static void
+virtDBusConnectAddThresholdRule(GVariant *inArgs,
+                                GUnixFDList *inFDs G_GNUC_UNUSED,
+                                const gchar *objectPath G_GNUC_UNUSED,
+                                gpointer userData,
+                                GVariant **outArgs,
+                                GUnixFDList **outFDs G_GNUC_UNUSED,
+                                GError **error)
+{
+    virtDBusConnect *connect = userData;
+    const gchar *metric;
+    const gchar *comparison;
+    gdouble threshold;
+    guint hold;
+    guint id;
+
+    g_variant_get(inArgs, "(&s&sdu)", &metric, &comparison, &threshold, &hold);
+
+    id = virtDBusSamplerAddThresholdRule(connect->sampler,
+                                         virtDBusGDBusGetSender(),
+                                         metric, comparison, threshold,
+                                         hold, error);
+    if (id == 0)
+        return;
+
+    *outArgs = g_variant_new("(u)", id);
+}
+
 static void
 virtDBusConnectBaselineCPU(GVariant *inArgs,
                            GUnixFDList *inFDs G_GNUC_UNUSED,
@@ -285,6 +367,28 @@ virtDBusConnectBaselineCPU(GVariant *inArgs,
     *outArgs = g_variant_new("(s)", cpu);
 }
 
+static void
+virtDBusConnectBatch(GVariant *inArgs,
+                     GUnixFDList *inFDs G_GNUC_UNUSED,
+                     const gchar *objectPath G_GNUC_UNUSED,
+                     gpointer userData,
+                     GVariant **outArgs,
+                     GUnixFDList **outFDs G_GNUC_UNUSED,
+                     GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(GVariant) calls = NULL;
+    GVariant *results;
+
+    g_variant_get(inArgs, "(@a(osssav))", &calls);
+
+    results = virtDBusGDBusCallBatch(calls, connect->connectPath, error);
+    if (!results)
+        return;
+
+    *outArgs = g_variant_new_tuple(&results, 1);
+}
+
 static void
 virtDBusConnectCompareCPU(GVariant *inArgs,
                           GUnixFDList *inFDs G_GNUC_UNUSED,
@@ -513,6 +617,10 @@ virtDBusConnectDomainRestoreFlags(GVariant *inArgs,
 
     if (virDomainRestoreFlags(connect->connection, from, xml, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    /* The restored domain is only known from the saved image. */
+    virtDBusDomainStateClear(connect);
+    virtDBusUtilXMLCacheClear(connect->domainXMLCache);
 }
 
 static void
@@ -594,29 +702,23 @@ virtDBusConnectFindStoragePoolSources(GVariant *inArgs,
 }
 
 static void
-virtDBusConnectGetAllDomainStats(GVariant *inArgs,
-                                 GUnixFDList *inFDs G_GNUC_UNUSED,
-                                 const gchar *objectPath G_GNUC_UNUSED,
-                                 gpointer userData,
-                                 GVariant **outArgs,
-                                 GUnixFDList **outFDs G_GNUC_UNUSED,
-                                 GError **error)
+virtDBusConnectAllDomainStats(virtDBusConnect *connect,
+                              guint stats,
+                              guint flags,
+                              const gchar *const *fields,
+                              GVariant **outArgs,
+                              GError **error)
 {
-    virtDBusConnect *connect = userData;
     g_autoptr(virDomainStatsRecordPtr) records = NULL;
-    guint stats;
     gint nstats;
-    guint flags;
     GVariant *gret;
     GVariantBuilder builder;
 
-    g_variant_get(inArgs, "(uu)", &stats, &flags);
-
     if (!virtDBusConnectOpen(connect, error))
         return;
 
-    nstats = virConnectGetAllDomainStats(connect->connection,
-                                         stats, &records, flags);
+    nstats = virtDBusStatsGetAllDomainStats(connect->connection,
+                                            stats, &records, flags);
     if (nstats < 0)
         return virtDBusUtilSetLastVirtError(error);
 
@@ -628,8 +730,9 @@ virtDBusConnectGetAllDomainStats(GVariant *inArgs,
 
         g_variant_builder_open(&builder, G_VARIANT_TYPE("(sa{sv})"));
         name = virDomainGetName(records[i]->dom);
-        grecords = virtDBusUtilTypedParamsToGVariant(records[i]->params,
-                                                     records[i]->nparams);
+        grecords = virtDBusStatsRecordToGVariant(connect->statsCache,
+                                                 records[i], stats, flags,
+                                                 fields);
         g_variant_builder_add(&builder, "s", name);
         g_variant_builder_add_value(&builder, grecords);
         g_variant_builder_close(&builder);
@@ -639,6 +742,147 @@ virtDBusConnectGetAllDomainStats(GVariant *inArgs,
     *outArgs = g_variant_new_tuple(&gret, 1);
 }
 
+static void
+virtDBusConnectGetAllDomainStats(GVariant *inArgs,
+                                 GUnixFDList *inFDs G_GNUC_UNUSED,
+                                 const gchar *objectPath G_GNUC_UNUSED,
+                                 gpointer userData,
+                                 GVariant **outArgs,
+                                 GUnixFDList **outFDs G_GNUC_UNUSED,
+                                 GError **error)
+{
+    virtDBusConnect *connect = userData;
+    guint stats;
+    guint flags;
+
+    g_variant_get(inArgs, "(uu)", &stats, &flags);
+
+    virtDBusConnectAllDomainStats(connect, stats, flags, NULL, outArgs, error);
+}
+
+static void
+virtDBusConnectGetAllDomainStatsFields(GVariant *inArgs,
+                                       GUnixFDList *inFDs G_GNUC_UNUSED,
+                                       const gchar *objectPath G_GNUC_UNUSED,
+                                       gpointer userData,
+                                       GVariant **outArgs,
+                                       GUnixFDList **outFDs G_GNUC_UNUSED,
+                                       GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autofree const gchar **fields = NULL;
+    guint stats;
+    guint flags;
+
+    g_variant_get(inArgs, "(uu^a&s)", &stats, &flags, &fields);
+
+    virtDBusConnectAllDomainStats(connect, stats, flags, fields, outArgs, error);
+}
+
+/* Flags of virConnectGetAllDomainStats selecting the domains, they have
+ * the same values as the flags of virConnectListAllDomains. */
+#define VIRT_DBUS_CONNECT_DOMAIN_STATS_FILTERS \
+    (VIR_CONNECT_GET_ALL_DOMAINS_STATS_ACTIVE | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_INACTIVE | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_PERSISTENT | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_TRANSIENT | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_RUNNING | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_PAUSED | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_SHUTOFF | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_OTHER)
+
+static gint
+virtDBusConnectCompareDomainNames(gconstpointer a,
+                                  gconstpointer b)
+{
+    virDomainPtr domainA = *(virDomainPtr *)a;
+    virDomainPtr domainB = *(virDomainPtr *)b;
+
+    return g_strcmp0(virDomainGetName(domainA), virDomainGetName(domainB));
+}
+
+static void
+virtDBusConnectGetAllDomainStatsPage(GVariant *inArgs,
+                                     GUnixFDList *inFDs G_GNUC_UNUSED,
+                                     const gchar *objectPath G_GNUC_UNUSED,
+                                     gpointer userData,
+                                     GVariant **outArgs,
+                                     GUnixFDList **outFDs G_GNUC_UNUSED,
+                                     GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virDomainPtr) domains = NULL;
+    g_autoptr(virDomainStatsRecordPtr) records = NULL;
+    g_autofree const gchar **fields = NULL;
+    virDomainPtr end;
+    const gchar *cursor;
+    const gchar *nextCursor = "";
+    guint stats;
+    guint flags;
+    guint count;
+    gint ndomains;
+    gint nstats = 0;
+    gint first = 0;
+    gint last;
+    GVariantBuilder builder;
+
+    g_variant_get(inArgs, "(uu&su^a&s)", &stats, &flags, &cursor, &count,
+                  &fields);
+
+    if (count == 0) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "count of domains per page must not be 0");
+        return;
+    }
+
+    if (!virtDBusConnectOpen(connect, error))
+        return;
+
+    ndomains = virConnectListAllDomains(connect->connection, &domains,
+                                        flags & VIRT_DBUS_CONNECT_DOMAIN_STATS_FILTERS);
+    if (ndomains < 0)
+        return virtDBusUtilSetLastVirtError(error);
+
+    qsort(domains, ndomains, sizeof(virDomainPtr),
+          virtDBusConnectCompareDomainNames);
+
+    while (cursor[0] && first < ndomains &&
+           g_strcmp0(virDomainGetName(domains[first]), cursor) <= 0) {
+        first++;
+    }
+    last = MIN(first + (gint64)count, ndomains);
+
+    /* Only the domains of this page are asked for stats, the list is
+     * terminated temporarily after the last one. */
+    if (first < last) {
+        end = domains[last];
+        domains[last] = NULL;
+        nstats = virtDBusStatsListGetStats(domains + first, stats, &records,
+                                           flags & ~VIRT_DBUS_CONNECT_DOMAIN_STATS_FILTERS);
+        domains[last] = end;
+        if (nstats < 0)
+            return virtDBusUtilSetLastVirtError(error);
+
+        if (last < ndomains)
+            nextCursor = virDomainGetName(domains[last - 1]);
+    }
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sa{sv})"));
+
+    for (gint i = 0; i < nstats; i++) {
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("(sa{sv})"));
+        g_variant_builder_add(&builder, "s", virDomainGetName(records[i]->dom));
+        g_variant_builder_add_value(&builder,
+                                    virtDBusStatsRecordToGVariant(connect->statsCache,
+                                                                  records[i],
+                                                                  stats, flags,
+                                                                  fields));
+        g_variant_builder_close(&builder);
+    }
+
+    *outArgs = g_variant_new("(a(sa{sv})s)", &builder, nextCursor);
+}
+
 static void
 virtDBusConnectGetCPUModelNames(GVariant *inArgs,
                                 GUnixFDList *inFDs G_GNUC_UNUSED,
@@ -714,6 +958,94 @@ virtDBusConnectGetDomainCapabilities(GVariant *inArgs,
     *outArgs = g_variant_new("(s)", domCapabilities);
 }
 
+static void
+virtDBusConnectGetDomainStatsList(GVariant *inArgs,
+                                  GUnixFDList *inFDs G_GNUC_UNUSED,
+                                  const gchar *objectPath G_GNUC_UNUSED,
+                                  gpointer userData,
+                                  GVariant **outArgs,
+                                  GUnixFDList **outFDs G_GNUC_UNUSED,
+                                  GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(GVariantIter) iter = NULL;
+    g_autoptr(virDomainPtr) domains = NULL;
+    g_autoptr(virDomainStatsRecordPtr) records = NULL;
+    const gchar *path;
+    guint stats;
+    guint flags;
+    gint nstats = 0;
+    gsize ndomains = 0;
+    GVariantBuilder builder;
+
+    g_variant_get(inArgs, "(aouu)", &iter, &stats, &flags);
+
+    domains = g_new0(virDomainPtr, g_variant_iter_n_children(iter) + 1);
+    while (g_variant_iter_next(iter, "&o", &path)) {
+        domains[ndomains] = virtDBusDomainGetVirDomain(connect, path, error);
+        if (!domains[ndomains])
+            return;
+        ndomains++;
+    }
+
+    if (ndomains > 0) {
+        nstats = virtDBusStatsListGetStats(domains, stats, &records, flags);
+        if (nstats < 0)
+            return virtDBusUtilSetLastVirtError(error);
+    }
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+
+    for (gint i = 0; i < nstats; i++) {
+        g_autofree gchar *domainPath = NULL;
+
+        domainPath = virtDBusUtilBusPathForVirDomain(records[i]->dom,
+                                                     connect->domainPath);
+
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("(oa{sv})"));
+        g_variant_builder_add(&builder, "o", domainPath);
+        g_variant_builder_add_value(&builder,
+                                    virtDBusStatsRecordToGVariant(connect->statsCache,
+                                                                  records[i],
+                                                                  stats, flags,
+                                                                  NULL));
+        g_variant_builder_close(&builder);
+    }
+
+    *outArgs = g_variant_new("(a(oa{sv}))", &builder);
+}
+
+static void
+virtDBusConnectGetStatsHistory(GVariant *inArgs,
+                               GUnixFDList *inFDs G_GNUC_UNUSED,
+                               const gchar *objectPath G_GNUC_UNUSED,
+                               gpointer userData,
+                               GVariant **outArgs,
+                               GUnixFDList **outFDs G_GNUC_UNUSED,
+                               GError **error)
+{
+    virtDBusConnect *connect = userData;
+    const gchar *path;
+    g_autofree const gchar **fields = NULL;
+    guint range;
+    GVariant *history;
+
+    g_variant_get(inArgs, "(&o^a&su)", &path, &fields, &range);
+
+    /* The history is kept without libvirt so that it is available even
+     * for domains which no longer exist. */
+    if (!connect->statsHistory) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                    "stats history is disabled, see --stats-history-memory");
+        return;
+    }
+
+    history = virtDBusHistoryGet(connect->statsHistory, path, fields,
+                                 g_get_real_time() / G_USEC_PER_SEC, range);
+
+    *outArgs = g_variant_new_tuple(&history, 1);
+}
+
 static void
 virtDBusConnectGetSysinfo(GVariant *inArgs,
                           GUnixFDList *inFDs G_GNUC_UNUSED,
@@ -824,11 +1156,16 @@ virtDBusConnectInterfaceDefineXML(GVariant *inArgs,
         return;
 
     interface = virInterfaceDefineXML(connect->connection, xml, flags);
+
+    virtDBusGDBusInvalidateSubtree(connect->interfacePath);
+
     if (!interface)
         return virtDBusUtilSetLastVirtError(error);
 
     path = virtDBusUtilBusPathForVirInterface(interface, connect->interfacePath);
 
+    virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+
     *outArgs = g_variant_new("(o)", path);
 }
 
@@ -1368,11 +1705,16 @@ virtDBusConnectNWFilterDefineXML(GVariant *inArgs,
         return;
 
     nwfilter = virNWFilterDefineXML(connect->connection, xml);
+
+    virtDBusGDBusInvalidateSubtree(connect->nwfilterPath);
+
     if (!nwfilter)
         return virtDBusUtilSetLastVirtError(error);
 
     path = virtDBusUtilBusPathForVirNWFilter(nwfilter, connect->nwfilterPath);
 
+    virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+
     *outArgs = g_variant_new("(o)", path);
 }
 
@@ -1565,7 +1907,8 @@ virtDBusConnectNodeGetMemoryParameters(GVariant *inArgs,
         }
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1666,6 +2009,25 @@ virtDBusConnectNodeSetMemoryParameters(GVariant *inArgs,
     }
 }
 
+static void
+virtDBusConnectRemoveThresholdRule(GVariant *inArgs,
+                                   GUnixFDList *inFDs G_GNUC_UNUSED,
+                                   const gchar *objectPath G_GNUC_UNUSED,
+                                   gpointer userData,
+                                   GVariant **outArgs G_GNUC_UNUSED,
+                                   GUnixFDList **outFDs G_GNUC_UNUSED,
+                                   GError **error)
+{
+    virtDBusConnect *connect = userData;
+    guint id;
+
+    g_variant_get(inArgs, "(u)", &id);
+
+    virtDBusSamplerRemoveThresholdRule(connect->sampler,
+                                       virtDBusGDBusGetSender(),
+                                       id, error);
+}
+
 static void
 virtDBusConnectSecretDefineXML(GVariant *inArgs,
                                GUnixFDList *inFDs G_GNUC_UNUSED,
@@ -1929,72 +2291,208 @@ virtDBusConnectStorageVolLookupByPath(GVariant *inArgs,
     *outArgs = g_variant_new("(o)", path);
 }
 
+static void
+virtDBusConnectSubscribeDomainStats(GVariant *inArgs,
+                                    GUnixFDList *inFDs G_GNUC_UNUSED,
+                                    const gchar *objectPath G_GNUC_UNUSED,
+                                    gpointer userData,
+                                    GVariant **outArgs,
+                                    GUnixFDList **outFDs G_GNUC_UNUSED,
+                                    GError **error)
+{
+    virtDBusConnect *connect = userData;
+    guint stats;
+    guint interval;
+    guint flags;
+    guint id;
+
+    g_variant_get(inArgs, "(uuu)", &stats, &interval, &flags);
+
+    id = virtDBusSamplerSubscribe(connect->sampler, virtDBusGDBusGetSender(),
+                                  stats, interval, flags, error);
+    if (id == 0)
+        return;
+
+    *outArgs = g_variant_new("(u)", id);
+}
+
+static void
+virtDBusConnectTopDomains(GVariant *inArgs,
+                          GUnixFDList *inFDs G_GNUC_UNUSED,
+                          const gchar *objectPath G_GNUC_UNUSED,
+                          gpointer userData,
+                          GVariant **outArgs,
+                          GUnixFDList **outFDs G_GNUC_UNUSED,
+                          GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virDomainStatsRecordPtr) records = NULL;
+    g_autoptr(GArray) values = NULL;
+    g_autoptr(GArray) indexes = NULL;
+    g_autofree guint *top = NULL;
+    const gchar *fields[] = { NULL, NULL };
+    GVariantBuilder builder;
+    guint n;
+    guint flags;
+    guint ntop;
+    gint nrecords;
+
+    g_variant_get(inArgs, "(&suu)", &fields[0], &n, &flags);
+
+    if (n == 0) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "number of domains must be positive");
+        return;
+    }
+
+    if (!virtDBusConnectOpen(connect, error))
+        return;
+
+    /* Busy domains are always waited for, values missing for them would
+     * leave them out of the ranking. */
+    nrecords = virtDBusStatsGetAllDomainStats(connect->connection,
+                                              virtDBusStatsGroupsForFields(fields),
+                                              &records,
+                                              flags & ~VIRT_DBUS_STATS_STALE);
+    if (nrecords < 0)
+        return virtDBusUtilSetLastVirtError(error);
+
+    values = g_array_sized_new(FALSE, FALSE, sizeof(gdouble), nrecords);
+    indexes = g_array_sized_new(FALSE, FALSE, sizeof(gint), nrecords);
+    for (gint i = 0; i < nrecords; i++) {
+        g_autoptr(GVariant) rates = NULL;
+        gdouble value;
+
+        if (flags & VIRT_DBUS_STATS_RATES)
+            rates = virtDBusStatsGetRates(connect->statsCache, records[i]);
+
+        if (!virtDBusStatsMetricValue(records[i], rates, fields[0], &value))
+            continue;
+
+        g_array_append_val(values, value);
+        g_array_append_val(indexes, i);
+    }
+
+    top = g_new0(guint, MIN(n, values->len) + 1);
+    ntop = virtDBusStatsTopN((const gdouble *)(void *)values->data,
+                             values->len, n, top);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(od)"));
+    for (guint i = 0; i < ntop; i++) {
+        gint record = g_array_index(indexes, gint, top[i]);
+        g_autofree gchar *path = NULL;
+
+        path = virtDBusUtilBusPathForVirDomain(records[record]->dom,
+                                               connect->domainPath);
+        g_variant_builder_add(&builder, "(od)", path,
+                              g_array_index(values, gdouble, top[i]));
+    }
+
+    *outArgs = g_variant_new("(a(od))", &builder);
+}
+
+static void
+virtDBusConnectUnsubscribeDomainStats(GVariant *inArgs,
+                                      GUnixFDList *inFDs G_GNUC_UNUSED,
+                                      const gchar *objectPath G_GNUC_UNUSED,
+                                      gpointer userData,
+                                      GVariant **outArgs G_GNUC_UNUSED,
+                                      GUnixFDList **outFDs G_GNUC_UNUSED,
+                                      GError **error)
+{
+    virtDBusConnect *connect = userData;
+    guint id;
+
+    g_variant_get(inArgs, "(u)", &id);
+
+    virtDBusSamplerUnsubscribe(connect->sampler, virtDBusGDBusGetSender(),
+                               id, error);
+}
+
 static virtDBusGDBusPropertyTable virtDBusConnectPropertyTable[] = {
-    { "Encrypted", virtDBusConnectGetEncrypted, NULL },
-    { "Hostname", virtDBusConnectGetHostname, NULL },
-    { "LibVersion", virtDBusConnectGetLibVersion, NULL },
-    { "Secure", virtDBusConnectGetSecure, NULL },
-    { "Version", virtDBusConnectGetVersion, NULL },
+    { "Encrypted", virtDBusConnectGetEncrypted, NULL, 0, 0 },
+    { "Hostname", virtDBusConnectGetHostname, NULL, 0,
+      VIRT_DBUS_CONNECT_HOST_CACHE_TTL },
+    { "LibVersion", virtDBusConnectGetLibVersion, NULL, 0,
+      VIRT_DBUS_CONNECT_HOST_CACHE_TTL },
+    { "Secure", virtDBusConnectGetSecure, NULL, 0, 0 },
+    { "Version", virtDBusConnectGetVersion, NULL, 0,
+      VIRT_DBUS_CONNECT_HOST_CACHE_TTL },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusConnectMethodTable[] = {
-    { "BaselineCPU", virtDBusConnectBaselineCPU },
-    { "CompareCPU", virtDBusConnectCompareCPU },
-    { "DomainCreateXML", virtDBusConnectDomainCreateXML },
-    { "DomainCreateXMLWithFiles", virtDBusConnectDomainCreateXMLWithFiles },
-    { "DomainDefineXML", virtDBusConnectDomainDefineXML },
-    { "DomainLookupByID", virtDBusConnectDomainLookupByID },
-    { "DomainLookupByName", virtDBusConnectDomainLookupByName },
-    { "DomainLookupByUUID", virtDBusConnectDomainLookupByUUID },
-    { "DomainRestore", virtDBusConnectDomainRestoreFlags },
-    { "DomainSaveImageDefineXML", virtDBusConnectDomainSaveImageDefineXML },
-    { "DomainSaveImageGetXMLDesc", virtDBusConnectDomainSaveImageGetXMLDesc },
-    { "FindStoragePoolSources", virtDBusConnectFindStoragePoolSources },
-    { "GetAllDomainStats", virtDBusConnectGetAllDomainStats },
-    { "GetCapabilities", virtDBusConnectGetCapabilities },
-    { "GetCPUModelNames", virtDBusConnectGetCPUModelNames },
-    { "GetDomainCapabilities", virtDBusConnectGetDomainCapabilities },
-    { "GetSysinfo", virtDBusConnectGetSysinfo },
-    { "InterfaceChangeBegin", virtDBusConnectInterfaceChangeBegin },
-    { "InterfaceChangeCommit", virtDBusConnectInterfaceChangeCommit },
-    { "InterfaceChangeRollback", virtDBusConnectInterfaceChangeRollback },
-    { "InterfaceDefineXML", virtDBusConnectInterfaceDefineXML },
-    { "InterfaceLookupByMAC", virtDBusConnectInterfaceLookupByMAC },
-    { "InterfaceLookupByName", virtDBusConnectInterfaceLookupByName },
-    { "ListDomains", virtDBusConnectListDomains },
-    { "ListInterfaces", virtDBusConnectListInterfaces },
-    { "ListNetworks", virtDBusConnectListNetworks },
-    { "ListNodeDevices", virtDBusConnectListNodeDevices },
-    { "ListNWFilters", virtDBusConnectListNWFilters },
-    { "ListSecrets", virtDBusConnectListSecrets },
-    { "ListStoragePools", virtDBusConnectListStoragePools },
-    { "NetworkCreateXML", virtDBusConnectNetworkCreateXML },
-    { "NetworkDefineXML", virtDBusConnectNetworkDefineXML },
-    { "NetworkLookupByName", virtDBusConnectNetworkLookupByName },
-    { "NetworkLookupByUUID", virtDBusConnectNetworkLookupByUUID },
-    { "NodeDeviceCreateXML", virtDBusConnectNodeDeviceCreateXML },
-    { "NodeDeviceLookupByName", virtDBusConnectNodeDeviceLookupByName },
-    { "NodeDeviceLookupSCSIHostByWWN", virtDBusConnectNodeDeviceLookupSCSIHostByWWN },
-    { "NWFilterDefineXML", virtDBusConnectNWFilterDefineXML },
-    { "NWFilterLookupByName", virtDBusConnectNWFilterLookupByName },
-    { "NWFilterLookupByUUID", virtDBusConnectNWFilterLookupByUUID },
-    { "NodeGetCPUMap", virtDBusConnectNodeGetCPUMap },
-    { "NodeGetCPUStats", virtDBusConnectNodeGetCPUStats },
-    { "NodeGetFreeMemory", virtDBusConnectNodeGetFreeMemory },
-    { "NodeGetMemoryParameters", virtDBusConnectNodeGetMemoryParameters },
-    { "NodeGetMemoryStats", virtDBusConnectNodeGetMemoryStats },
-    { "NodeGetSecurityModel", virtDBusConnectNodeGetSecurityModel },
-    { "NodeSetMemoryParameters", virtDBusConnectNodeSetMemoryParameters },
-    { "SecretDefineXML", virtDBusConnectSecretDefineXML },
-    { "SecretLookupByUUID", virtDBusConnectSecretLookupByUUID },
-    { "SecretLookupByUsage", virtDBusConnectSecretLookupByUsage },
-    { "StoragePoolCreateXML", virtDBusConnectStoragePoolCreateXML },
-    { "StoragePoolDefineXML", virtDBusConnectStoragePoolDefineXML },
-    { "StoragePoolLookupByName", virtDBusConnectStoragePoolLookupByName },
-    { "StoragePoolLookupByUUID", virtDBusConnectStoragePoolLookupByUUID },
-    { "StorageVolLookupByKey", virtDBusConnectStorageVolLookupByKey },
-    { "StorageVolLookupByPath", virtDBusConnectStorageVolLookupByPath },
+    { "AddThresholdRule", virtDBusConnectAddThresholdRule, 0 },
+    { "BaselineCPU", virtDBusConnectBaselineCPU, 0 },
+    { "Batch", virtDBusConnectBatch, 0 },
+    { "CompareCPU", virtDBusConnectCompareCPU, 0 },
+    { "DomainCreateXML", virtDBusConnectDomainCreateXML, 0 },
+    { "DomainCreateXMLWithFiles", virtDBusConnectDomainCreateXMLWithFiles, 0 },
+    { "DomainDefineXML", virtDBusConnectDomainDefineXML, 0 },
+    { "DomainLookupByID", virtDBusConnectDomainLookupByID, 0 },
+    { "DomainLookupByName", virtDBusConnectDomainLookupByName, 0 },
+    { "DomainLookupByUUID", virtDBusConnectDomainLookupByUUID, 0 },
+    { "DomainRestore", virtDBusConnectDomainRestoreFlags, 0 },
+    { "DomainSaveImageDefineXML", virtDBusConnectDomainSaveImageDefineXML, 0 },
+    { "DomainSaveImageGetXMLDesc", virtDBusConnectDomainSaveImageGetXMLDesc, 0 },
+    { "FindStoragePoolSources", virtDBusConnectFindStoragePoolSources, 0 },
+    { "GetAllDomainStats", virtDBusConnectGetAllDomainStats, 0 },
+    { "GetAllDomainStatsFields", virtDBusConnectGetAllDomainStatsFields, 0 },
+    { "GetAllDomainStatsPage", virtDBusConnectGetAllDomainStatsPage, 0 },
+    { "GetCapabilities", virtDBusConnectGetCapabilities,
+      VIRT_DBUS_CONNECT_CAPABILITIES_CACHE_TTL },
+    { "GetCPUModelNames", virtDBusConnectGetCPUModelNames,
+      VIRT_DBUS_CONNECT_HOST_CACHE_TTL },
+    { "GetDomainCapabilities", virtDBusConnectGetDomainCapabilities,
+      VIRT_DBUS_CONNECT_CAPABILITIES_CACHE_TTL },
+    { "GetDomainStatsList", virtDBusConnectGetDomainStatsList, 0 },
+    { "GetStatsHistory", virtDBusConnectGetStatsHistory, 0 },
+    { "GetSysinfo", virtDBusConnectGetSysinfo,
+      VIRT_DBUS_CONNECT_HOST_CACHE_TTL },
+    { "InterfaceChangeBegin", virtDBusConnectInterfaceChangeBegin, 0 },
+    { "InterfaceChangeCommit", virtDBusConnectInterfaceChangeCommit, 0 },
+    { "InterfaceChangeRollback", virtDBusConnectInterfaceChangeRollback, 0 },
+    { "InterfaceDefineXML", virtDBusConnectInterfaceDefineXML, 0 },
+    { "InterfaceLookupByMAC", virtDBusConnectInterfaceLookupByMAC, 0 },
+    { "InterfaceLookupByName", virtDBusConnectInterfaceLookupByName, 0 },
+    { "ListDomains", virtDBusConnectListDomains, 0 },
+    { "ListInterfaces", virtDBusConnectListInterfaces, 0 },
+    { "ListNetworks", virtDBusConnectListNetworks, 0 },
+    { "ListNodeDevices", virtDBusConnectListNodeDevices, 0 },
+    { "ListNWFilters", virtDBusConnectListNWFilters, 0 },
+    { "ListSecrets", virtDBusConnectListSecrets, 0 },
+    { "ListStoragePools", virtDBusConnectListStoragePools, 0 },
+    { "NetworkCreateXML", virtDBusConnectNetworkCreateXML, 0 },
+    { "NetworkDefineXML", virtDBusConnectNetworkDefineXML, 0 },
+    { "NetworkLookupByName", virtDBusConnectNetworkLookupByName, 0 },
+    { "NetworkLookupByUUID", virtDBusConnectNetworkLookupByUUID, 0 },
+    { "NodeDeviceCreateXML", virtDBusConnectNodeDeviceCreateXML, 0 },
+    { "NodeDeviceLookupByName", virtDBusConnectNodeDeviceLookupByName, 0 },
+    { "NodeDeviceLookupSCSIHostByWWN", virtDBusConnectNodeDeviceLookupSCSIHostByWWN, 0 },
+    { "NWFilterDefineXML", virtDBusConnectNWFilterDefineXML, 0 },
+    { "NWFilterLookupByName", virtDBusConnectNWFilterLookupByName, 0 },
+    { "NWFilterLookupByUUID", virtDBusConnectNWFilterLookupByUUID, 0 },
+    { "NodeGetCPUMap", virtDBusConnectNodeGetCPUMap, 0 },
+    { "NodeGetCPUStats", virtDBusConnectNodeGetCPUStats, 0 },
+    { "NodeGetFreeMemory", virtDBusConnectNodeGetFreeMemory, 0 },
+    { "NodeGetMemoryParameters", virtDBusConnectNodeGetMemoryParameters, 0 },
+    { "NodeGetMemoryStats", virtDBusConnectNodeGetMemoryStats, 0 },
+    { "NodeGetSecurityModel", virtDBusConnectNodeGetSecurityModel,
+      VIRT_DBUS_CONNECT_HOST_CACHE_TTL },
+    { "NodeSetMemoryParameters", virtDBusConnectNodeSetMemoryParameters, 0 },
+    { "RemoveThresholdRule", virtDBusConnectRemoveThresholdRule, 0 },
+    { "SecretDefineXML", virtDBusConnectSecretDefineXML, 0 },
+    { "SecretLookupByUUID", virtDBusConnectSecretLookupByUUID, 0 },
+    { "SecretLookupByUsage", virtDBusConnectSecretLookupByUsage, 0 },
+    { "StoragePoolCreateXML", virtDBusConnectStoragePoolCreateXML, 0 },
+    { "StoragePoolDefineXML", virtDBusConnectStoragePoolDefineXML, 0 },
+    { "StoragePoolLookupByName", virtDBusConnectStoragePoolLookupByName, 0 },
+    { "StoragePoolLookupByUUID", virtDBusConnectStoragePoolLookupByUUID, 0 },
+    { "StorageVolLookupByKey", virtDBusConnectStorageVolLookupByKey, 0 },
+    { "StorageVolLookupByPath", virtDBusConnectStorageVolLookupByPath, 0 },
+    { "SubscribeDomainStats", virtDBusConnectSubscribeDomainStats, 0 },
+    { "TopDomains", virtDBusConnectTopDomains, 0 },
+    { "UnsubscribeDomainStats", virtDBusConnectUnsubscribeDomainStats, 0 },
     { 0 }
 };
 
@@ -2003,6 +2501,16 @@ static GDBusInterfaceInfo *interfaceInfo = NULL;
 void
 virtDBusConnectFree(virtDBusConnect *connect)
 {
+    /* Waits for the sampler thread which may use the connection. */
+    if (connect->sampler)
+        virtDBusSamplerFree(connect->sampler);
+
+    if (connect->statsHistory)
+        virtDBusHistoryFree(connect->statsHistory);
+
+    if (connect->statsFile)
+        virtDBusStatsFileFree(connect->statsFile);
+
     if (connect->connection)
         virtDBusConnectClose(connect, TRUE);
 
@@ -2015,6 +2523,32 @@ virtDBusConnectFree(virtDBusConnect *connect)
     g_free(connect->secretPath);
     g_free(connect->storagePoolPath);
     g_free(connect->storageVolPath);
+
+    virtDBusUtilHandleCacheFree(connect->domainCache);
+    virtDBusUtilHandleCacheFree(connect->domainSnapshotCache);
+    virtDBusUtilHandleCacheFree(connect->interfaceCache);
+    virtDBusUtilHandleCacheFree(connect->networkCache);
+    virtDBusUtilHandleCacheFree(connect->nodeDevCache);
+    virtDBusUtilHandleCacheFree(connect->nwfilterCache);
+    virtDBusUtilHandleCacheFree(connect->secretCache);
+    virtDBusUtilHandleCacheFree(connect->storagePoolCache);
+    virtDBusUtilHandleCacheFree(connect->storageVolCache);
+
+    virtDBusUtilXMLCacheFree(connect->domainXMLCache);
+    virtDBusUtilXMLCacheFree(connect->networkXMLCache);
+    virtDBusUtilXMLCacheFree(connect->storagePoolXMLCache);
+    virtDBusUtilXMLCacheFree(connect->storageVolXMLCache);
+
+    virtDBusStatsCacheFree(connect->statsCache);
+
+    if (connect->domainStates)
+        g_hash_table_unref(connect->domainStates);
+    g_mutex_clear(&connect->domainStatesLock);
+
+    if (connect->domainAgentCache)
+        g_hash_table_unref(connect->domainAgentCache);
+    g_mutex_clear(&connect->domainAgentCacheLock);
+
     g_free(connect);
 }
 
@@ -2026,6 +2560,7 @@ virtDBusConnectNew(virtDBusConnect **connectp,
                    GError **error)
 {
     g_autoptr(virtDBusConnect) connect = NULL;
+    g_autofree gchar *statsFileName = NULL;
 
     if (!interfaceInfo) {
         interfaceInfo = virtDBusGDBusLoadIntrospectData(VIRT_DBUS_CONNECT_INTERFACE,
@@ -2057,12 +2592,59 @@ virtDBusConnectNew(virtDBusConnect **connectp,
     connect->uri = uri;
     connect->connectPath = connectPath;
 
+#define VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(type) \
+    virtDBusUtilHandleCacheNew((virtDBusUtilHandleRefFunc)type ## Ref, \
+                               (virtDBusUtilHandleFreeFunc)type ## Free)
+
+    connect->domainCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virDomain);
+    connect->domainSnapshotCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virDomainSnapshot);
+    connect->interfaceCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virInterface);
+    connect->networkCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virNetwork);
+    connect->nodeDevCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virNodeDevice);
+    connect->nwfilterCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virNWFilter);
+    connect->secretCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virSecret);
+    connect->storagePoolCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virStoragePool);
+    connect->storageVolCache = VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW(virStorageVol);
+
+#undef VIRT_DBUS_CONNECT_HANDLE_CACHE_NEW
+
+    connect->domainXMLCache = virtDBusUtilXMLCacheNew(VIRT_DBUS_CONNECT_XML_CACHE_MAX_AGE);
+    connect->networkXMLCache = virtDBusUtilXMLCacheNew(VIRT_DBUS_CONNECT_XML_CACHE_MAX_AGE);
+    connect->storagePoolXMLCache = virtDBusUtilXMLCacheNew(VIRT_DBUS_CONNECT_STORAGE_XML_CACHE_MAX_AGE);
+    connect->storageVolXMLCache = virtDBusUtilXMLCacheNew(VIRT_DBUS_CONNECT_STORAGE_XML_CACHE_MAX_AGE);
+
+    connect->statsCache = virtDBusStatsCacheNew();
+    connect->statsHistory = virtDBusHistoryNewDefault();
+
+    statsFileName = g_path_get_basename(connectPath);
+    connect->statsFile = virtDBusStatsFileNewDefault(statsFileName, error);
+    if (error && *error)
+        return;
+
+    connect->sampler = virtDBusSamplerNew(connect);
+
+    g_mutex_init(&connect->domainStatesLock);
+    connect->domainStates = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, g_free);
+
+    g_mutex_init(&connect->domainAgentCacheLock);
+    connect->domainAgentCache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                      g_free,
+                                                      virtDBusDomainAgentResultFree);
+    g_queue_init(&connect->domainAgentCacheOrder);
+
     virtDBusGDBusRegisterObject(bus,
                                 connect->connectPath,
                                 interfaceInfo,
                                 virtDBusConnectMethodTable,
                                 virtDBusConnectPropertyTable,
-                                connect);
+                                connect,
+                                error);
+    if (error && *error)
+        return;
+
+    if (!virtDBusGDBusRegisterObjectManager(bus, connect->connectPath, error))
+        return;
 
     virtDBusDomainRegister(connect, error);
     if (error && *error)
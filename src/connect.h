@@ -2,6 +2,10 @@
 
 #define VIR_ENUM_SENTINELS
 
+#include "history.h"
+#include "sampler.h"
+#include "stats.h"
+#include "statsfile.h"
 #include "util.h"
 
 #include <libvirt/libvirt.h>
@@ -24,6 +28,34 @@ struct virtDBusConnect {
     virConnectPtr connection;
     GMutex lock;
 
+    virtDBusUtilHandleCache *domainCache;
+    virtDBusUtilHandleCache *domainSnapshotCache;
+    virtDBusUtilHandleCache *interfaceCache;
+    virtDBusUtilHandleCache *networkCache;
+    virtDBusUtilHandleCache *nodeDevCache;
+    virtDBusUtilHandleCache *nwfilterCache;
+    virtDBusUtilHandleCache *secretCache;
+    virtDBusUtilHandleCache *storagePoolCache;
+    virtDBusUtilHandleCache *storageVolCache;
+
+    virtDBusUtilXMLCache *domainXMLCache;
+    virtDBusUtilXMLCache *networkXMLCache;
+    virtDBusUtilXMLCache *storagePoolXMLCache;
+    virtDBusUtilXMLCache *storageVolXMLCache;
+
+    virtDBusStatsCache *statsCache;
+    virtDBusSampler *sampler;
+    virtDBusHistory *statsHistory;
+    virtDBusStatsFile *statsFile;
+
+    GMutex domainStatesLock;
+    GHashTable *domainStates;
+    guint domainStatesGeneration;
+
+    GMutex domainAgentCacheLock;
+    GHashTable *domainAgentCache;
+    GQueue domainAgentCacheOrder;
+
     gint domainCallbackIds[VIR_DOMAIN_EVENT_ID_LAST];
     gint networkCallbackIds[VIR_NETWORK_EVENT_ID_LAST];
     gint nodeDevCallbackIds[VIR_NODE_DEVICE_EVENT_ID_LAST];
@@ -145,16 +145,22 @@ virtDBusDomainGVariantToCpumap(GVariantIter *iter,
     }
 }
 
-static virDomainPtr
+virDomainPtr
 virtDBusDomainGetVirDomain(virtDBusConnect *connect,
                            const gchar *objectPath,
                            GError **error)
 {
     virDomainPtr domain;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    domain = virtDBusUtilHandleCacheLookup(connect->domainCache, objectPath,
+                                           connect->connection, &generation);
+    if (domain)
+        return domain;
+
     domain = virtDBusUtilVirDomainFromBusPath(connect->connection,
                                               objectPath,
                                               connect->domainPath);
@@ -163,9 +169,283 @@ virtDBusDomainGetVirDomain(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->domainCache, objectPath,
+                                  connect->connection, domain, generation);
+
     return domain;
 }
 
+typedef enum {
+    VIRT_DBUS_DOMAIN_STATE_ACTIVE = (1 << 0),
+    VIRT_DBUS_DOMAIN_STATE_ID = (1 << 1),
+    VIRT_DBUS_DOMAIN_STATE_STATE = (1 << 2),
+} virtDBusDomainStateField;
+
+/* State of a domain as last read from libvirt.  Entries are dropped by
+ * lifecycle events and by our own calls changing the state, so the next
+ * read goes to libvirt again. */
+struct _virtDBusDomainState {
+    guint fields;
+    gboolean active;
+    guint id;
+    gint state;
+    gint reason;
+};
+typedef struct _virtDBusDomainState virtDBusDomainState;
+
+static gboolean
+virtDBusDomainStateLookup(virtDBusConnect *connect,
+                          const gchar *path,
+                          virtDBusDomainStateField field,
+                          virtDBusDomainState *state,
+                          guint *generation)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&connect->domainStatesLock);
+    virtDBusDomainState *cached;
+
+    *generation = connect->domainStatesGeneration;
+
+    cached = g_hash_table_lookup(connect->domainStates, path);
+    if (!cached || !(cached->fields & field))
+        return FALSE;
+
+    *state = *cached;
+
+    return TRUE;
+}
+
+static void
+virtDBusDomainStateUpdate(virtDBusConnect *connect,
+                          const gchar *path,
+                          virtDBusDomainStateField field,
+                          const virtDBusDomainState *state,
+                          guint generation)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&connect->domainStatesLock);
+    virtDBusDomainState *cached;
+
+    if (generation != connect->domainStatesGeneration)
+        return;
+
+    cached = g_hash_table_lookup(connect->domainStates, path);
+    if (!cached) {
+        cached = g_new0(virtDBusDomainState, 1);
+        g_hash_table_insert(connect->domainStates, g_strdup(path), cached);
+    }
+
+    switch (field) {
+    case VIRT_DBUS_DOMAIN_STATE_ACTIVE:
+        cached->active = state->active;
+        break;
+    case VIRT_DBUS_DOMAIN_STATE_ID:
+        cached->id = state->id;
+        break;
+    case VIRT_DBUS_DOMAIN_STATE_STATE:
+        cached->state = state->state;
+        cached->reason = state->reason;
+        break;
+    }
+
+    cached->fields |= field;
+}
+
+void
+virtDBusDomainStateInvalidate(virtDBusConnect *connect,
+                              const gchar *path)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&connect->domainStatesLock);
+
+    connect->domainStatesGeneration++;
+    g_hash_table_remove(connect->domainStates, path);
+}
+
+void
+virtDBusDomainStateClear(virtDBusConnect *connect)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&connect->domainStatesLock);
+
+    connect->domainStatesGeneration++;
+    g_hash_table_remove_all(connect->domainStates);
+}
+
+/* Results of calls answered by the guest agent.  An unresponsive agent
+ * blocks the calling worker until libvirt gives up so the results are
+ * reused for a while.  Callers passing VIRT_DBUS_DOMAIN_AGENT_STALE get
+ * older results as well when the agent does not respond. */
+#define VIRT_DBUS_DOMAIN_AGENT_CACHE_MAX_STALENESS (10 * 60 * G_USEC_PER_SEC)
+#define VIRT_DBUS_DOMAIN_AGENT_CACHE_MAX_ENTRIES 1024
+
+#define VIRT_DBUS_DOMAIN_AGENT_FSINFO_TTL (30 * G_USEC_PER_SEC)
+#define VIRT_DBUS_DOMAIN_AGENT_GUEST_VCPUS_TTL (10 * G_USEC_PER_SEC)
+#define VIRT_DBUS_DOMAIN_AGENT_HOSTNAME_TTL (60 * G_USEC_PER_SEC)
+#define VIRT_DBUS_DOMAIN_AGENT_INTERFACES_TTL (10 * G_USEC_PER_SEC)
+
+struct _virtDBusDomainAgentResult {
+    GVariant *value;
+    gint64 timestamp;
+    const gchar *key;
+    GList link;
+};
+typedef struct _virtDBusDomainAgentResult virtDBusDomainAgentResult;
+
+void
+virtDBusDomainAgentResultFree(gpointer opaque)
+{
+    virtDBusDomainAgentResult *result = opaque;
+
+    g_variant_unref(result->value);
+    g_free(result);
+}
+
+/*
+ * @args are the arguments of the call without VIRT_DBUS_DOMAIN_AGENT_STALE
+ * so that callers accepting stale results share the cached ones.  A
+ * floating @args is consumed.
+ */
+static gchar *
+virtDBusDomainAgentCacheKey(const gchar *path,
+                            const gchar *method,
+                            GVariant *args)
+{
+    g_autoptr(GVariant) ref = g_variant_ref_sink(args);
+    g_autofree gchar *printed = g_variant_print(ref, FALSE);
+
+    return g_strdup_printf("%s %s %s", path, method, printed);
+}
+
+/*
+ * Returns a floating copy of the result cached under @key if it is at most
+ * @maxAge old.
+ */
+static GVariant *
+virtDBusDomainAgentCacheLookup(virtDBusConnect *connect,
+                               const gchar *key,
+                               gint64 maxAge)
+{
+    virtDBusDomainAgentResult *result;
+    g_autoptr(GVariant) value = NULL;
+    g_autoptr(GBytes) bytes = NULL;
+
+    g_mutex_lock(&connect->domainAgentCacheLock);
+    result = g_hash_table_lookup(connect->domainAgentCache, key);
+    if (result && g_get_monotonic_time() - result->timestamp <= maxAge)
+        value = g_variant_ref(result->value);
+    g_mutex_unlock(&connect->domainAgentCacheLock);
+
+    if (!value)
+        return NULL;
+
+    bytes = g_variant_get_data_as_bytes(value);
+
+    return g_variant_new_from_bytes(g_variant_get_type(value), bytes, TRUE);
+}
+
+/*
+ * Used when the agent call failed.  Returns the last result if the caller
+ * accepts stale results, the agent did not respond and the result is not
+ * too old, NULL otherwise.  The libvirt error is preserved for the caller.
+ */
+static GVariant *
+virtDBusDomainAgentCacheFallback(virtDBusConnect *connect,
+                                 const gchar *key,
+                                 gboolean stale)
+{
+    virErrorPtr err = virGetLastError();
+
+    if (!stale || !err || err->code != VIR_ERR_AGENT_UNRESPONSIVE)
+        return NULL;
+
+    return virtDBusDomainAgentCacheLookup(connect, key,
+                                          VIRT_DBUS_DOMAIN_AGENT_CACHE_MAX_STALENESS);
+}
+
+/* Has to be called with the agent cache lock held. */
+static void
+virtDBusDomainAgentCacheDrop(virtDBusConnect *connect,
+                             virtDBusDomainAgentResult *result)
+{
+    g_queue_unlink(&connect->domainAgentCacheOrder, &result->link);
+    g_hash_table_remove(connect->domainAgentCache, result->key);
+}
+
+/*
+ * Takes the floating @outArgs and replaces it with a floating copy for
+ * the caller.  Results are kept in the order they were stored, the oldest
+ * ones are dropped once they cannot be used anymore or the cache is full.
+ */
+static void
+virtDBusDomainAgentCacheStore(virtDBusConnect *connect,
+                              const gchar *key,
+                              GVariant **outArgs)
+{
+    virtDBusDomainAgentResult *result = g_new0(virtDBusDomainAgentResult, 1);
+    virtDBusDomainAgentResult *previous;
+    virtDBusDomainAgentResult *oldest;
+    g_autoptr(GBytes) bytes = NULL;
+
+    result->value = g_variant_ref_sink(*outArgs);
+    result->timestamp = g_get_monotonic_time();
+    result->key = g_strdup(key);
+    result->link.data = result;
+
+    bytes = g_variant_get_data_as_bytes(result->value);
+    *outArgs = g_variant_new_from_bytes(g_variant_get_type(result->value),
+                                        bytes, TRUE);
+
+    g_mutex_lock(&connect->domainAgentCacheLock);
+
+    previous = g_hash_table_lookup(connect->domainAgentCache, key);
+    if (previous)
+        virtDBusDomainAgentCacheDrop(connect, previous);
+
+    while (!g_queue_is_empty(&connect->domainAgentCacheOrder)) {
+        guint size = g_hash_table_size(connect->domainAgentCache);
+
+        oldest = g_queue_peek_head(&connect->domainAgentCacheOrder);
+        if (size < VIRT_DBUS_DOMAIN_AGENT_CACHE_MAX_ENTRIES &&
+            result->timestamp - oldest->timestamp <= VIRT_DBUS_DOMAIN_AGENT_CACHE_MAX_STALENESS) {
+            break;
+        }
+
+        virtDBusDomainAgentCacheDrop(connect, oldest);
+    }
+
+    g_queue_push_tail_link(&connect->domainAgentCacheOrder, &result->link);
+    g_hash_table_insert(connect->domainAgentCache, (gpointer)result->key,
+                        result);
+
+    g_mutex_unlock(&connect->domainAgentCacheLock);
+}
+
+void
+virtDBusDomainAgentCacheInvalidate(virtDBusConnect *connect,
+                                   const gchar *path)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&connect->domainAgentCacheLock);
+    gsize len = strlen(path);
+    GHashTableIter iter;
+    const gchar *key;
+    virtDBusDomainAgentResult *result;
+
+    g_hash_table_iter_init(&iter, connect->domainAgentCache);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&result)) {
+        if (strncmp(key, path, len) != 0 || key[len] != ' ')
+            continue;
+
+        g_queue_unlink(&connect->domainAgentCacheOrder, &result->link);
+        g_hash_table_iter_remove(&iter);
+    }
+}
+
+void
+virtDBusDomainAgentCacheClear(virtDBusConnect *connect)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&connect->domainAgentCacheLock);
+
+    g_queue_init(&connect->domainAgentCacheOrder);
+    g_hash_table_remove_all(connect->domainAgentCache);
+}
+
 static void
 virtDBusDomainGetActive(const gchar *objectPath,
                         gpointer userData,
@@ -174,8 +454,17 @@ virtDBusDomainGetActive(const gchar *objectPath,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
+    virtDBusDomainState state = { 0 };
+    guint generation;
     gint active;
 
+    if (virtDBusDomainStateLookup(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_ACTIVE,
+                                  &state, &generation)) {
+        *value = g_variant_new("b", state.active);
+        return;
+    }
+
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
         return;
@@ -184,7 +473,12 @@ virtDBusDomainGetActive(const gchar *objectPath,
     if (active < 0)
         return virtDBusUtilSetLastVirtError(error);
 
-    *value = g_variant_new("b", !!active);
+    state.active = !!active;
+    virtDBusDomainStateUpdate(connect, objectPath,
+                              VIRT_DBUS_DOMAIN_STATE_ACTIVE,
+                              &state, generation);
+
+    *value = g_variant_new("b", state.active);
 }
 
 static void
@@ -195,16 +489,37 @@ virtDBusDomainGetId(const gchar *objectPath,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
+    virtDBusDomainState state = { 0 };
+    guint generation;
     guint id;
 
-    domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
-    if (!domain)
+    if (virtDBusDomainStateLookup(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_ID,
+                                  &state, &generation)) {
+        *value = g_variant_new("u", state.id);
         return;
+    }
+
+    if (!virtDBusConnectOpen(connect, error))
+        return;
+
+    /* Cached handles keep the ID they were looked up with until the
+     * lifecycle event arrives which may be after the state changed. */
+    domain = virtDBusUtilVirDomainFromBusPath(connect->connection,
+                                              objectPath,
+                                              connect->domainPath);
+    if (!domain)
+        return virtDBusUtilSetLastVirtError(error);
 
     id = virDomainGetID(domain);
     if (id == (guint)-1)
         id = 0;
 
+    state.id = id;
+    virtDBusDomainStateUpdate(connect, objectPath,
+                              VIRT_DBUS_DOMAIN_STATE_ID,
+                              &state, generation);
+
     *value = g_variant_new("u", id);
 }
 
@@ -341,17 +656,92 @@ virtDBusDomainGetUUID(const gchar *objectPath,
                       GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virDomain) domain = NULL;
     gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
 
+    if (!virtDBusUtilUUIDFromBusPath(objectPath, connect->domainPath, uuid, error))
+        return;
+
+    *value = g_variant_new("s", uuid);
+}
+
+/* Resolves the domain once for all properties and reads Active together
+ * with the state.  Id and UUID are left to their own getters. */
+static void
+virtDBusDomainGetAll(const gchar *objectPath,
+                     gpointer userData,
+                     GVariant **values,
+                     GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virDomain) domain = NULL;
+    virtDBusDomainState state = { 0 };
+    GVariantBuilder builder;
+    guint generation;
+    const gchar *name;
+    g_autofree gchar *osType = NULL;
+    g_autofree gchar *schedtype = NULL;
+    gint autostart = 0;
+    gint persistent;
+    gint updated;
+    gint nparams;
+
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
         return;
 
-    if (virDomainGetUUIDString(domain, uuid) < 0)
-        return virtDBusUtilSetLastVirtError(error);
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
 
-    *value = g_variant_new("s", uuid);
+    if (virtDBusDomainStateLookup(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_ACTIVE,
+                                  &state, &generation)) {
+        g_variant_builder_add(&builder, "{sv}", "Active",
+                              g_variant_new("b", state.active));
+    } else if (virDomainGetState(domain, &state.state, &state.reason, 0) == 0) {
+        state.active = state.state != VIR_DOMAIN_SHUTOFF;
+        virtDBusDomainStateUpdate(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_ACTIVE,
+                                  &state, generation);
+        virtDBusDomainStateUpdate(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_STATE,
+                                  &state, generation);
+        g_variant_builder_add(&builder, "{sv}", "Active",
+                              g_variant_new("b", state.active));
+    }
+
+    if (virDomainGetAutostart(domain, &autostart) == 0) {
+        g_variant_builder_add(&builder, "{sv}", "Autostart",
+                              g_variant_new("b", !!autostart));
+    }
+
+    name = virDomainGetName(domain);
+    if (name)
+        g_variant_builder_add(&builder, "{sv}", "Name", g_variant_new("s", name));
+
+    osType = virDomainGetOSType(domain);
+    if (osType) {
+        g_variant_builder_add(&builder, "{sv}", "OSType",
+                              g_variant_new("s", osType));
+    }
+
+    persistent = virDomainIsPersistent(domain);
+    if (persistent >= 0) {
+        g_variant_builder_add(&builder, "{sv}", "Persistent",
+                              g_variant_new("b", !!persistent));
+    }
+
+    schedtype = virDomainGetSchedulerType(domain, &nparams);
+    if (schedtype) {
+        g_variant_builder_add(&builder, "{sv}", "SchedulerType",
+                              g_variant_new("(si)", schedtype, nparams));
+    }
+
+    updated = virDomainIsUpdated(domain);
+    if (updated >= 0) {
+        g_variant_builder_add(&builder, "{sv}", "Updated",
+                              g_variant_new("b", !!updated));
+    }
+
+    *values = g_variant_builder_end(&builder);
 }
 
 static void
@@ -361,6 +751,7 @@ virtDBusDomainSetAutostart(GVariant *value,
                            GError **error)
 {
     virtDBusConnect *connect = userData;
+    static const gchar *const properties[] = { "Autostart", NULL };
     g_autoptr(virDomain) domain = NULL;
     gboolean autostart;
 
@@ -371,7 +762,11 @@ virtDBusDomainSetAutostart(GVariant *value,
         return;
 
     if (virDomainSetAutostart(domain, autostart) < 0)
-        virtDBusUtilSetLastVirtError(error);
+        return virtDBusUtilSetLastVirtError(error);
+
+    /* There is no libvirt event for autostart changes. */
+    virtDBusGDBusEmitPropertiesChanged(connect->bus, objectPath,
+                                       VIRT_DBUS_DOMAIN_INTERFACE, properties);
 }
 
 static void
@@ -416,6 +811,38 @@ virtDBusDomainAddIOThread(GVariant *inArgs,
 
     if (virDomainAddIOThread(domain, iothreadId, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
+}
+
+static void
+virtDBusDomainAgentSetResponseTimeout(GVariant *inArgs,
+                                      GUnixFDList *inFDs G_GNUC_UNUSED,
+                                      const gchar *objectPath,
+                                      gpointer userData,
+                                      GVariant **outArgs G_GNUC_UNUSED,
+                                      GUnixFDList **outFDs G_GNUC_UNUSED,
+                                      GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virDomain) domain = NULL;
+    gint timeout;
+    guint flags;
+
+    g_variant_get(inArgs, "(iu)", &timeout, &flags);
+
+    domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
+    if (!domain)
+        return;
+
+#if LIBVIR_VERSION_NUMBER >= 5010000
+    if (virDomainAgentSetResponseTimeout(domain, timeout, flags) < 0)
+        virtDBusUtilSetLastVirtError(error);
+#else
+    g_set_error(error, VIRT_DBUS_ERROR, VIRT_DBUS_ERROR_LIBVIRT,
+                "virDomainAgentSetResponseTimeout is not supported by "
+                "libvirt-dbus built with libvirt older than 5.10.0");
+#endif
 }
 
 static void
@@ -440,6 +867,8 @@ virtDBusDomainAttachDevice(GVariant *inArgs,
 
     if (virDomainAttachDeviceFlags(domain, xml, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -467,6 +896,8 @@ virtDBusDomainBlockCommit(GVariant *inArgs,
 
     if (virDomainBlockCommit(domain, disk, base, top, bandwidth, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -501,6 +932,8 @@ virtDBusDomainBlockCopy(GVariant *inArgs,
                            params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -525,6 +958,8 @@ virtDBusDomainBlockJobAbort(GVariant *inArgs,
 
     if (virDomainBlockJobAbort(domain, disk, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -613,6 +1048,8 @@ virtDBusDomainBlockPull(GVariant *inArgs,
 
     if (virDomainBlockPull(domain, disk, bandwidth, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -641,6 +1078,8 @@ virtDBusDomainBlockRebase(GVariant *inArgs,
 
     if (virDomainBlockRebase(domain, disk, base, bandwidth, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -666,6 +1105,8 @@ virtDBusDomainBlockResize(GVariant *inArgs,
 
     if (virDomainBlockResize(domain, disk, size, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -691,6 +1132,9 @@ virtDBusDomainCoreDumpWithFormat(GVariant *inArgs,
 
     if (virDomainCoreDumpWithFormat(domain, to, dumpformat, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -714,6 +1158,9 @@ virtDBusDomainCreate(GVariant *inArgs,
 
     if (virDomainCreateWithFlags(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -745,6 +1192,9 @@ virtDBusDomainCreateWithFiles(GVariant *inArgs,
 
     if (virDomainCreateWithFiles(domain, nfiles, (gint *)files, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -769,6 +1219,8 @@ virtDBusDomainDelIOThread(GVariant *inArgs,
 
     if (virDomainDelIOThread(domain, iothreadId, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -792,6 +1244,9 @@ virtDBusDomainDestroy(GVariant *inArgs,
 
     if (virDomainDestroyFlags(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -816,6 +1271,8 @@ virtDBusDomainDetachDevice(GVariant *inArgs,
 
     if (virDomainDetachDeviceFlags(domain, xml, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -940,7 +1397,8 @@ virtDBusDomainGetBlockIOParameters(GVariant *inArgs,
         }
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -980,7 +1438,8 @@ virtDBusDomainGetBlockIOTune(GVariant *inArgs,
         }
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1146,19 +1605,34 @@ virtDBusDomainGetFSInfo(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
     g_auto(virtDBusDomainFSInfoList) info = { 0 };
+    g_autofree gchar *key = NULL;
     GVariantBuilder builder;
     guint flags;
+    gboolean stale;
     GVariant *gret;
 
     g_variant_get(inArgs, "(u)", &flags);
+    stale = !!(flags & VIRT_DBUS_DOMAIN_AGENT_STALE);
+    flags &= ~VIRT_DBUS_DOMAIN_AGENT_STALE;
+
+    key = virtDBusDomainAgentCacheKey(objectPath, "GetFSInfo",
+                                      g_variant_new("(u)", flags));
+    *outArgs = virtDBusDomainAgentCacheLookup(connect, key,
+                                              VIRT_DBUS_DOMAIN_AGENT_FSINFO_TTL);
+    if (*outArgs)
+        return;
 
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
         return;
 
     info.count = virDomainGetFSInfo(domain, &info.info, flags);
-    if (info.count < 0)
-        return virtDBusUtilSetLastVirtError(error);
+    if (info.count < 0) {
+        *outArgs = virtDBusDomainAgentCacheFallback(connect, key, stale);
+        if (!*outArgs)
+            virtDBusUtilSetLastVirtError(error);
+        return;
+    }
 
     g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sssas)"));
 
@@ -1177,6 +1651,7 @@ virtDBusDomainGetFSInfo(GVariant *inArgs,
     gret = g_variant_builder_end(&builder);
 
     *outArgs = g_variant_new_tuple(&gret, 1);
+    virtDBusDomainAgentCacheStore(connect, key, outArgs);
 }
 
 static void
@@ -1191,10 +1666,21 @@ virtDBusDomainGetGuestVcpus(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
     g_auto(virtDBusUtilTypedParams) params = { 0 };
+    g_autofree gchar *key = NULL;
     guint flags;
+    gboolean stale;
     GVariant *grecords;
 
     g_variant_get(inArgs, "(u)", &flags);
+    stale = !!(flags & VIRT_DBUS_DOMAIN_AGENT_STALE);
+    flags &= ~VIRT_DBUS_DOMAIN_AGENT_STALE;
+
+    key = virtDBusDomainAgentCacheKey(objectPath, "GetGuestVcpus",
+                                      g_variant_new("(u)", flags));
+    *outArgs = virtDBusDomainAgentCacheLookup(connect, key,
+                                              VIRT_DBUS_DOMAIN_AGENT_GUEST_VCPUS_TTL);
+    if (*outArgs)
+        return;
 
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
@@ -1202,12 +1688,17 @@ virtDBusDomainGetGuestVcpus(GVariant *inArgs,
 
     if (virDomainGetGuestVcpus(domain, &params.params,
                                (guint *)&params.nparams, flags) < 0) {
-        return virtDBusUtilSetLastVirtError(error);
+        *outArgs = virtDBusDomainAgentCacheFallback(connect, key, stale);
+        if (!*outArgs)
+            virtDBusUtilSetLastVirtError(error);
+        return;
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
+    virtDBusDomainAgentCacheStore(connect, key, outArgs);
 }
 
 static void
@@ -1222,19 +1713,35 @@ virtDBusDomainGetHostname(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
     g_autofree gchar *hostname = NULL;
+    g_autofree gchar *key = NULL;
     guint flags;
+    gboolean stale;
 
     g_variant_get(inArgs, "(u)", &flags);
+    stale = !!(flags & VIRT_DBUS_DOMAIN_AGENT_STALE);
+    flags &= ~VIRT_DBUS_DOMAIN_AGENT_STALE;
+
+    key = virtDBusDomainAgentCacheKey(objectPath, "GetHostname",
+                                      g_variant_new("(u)", flags));
+    *outArgs = virtDBusDomainAgentCacheLookup(connect, key,
+                                              VIRT_DBUS_DOMAIN_AGENT_HOSTNAME_TTL);
+    if (*outArgs)
+        return;
 
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
         return;
 
     hostname = virDomainGetHostname(domain, flags);
-    if (!hostname)
-        return virtDBusUtilSetLastVirtError(error);
+    if (!hostname) {
+        *outArgs = virtDBusDomainAgentCacheFallback(connect, key, stale);
+        if (!*outArgs)
+            virtDBusUtilSetLastVirtError(error);
+        return;
+    }
 
     *outArgs = g_variant_new("(s)", hostname);
+    virtDBusDomainAgentCacheStore(connect, key, outArgs);
 }
 
 static void
@@ -1272,7 +1779,8 @@ virtDBusDomainGetInterfaceParameters(GVariant *inArgs,
         }
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1383,7 +1891,8 @@ virtDBusDomainGetJobStats(GVariant *inArgs,
         return virtDBusUtilSetLastVirtError(error);
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     g_variant_builder_init(&builder, G_VARIANT_TYPE("(ia{sv})"));
     g_variant_builder_add(&builder, "i", type);
@@ -1427,7 +1936,8 @@ virtDBusDomainGetMemoryParameters(GVariant *inArgs,
         }
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1496,7 +2006,8 @@ virtDBusDomainGetNumaParameters(GVariant *inArgs,
         }
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1527,7 +2038,8 @@ virtDBusDomainGetPerfEvents(GVariant *inArgs,
         return virtDBusUtilSetLastVirtError(error);
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1565,7 +2077,8 @@ virtDBusDomainGetSchedulerParameters(GVariant *inArgs,
             return virtDBusUtilSetLastVirtError(error);
     }
 
-    grecords = virtDBusUtilTypedParamsToGVariant(params.params, params.nparams);
+    grecords = virtDBusUtilTypedParamsToGVariant(params.params,
+                                                 params.nparams, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1615,20 +2128,39 @@ virtDBusDomainGetState(GVariant *inArgs,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
+    virtDBusDomainState state = { 0 };
+    guint generation = 0;
     guint flags;
-    gint state;
-    gint reason;
 
     g_variant_get(inArgs, "(u)", &flags);
 
+    if (flags & VIRT_DBUS_DOMAIN_GET_STATE_LIVE) {
+        flags &= ~VIRT_DBUS_DOMAIN_GET_STATE_LIVE;
+        virtDBusDomainStateInvalidate(connect, objectPath);
+    }
+
+    if (flags == 0 &&
+        virtDBusDomainStateLookup(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_STATE,
+                                  &state, &generation)) {
+        *outArgs = g_variant_new("((ii))", state.state, state.reason);
+        return;
+    }
+
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
         return;
 
-    if (virDomainGetState(domain, &state, &reason, flags) < 0)
+    if (virDomainGetState(domain, &state.state, &state.reason, flags) < 0)
         return virtDBusUtilSetLastVirtError(error);
 
-    *outArgs = g_variant_new("((ii))", state, reason);
+    if (flags == 0) {
+        virtDBusDomainStateUpdate(connect, objectPath,
+                                  VIRT_DBUS_DOMAIN_STATE_STATE,
+                                  &state, generation);
+    }
+
+    *outArgs = g_variant_new("((ii))", state.state, state.reason);
 }
 
 static void
@@ -1657,11 +2189,11 @@ virtDBusDomainGetStats(GVariant *inArgs,
     domains[0] = domain;
     domains[1] = NULL;
 
-    if (virDomainListGetStats(domains, stats, &records, flags) != 1)
+    if (virtDBusStatsListGetStats(domains, stats, &records, flags) != 1)
         return virtDBusUtilSetLastVirtError(error);
 
-    grecords = virtDBusUtilTypedParamsToGVariant(records[0]->params,
-                                                 records[0]->nparams);
+    grecords = virtDBusStatsRecordToGVariant(connect->statsCache, records[0],
+                                             stats, flags, NULL);
 
     *outArgs = g_variant_new_tuple(&grecords, 1);
 }
@@ -1791,10 +2323,24 @@ virtDBusDomainGetXMLDesc(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virDomain) domain = NULL;
     g_autofree gchar *xml = NULL;
+    guint generation = 0;
+    gboolean cacheable;
     guint flags;
 
     g_variant_get(inArgs, "(u)", &flags);
 
+    /* Do not keep passwords in memory longer than necessary. */
+    cacheable = !(flags & VIR_DOMAIN_XML_SECURE);
+
+    if (cacheable) {
+        xml = virtDBusUtilXMLCacheLookup(connect->domainXMLCache, objectPath,
+                                         flags, &generation);
+        if (xml) {
+            *outArgs = g_variant_new("(s)", xml);
+            return;
+        }
+    }
+
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
         return;
@@ -1803,6 +2349,11 @@ virtDBusDomainGetXMLDesc(GVariant *inArgs,
     if (!xml)
         return virtDBusUtilSetLastVirtError(error);
 
+    if (cacheable) {
+        virtDBusUtilXMLCacheInsert(connect->domainXMLCache, objectPath,
+                                   flags, xml, generation);
+    }
+
     *outArgs = g_variant_new("(s)", xml);
 }
 
@@ -1913,11 +2464,24 @@ virtDBusDomainInterfaceAddresses(GVariant *inArgs,
     g_autoptr(virDomain) domain = NULL;
     gint source;
     g_auto(virtDBusDomainInterfaceList) ifaces = { 0 };
+    g_autofree gchar *key = NULL;
     guint flags;
+    gboolean stale;
     GVariantBuilder builder;
     GVariant *res;
 
     g_variant_get(inArgs, "(uu)", &source, &flags);
+    stale = !!(flags & VIRT_DBUS_DOMAIN_AGENT_STALE);
+    flags &= ~VIRT_DBUS_DOMAIN_AGENT_STALE;
+
+    if (source == VIR_DOMAIN_INTERFACE_ADDRESSES_SRC_AGENT) {
+        key = virtDBusDomainAgentCacheKey(objectPath, "InterfaceAddresses",
+                                          g_variant_new("(uu)", source, flags));
+        *outArgs = virtDBusDomainAgentCacheLookup(connect, key,
+                                                  VIRT_DBUS_DOMAIN_AGENT_INTERFACES_TTL);
+        if (*outArgs)
+            return;
+    }
 
     domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
     if (!domain)
@@ -1925,8 +2489,13 @@ virtDBusDomainInterfaceAddresses(GVariant *inArgs,
 
     ifaces.count = virDomainInterfaceAddresses(domain, &(ifaces.ifaces),
                                                source, flags);
-    if (ifaces.count < 0)
-        return virtDBusUtilSetLastVirtError(error);
+    if (ifaces.count < 0) {
+        if (key)
+            *outArgs = virtDBusDomainAgentCacheFallback(connect, key, stale);
+        if (!*outArgs)
+            virtDBusUtilSetLastVirtError(error);
+        return;
+    }
 
 
     g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ssa(isu))"));
@@ -1951,6 +2520,8 @@ virtDBusDomainInterfaceAddresses(GVariant *inArgs,
     res = g_variant_builder_end(&builder);
 
     *outArgs = g_variant_new_tuple(&res, 1);
+    if (key)
+        virtDBusDomainAgentCacheStore(connect, key, outArgs);
 }
 
 static void
@@ -1974,6 +2545,9 @@ virtDBusDomainManagedSave(GVariant *inArgs,
 
     if (virDomainManagedSave(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2252,6 +2826,9 @@ virtDBusDomainMigrateToURI3(GVariant *inArgs,
     if (virDomainMigrateToURI3(domain, dconuri, params.params,
                                params.nparams, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2311,6 +2888,8 @@ virtDBusDomainPinEmulator(GVariant *inArgs,
 
     if (virDomainPinEmulator(domain, cpumap, cpumaplen, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2341,6 +2920,8 @@ virtDBusDomainPinIOThread(GVariant *inArgs,
 
     if (virDomainPinIOThread(domain, iothreadId, cpumap, cpumaplen, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2371,6 +2952,8 @@ virtDBusDomainPinVcpu(GVariant *inArgs,
 
     if (virDomainPinVcpuFlags(domain, vcpu, cpumap, cpumaplen, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2394,6 +2977,9 @@ virtDBusDomainPMWakeup(GVariant *inArgs,
 
     if (virDomainPMWakeup(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2441,8 +3027,12 @@ virtDBusDomainRename(GVariant *inArgs,
     if (!domain)
         return;
 
+    virtDBusUtilHandleCacheRemove(connect->domainCache, objectPath);
+
     if (virDomainRename(domain, name, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2467,6 +3057,9 @@ virtDBusDomainReset(GVariant *inArgs,
 
     if (virDomainReset(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2487,6 +3080,9 @@ virtDBusDomainResume(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virDomainResume(domain) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2514,6 +3110,9 @@ virtDBusDomainSave(GVariant *inArgs,
 
     if (virDomainSaveFlags(domain, to, xml, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2607,6 +3206,8 @@ virtDBusDomainSetBlockIOParameters(GVariant *inArgs,
                                     params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2640,6 +3241,8 @@ virtDBusDomainSetBlockIOTune(GVariant *inArgs,
                                 params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2668,6 +3271,9 @@ virtDBusDomainSetGuestVcpus(GVariant *inArgs,
 
     if (virDomainSetGuestVcpus(domain, cpumap, state, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
+    virtDBusDomainAgentCacheInvalidate(connect, objectPath);
 }
 
 static void
@@ -2701,6 +3307,8 @@ virtDBusDomainSetInterfaceParameters(GVariant *inArgs,
                                         params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2726,6 +3334,8 @@ virtDBusDomainSetMemory(GVariant *inArgs,
 
     if (virDomainSetMemoryFlags(domain, memory, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2758,6 +3368,8 @@ virtDBusDomainSetMemoryParameters(GVariant *inArgs,
                                      params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2783,6 +3395,8 @@ virtDBusDomainSetMemoryStatsPeriod(GVariant *inArgs,
 
     if (virDomainSetMemoryStatsPeriod(domain, period, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2815,6 +3429,8 @@ virtDBusDomainSetMetadata(GVariant *inArgs,
 
     if (virDomainSetMetadata(domain, type, metadata, key, uri, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2847,6 +3463,8 @@ virtDBusDomainSetNumaParameters(GVariant *inArgs,
                                    params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2877,6 +3495,8 @@ virtDBusDomainSetPerfEvents(GVariant *inArgs,
 
     if (virDomainSetPerfEvents(domain, params.params, params.nparams, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2909,6 +3529,8 @@ virtDBusDomainSetSchedulerParameters(GVariant *inArgs,
                                              params.nparams, flags) < 0) {
         virtDBusUtilSetLastVirtError(error);
     }
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -2961,6 +3583,8 @@ virtDBusDomainSetTime(GVariant *inArgs,
 
     if (virDomainSetTime(domain, seconds, nseconds, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainAgentCacheInvalidate(connect, objectPath);
 }
 
 static void
@@ -2986,6 +3610,8 @@ virtDBusDomainSetVcpus(GVariant *inArgs,
 
     if (virDomainSetVcpusFlags(domain, vcpus, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -3009,6 +3635,9 @@ virtDBusDomainShutdown(GVariant *inArgs,
 
     if (virDomainShutdownFlags(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -3072,6 +3701,11 @@ virtDBusDomainSnapshotCreateXML(GVariant *inArgs,
         return;
 
     snapshot = virDomainSnapshotCreateXML(domain, xml, flags);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
+    virtDBusGDBusInvalidateSubtree(connect->domainSnapshotPath);
+
     if (!snapshot)
         return virtDBusUtilSetLastVirtError(error);
 
@@ -3079,6 +3713,8 @@ virtDBusDomainSnapshotCreateXML(GVariant *inArgs,
                                                    snapshot,
                                                    connect->domainSnapshotPath);
 
+    virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+
     *outArgs = g_variant_new("(o)", path);
 }
 
@@ -3136,6 +3772,9 @@ virtDBusDomainSuspend(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virDomainSuspend(domain) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -3159,6 +3798,9 @@ virtDBusDomainUndefine(GVariant *inArgs,
 
     if (virDomainUndefineFlags(domain, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateInvalidate(connect, objectPath);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static void
@@ -3183,115 +3825,118 @@ virtDBusDomainUpdateDevice(GVariant *inArgs,
 
     if (virDomainUpdateDeviceFlags(domain, xml, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, objectPath);
 }
 
 static virtDBusGDBusPropertyTable virtDBusDomainPropertyTable[] = {
-    { "Active", virtDBusDomainGetActive, NULL },
-    { "Autostart", virtDBusDomainGetAutostart, virtDBusDomainSetAutostart },
-    { "Id", virtDBusDomainGetId, NULL },
-    { "Name", virtDBusDomainGetName, NULL },
-    { "OSType", virtDBusDomainGetOsType, NULL },
-    { "Persistent", virtDBusDomainGetPersistent, NULL },
-    { "SchedulerType", virtDBusDomainGetSchedulerType, NULL},
-    { "Updated", virtDBusDomainGetUpdated, NULL },
-    { "UUID", virtDBusDomainGetUUID, NULL },
+    { "Active", virtDBusDomainGetActive, NULL, 0, 0 },
+    { "Autostart", virtDBusDomainGetAutostart, virtDBusDomainSetAutostart, 0, 0 },
+    { "Id", virtDBusDomainGetId, NULL, 0, 0 },
+    { "Name", virtDBusDomainGetName, NULL, 0, 0 },
+    { "OSType", virtDBusDomainGetOsType, NULL, 0, 0 },
+    { "Persistent", virtDBusDomainGetPersistent, NULL, 0, 0 },
+    { "SchedulerType", virtDBusDomainGetSchedulerType, NULL, 0, 0 },
+    { "Updated", virtDBusDomainGetUpdated, NULL, 0, 0 },
+    { "UUID", virtDBusDomainGetUUID, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusDomainMethodTable[] = {
-    { "AbortJob", virtDBusDomainAbortJob },
-    { "AddIOThread", virtDBusDomainAddIOThread },
-    { "AttachDevice", virtDBusDomainAttachDevice },
-    { "BlockCommit", virtDBusDomainBlockCommit },
-    { "BlockCopy", virtDBusDomainBlockCopy },
-    { "BlockJobAbort", virtDBusDomainBlockJobAbort },
-    { "BlockJobSetSpeed", virtDBusDomainBlockJobSetSpeed },
-    { "BlockPeek", virtDBusDomainBlockPeek },
-    { "BlockPull", virtDBusDomainBlockPull },
-    { "BlockRebase", virtDBusDomainBlockRebase },
-    { "BlockResize", virtDBusDomainBlockResize },
-    { "CoreDump", virtDBusDomainCoreDumpWithFormat },
-    { "Create", virtDBusDomainCreate },
-    { "CreateWithFiles", virtDBusDomainCreateWithFiles },
-    { "DelIOThread", virtDBusDomainDelIOThread },
-    { "Destroy", virtDBusDomainDestroy },
-    { "DetachDevice", virtDBusDomainDetachDevice },
-    { "FSFreeze", virtDBusDomainFSFreeze },
-    { "FSThaw", virtDBusDomainFSThaw },
-    { "FSTrim", virtDBusDomainFSTrim },
-    { "GetBlockIOParameters", virtDBusDomainGetBlockIOParameters },
-    { "GetBlockIOTune", virtDBusDomainGetBlockIOTune },
-    { "GetBlockJobInfo", virtDBusDomainGetBlockJobInfo },
-    { "GetControlInfo", virtDBusDomainGetControlInfo },
-    { "GetDiskErrors", virtDBusDomainGetDiskErrors },
-    { "GetEmulatorPinInfo", virtDBusDomainGetEmulatorPinInfo },
-    { "GetFSInfo", virtDBusDomainGetFSInfo },
-    { "GetGuestVcpus", virtDBusDomainGetGuestVcpus },
-    { "GetHostname", virtDBusDomainGetHostname },
-    { "GetInterfaceParameters", virtDBusDomainGetInterfaceParameters },
-    { "GetIOThreadInfo", virtDBusDomainGetIOThreadInfo },
-    { "GetJobInfo", virtDBusDomainGetJobInfo },
-    { "GetJobStats", virtDBusDomainGetJobStats },
-    { "GetMemoryParameters", virtDBusDomainGetMemoryParameters },
-    { "GetMetadata", virtDBusDomainGetMetadata },
-    { "GetNumaParameters", virtDBusDomainGetNumaParameters },
-    { "GetPerfEvents", virtDBusDomainGetPerfEvents },
-    { "GetSchedulerParameters", virtDBusDomainGetSchedulerParameters },
-    { "GetSecurityLabelList", virtDBusDomainGetSecurityLabelList },
-    { "GetState", virtDBusDomainGetState },
-    { "GetStats", virtDBusDomainGetStats },
-    { "GetTime", virtDBusDomainGetTime },
-    { "GetVcpuPinInfo", virtDBusDomainGetVcpuPinInfo },
-    { "GetVcpus", virtDBusDomainGetVcpus },
-    { "GetXMLDesc", virtDBusDomainGetXMLDesc },
-    { "HasManagedSaveImage", virtDBusDomainHasManagedSaveImage },
-    { "InjectNMI", virtDBusDomainInjectNMI },
-    { "InterfaceAddresses", virtDBusDomainInterfaceAddresses },
-    { "ListDomainSnapshots", virtDBusDomainListDomainSnapshots },
-    { "ManagedSave", virtDBusDomainManagedSave },
-    { "ManagedSaveRemove", virtDBusDomainManagedSaveRemove },
-    { "MemoryPeek", virtDBusDomainMemoryPeek },
-    { "MemoryStats", virtDBusDomainMemoryStats },
-    { "MigrateGetCompressionCache", virtDBusDomainMigrateGetCompressionCache },
-    { "MigrateGetMaxSpeed", virtDBusDomainMigrateGetMaxSpeed },
-    { "MigrateSetCompressionCache", virtDBusDomainMigrateSetCompressionCache },
-    { "MigrateSetMaxDowntime", virtDBusDomainMigrateSetMaxDowntime },
-    { "MigrateSetMaxSpeed", virtDBusDomainMigrateSetMaxSpeed },
-    { "MigrateStartPostCopy", virtDBusDomainMigrateStartPostCopy },
-    { "MigrateToURI3", virtDBusDomainMigrateToURI3 },
-    { "OpenGraphicsFD", virtDBusDomainOpenGraphicsFD },
-    { "PinEmulator", virtDBusDomainPinEmulator },
-    { "PinIOThread", virtDBusDomainPinIOThread },
-    { "PinVcpu", virtDBusDomainPinVcpu },
-    { "PMWakeup", virtDBusDomainPMWakeup },
-    { "Reboot", virtDBusDomainReboot },
-    { "Rename", virtDBusDomainRename },
-    { "Reset", virtDBusDomainReset },
-    { "Resume", virtDBusDomainResume },
-    { "Save", virtDBusDomainSave },
-    { "SendKey", virtDBusDomainSendKey },
-    { "SendProcessSignal", virtDBusDomainSendProcessSignal },
-    { "SetBlockIOParameters", virtDBusDomainSetBlockIOParameters },
-    { "SetBlockIOTune", virtDBusDomainSetBlockIOTune },
-    { "SetGuestVcpus", virtDBusDomainSetGuestVcpus },
-    { "SetInterfaceParameters", virtDBusDomainSetInterfaceParameters },
-    { "SetVcpus", virtDBusDomainSetVcpus },
-    { "SetMemory", virtDBusDomainSetMemory },
-    { "SetMemoryParameters", virtDBusDomainSetMemoryParameters },
-    { "SetMemoryStatsPeriod", virtDBusDomainSetMemoryStatsPeriod },
-    { "SetMetadata", virtDBusDomainSetMetadata },
-    { "SetNumaParameters", virtDBusDomainSetNumaParameters },
-    { "SetPerfEvents", virtDBusDomainSetPerfEvents },
-    { "SetSchedulerParameters", virtDBusDomainSetSchedulerParameters },
-    { "SetTime", virtDBusDomainSetTime },
-    { "SetUserPassword", virtDBusDomainSetUserPassword },
-    { "SnapshotCurrent", virtDBusDomainSnapshotCurrent },
-    { "SnapshotCreateXML", virtDBusDomainSnapshotCreateXML },
-    { "SnapshotLookupByName", virtDBusDomainSnapshotLookupByName },
-    { "Shutdown", virtDBusDomainShutdown },
-    { "Suspend", virtDBusDomainSuspend },
-    { "Undefine", virtDBusDomainUndefine },
-    { "UpdateDevice", virtDBusDomainUpdateDevice },
+    { "AbortJob", virtDBusDomainAbortJob, 0 },
+    { "AddIOThread", virtDBusDomainAddIOThread, 0 },
+    { "AgentSetResponseTimeout", virtDBusDomainAgentSetResponseTimeout, 0 },
+    { "AttachDevice", virtDBusDomainAttachDevice, 0 },
+    { "BlockCommit", virtDBusDomainBlockCommit, 0 },
+    { "BlockCopy", virtDBusDomainBlockCopy, 0 },
+    { "BlockJobAbort", virtDBusDomainBlockJobAbort, 0 },
+    { "BlockJobSetSpeed", virtDBusDomainBlockJobSetSpeed, 0 },
+    { "BlockPeek", virtDBusDomainBlockPeek, 0 },
+    { "BlockPull", virtDBusDomainBlockPull, 0 },
+    { "BlockRebase", virtDBusDomainBlockRebase, 0 },
+    { "BlockResize", virtDBusDomainBlockResize, 0 },
+    { "CoreDump", virtDBusDomainCoreDumpWithFormat, 0 },
+    { "Create", virtDBusDomainCreate, 0 },
+    { "CreateWithFiles", virtDBusDomainCreateWithFiles, 0 },
+    { "DelIOThread", virtDBusDomainDelIOThread, 0 },
+    { "Destroy", virtDBusDomainDestroy, 0 },
+    { "DetachDevice", virtDBusDomainDetachDevice, 0 },
+    { "FSFreeze", virtDBusDomainFSFreeze, 0 },
+    { "FSThaw", virtDBusDomainFSThaw, 0 },
+    { "FSTrim", virtDBusDomainFSTrim, 0 },
+    { "GetBlockIOParameters", virtDBusDomainGetBlockIOParameters, 0 },
+    { "GetBlockIOTune", virtDBusDomainGetBlockIOTune, 0 },
+    { "GetBlockJobInfo", virtDBusDomainGetBlockJobInfo, 0 },
+    { "GetControlInfo", virtDBusDomainGetControlInfo, 0 },
+    { "GetDiskErrors", virtDBusDomainGetDiskErrors, 0 },
+    { "GetEmulatorPinInfo", virtDBusDomainGetEmulatorPinInfo, 0 },
+    { "GetFSInfo", virtDBusDomainGetFSInfo, 0 },
+    { "GetGuestVcpus", virtDBusDomainGetGuestVcpus, 0 },
+    { "GetHostname", virtDBusDomainGetHostname, 0 },
+    { "GetInterfaceParameters", virtDBusDomainGetInterfaceParameters, 0 },
+    { "GetIOThreadInfo", virtDBusDomainGetIOThreadInfo, 0 },
+    { "GetJobInfo", virtDBusDomainGetJobInfo, 0 },
+    { "GetJobStats", virtDBusDomainGetJobStats, 0 },
+    { "GetMemoryParameters", virtDBusDomainGetMemoryParameters, 0 },
+    { "GetMetadata", virtDBusDomainGetMetadata, 0 },
+    { "GetNumaParameters", virtDBusDomainGetNumaParameters, 0 },
+    { "GetPerfEvents", virtDBusDomainGetPerfEvents, 0 },
+    { "GetSchedulerParameters", virtDBusDomainGetSchedulerParameters, 0 },
+    { "GetSecurityLabelList", virtDBusDomainGetSecurityLabelList, 0 },
+    { "GetState", virtDBusDomainGetState, 0 },
+    { "GetStats", virtDBusDomainGetStats, 0 },
+    { "GetTime", virtDBusDomainGetTime, 0 },
+    { "GetVcpuPinInfo", virtDBusDomainGetVcpuPinInfo, 0 },
+    { "GetVcpus", virtDBusDomainGetVcpus, 0 },
+    { "GetXMLDesc", virtDBusDomainGetXMLDesc, 0 },
+    { "HasManagedSaveImage", virtDBusDomainHasManagedSaveImage, 0 },
+    { "InjectNMI", virtDBusDomainInjectNMI, 0 },
+    { "InterfaceAddresses", virtDBusDomainInterfaceAddresses, 0 },
+    { "ListDomainSnapshots", virtDBusDomainListDomainSnapshots, 0 },
+    { "ManagedSave", virtDBusDomainManagedSave, 0 },
+    { "ManagedSaveRemove", virtDBusDomainManagedSaveRemove, 0 },
+    { "MemoryPeek", virtDBusDomainMemoryPeek, 0 },
+    { "MemoryStats", virtDBusDomainMemoryStats, 0 },
+    { "MigrateGetCompressionCache", virtDBusDomainMigrateGetCompressionCache, 0 },
+    { "MigrateGetMaxSpeed", virtDBusDomainMigrateGetMaxSpeed, 0 },
+    { "MigrateSetCompressionCache", virtDBusDomainMigrateSetCompressionCache, 0 },
+    { "MigrateSetMaxDowntime", virtDBusDomainMigrateSetMaxDowntime, 0 },
+    { "MigrateSetMaxSpeed", virtDBusDomainMigrateSetMaxSpeed, 0 },
+    { "MigrateStartPostCopy", virtDBusDomainMigrateStartPostCopy, 0 },
+    { "MigrateToURI3", virtDBusDomainMigrateToURI3, 0 },
+    { "OpenGraphicsFD", virtDBusDomainOpenGraphicsFD, 0 },
+    { "PinEmulator", virtDBusDomainPinEmulator, 0 },
+    { "PinIOThread", virtDBusDomainPinIOThread, 0 },
+    { "PinVcpu", virtDBusDomainPinVcpu, 0 },
+    { "PMWakeup", virtDBusDomainPMWakeup, 0 },
+    { "Reboot", virtDBusDomainReboot, 0 },
+    { "Rename", virtDBusDomainRename, 0 },
+    { "Reset", virtDBusDomainReset, 0 },
+    { "Resume", virtDBusDomainResume, 0 },
+    { "Save", virtDBusDomainSave, 0 },
+    { "SendKey", virtDBusDomainSendKey, 0 },
+    { "SendProcessSignal", virtDBusDomainSendProcessSignal, 0 },
+    { "SetBlockIOParameters", virtDBusDomainSetBlockIOParameters, 0 },
+    { "SetBlockIOTune", virtDBusDomainSetBlockIOTune, 0 },
+    { "SetGuestVcpus", virtDBusDomainSetGuestVcpus, 0 },
+    { "SetInterfaceParameters", virtDBusDomainSetInterfaceParameters, 0 },
+    { "SetVcpus", virtDBusDomainSetVcpus, 0 },
+    { "SetMemory", virtDBusDomainSetMemory, 0 },
+    { "SetMemoryParameters", virtDBusDomainSetMemoryParameters, 0 },
+    { "SetMemoryStatsPeriod", virtDBusDomainSetMemoryStatsPeriod, 0 },
+    { "SetMetadata", virtDBusDomainSetMetadata, 0 },
+    { "SetNumaParameters", virtDBusDomainSetNumaParameters, 0 },
+    { "SetPerfEvents", virtDBusDomainSetPerfEvents, 0 },
+    { "SetSchedulerParameters", virtDBusDomainSetSchedulerParameters, 0 },
+    { "SetTime", virtDBusDomainSetTime, 0 },
+    { "SetUserPassword", virtDBusDomainSetUserPassword, 0 },
+    { "SnapshotCurrent", virtDBusDomainSnapshotCurrent, 0 },
+    { "SnapshotCreateXML", virtDBusDomainSnapshotCreateXML, 0 },
+    { "SnapshotLookupByName", virtDBusDomainSnapshotLookupByName, 0 },
+    { "Shutdown", virtDBusDomainShutdown, 0 },
+    { "Suspend", virtDBusDomainSuspend, 0 },
+    { "Undefine", virtDBusDomainUndefine, 0 },
+    { "UpdateDevice", virtDBusDomainUpdateDevice, 0 },
     { 0 }
 };
 
@@ -3323,6 +3968,19 @@ virtDBusDomainEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusDomainExists(const gchar *objectPath,
+                     gpointer userData,
+                     GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virDomain) domain = NULL;
+
+    domain = virtDBusDomainGetVirDomain(connect, objectPath, error);
+
+    return !!domain;
+}
+
 static GDBusInterfaceInfo *interfaceInfo = NULL;
 
 void
@@ -3342,7 +4000,10 @@ virtDBusDomainRegister(virtDBusConnect *connect,
                                  connect->domainPath,
                                  interfaceInfo,
                                  virtDBusDomainEnumerate,
+                                 virtDBusDomainExists,
                                  virtDBusDomainMethodTable,
                                  virtDBusDomainPropertyTable,
-                                 connect);
+                                 virtDBusDomainGetAll,
+                                 connect,
+                                 error);
 }
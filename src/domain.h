@@ -4,6 +4,28 @@
 
 #define VIRT_DBUS_DOMAIN_INTERFACE "org.libvirt.Domain"
 
+virDomainPtr
+virtDBusDomainGetVirDomain(virtDBusConnect *connect,
+                           const gchar *objectPath,
+                           GError **error);
+
+void
+virtDBusDomainStateInvalidate(virtDBusConnect *connect,
+                              const gchar *path);
+
+void
+virtDBusDomainStateClear(virtDBusConnect *connect);
+
+void
+virtDBusDomainAgentResultFree(gpointer opaque);
+
+void
+virtDBusDomainAgentCacheInvalidate(virtDBusConnect *connect,
+                                   const gchar *path);
+
+void
+virtDBusDomainAgentCacheClear(virtDBusConnect *connect);
+
 void
 virtDBusDomainRegister(virtDBusConnect *connect,
                        GError **error);
@@ -10,10 +10,16 @@ virtDBusDomainSnapshotGetVirDomainSnapshot(virtDBusConnect *connect,
                                            GError **error)
 {
     virDomainSnapshotPtr domSnap;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    domSnap = virtDBusUtilHandleCacheLookup(connect->domainSnapshotCache, objectPath,
+                                            connect->connection, &generation);
+    if (domSnap)
+        return domSnap;
+
     domSnap = virtDBusUtilVirDomainSnapshotFromBusPath(connect->connection,
                                                        objectPath,
                                                        connect->domainSnapshotPath);
@@ -22,6 +28,9 @@ virtDBusDomainSnapshotGetVirDomainSnapshot(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->domainSnapshotCache, objectPath,
+                                  connect->connection, domSnap, generation);
+
     return domSnap;
 }
 
@@ -36,6 +45,7 @@ virtDBusDomainSnapshotDelete(GVariant *inArgs,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virDomainSnapshot) domainSnapshot = NULL;
+    gint ret;
     guint flags;
 
     g_variant_get(inArgs, "(u)", &flags);
@@ -46,8 +56,17 @@ virtDBusDomainSnapshotDelete(GVariant *inArgs,
     if (!domainSnapshot)
         return;
 
-    if (virDomainSnapshotDelete(domainSnapshot, flags) < 0)
+    /* Deleting children or metadata only may affect other snapshots too. */
+    virtDBusUtilHandleCacheClear(connect->domainSnapshotCache);
+
+    ret = virDomainSnapshotDelete(domainSnapshot, flags);
+
+    virtDBusGDBusInvalidateSubtree(connect->domainSnapshotPath);
+
+    if (ret < 0)
         return virtDBusUtilSetLastVirtError(error);
+
+    virtDBusGDBusEmitInterfacesRemoved(connect->bus, objectPath);
 }
 
 static void
@@ -210,7 +229,10 @@ virtDBusDomainSnapshotRevert(GVariant *inArgs,
         return;
 
     if (virDomainRevertToSnapshot(domainSnapshot, flags) < 0)
-        return virtDBusUtilSetLastVirtError(error);
+        virtDBusUtilSetLastVirtError(error);
+
+    virtDBusDomainStateClear(connect);
+    virtDBusUtilXMLCacheClear(connect->domainXMLCache);
 }
 
 static virtDBusGDBusPropertyTable virtDBusDomainSnapshotPropertyTable[] = {
@@ -218,21 +240,55 @@ static virtDBusGDBusPropertyTable virtDBusDomainSnapshotPropertyTable[] = {
 };
 
 static virtDBusGDBusMethodTable virtDBusDomainSnapshotMethodTable[] = {
-    { "Delete", virtDBusDomainSnapshotDelete },
-    { "GetParent", virtDBusDomainSnapshotGetParent },
-    { "GetXMLDesc", virtDBusDomainSnapshotGetXMLDesc },
-    { "IsCurrent", virtDBusDomainSnapshotIsCurrent },
-    { "ListChildren", virtDBusDomainSnapshotListAllChildren },
-    { "Revert", virtDBusDomainSnapshotRevert },
+    { "Delete", virtDBusDomainSnapshotDelete, 0 },
+    { "GetParent", virtDBusDomainSnapshotGetParent, 0 },
+    { "GetXMLDesc", virtDBusDomainSnapshotGetXMLDesc, 0 },
+    { "IsCurrent", virtDBusDomainSnapshotIsCurrent, 0 },
+    { "ListChildren", virtDBusDomainSnapshotListAllChildren, 0 },
+    { "Revert", virtDBusDomainSnapshotRevert, 0 },
     { 0 }
 };
 
+static gpointer
+virtDBusDomainSnapshotListDomain(gpointer item,
+                                 gpointer userData)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virDomainSnapshotPtr) domainSnapshots = NULL;
+    gchar **snapPaths;
+    gint numSnaps;
+
+    numSnaps = virDomainListAllSnapshots(item, &domainSnapshots, 0);
+    if (numSnaps <= 0)
+        return NULL;
+
+    snapPaths = g_new0(gchar *, numSnaps + 1);
+    for (gint i = 0; i < numSnaps; i++) {
+        snapPaths[i] = virtDBusUtilBusPathForVirDomainSnapshot(item,
+                                                               domainSnapshots[i],
+                                                               connect->domainSnapshotPath);
+    }
+
+    return snapPaths;
+}
+
+static gchar *
+virtDBusDomainSnapshotDomainKey(gpointer item,
+                                gpointer userData)
+{
+    virtDBusConnect *connect = userData;
+
+    return virtDBusUtilBusPathForVirDomain(item, connect->domainPath);
+}
+
 static gchar **
 virtDBusDomainSnapshotEnumerate(gpointer userData)
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virDomainPtr) domains = NULL;
+    g_autofree gpointer *results = NULL;
     gint numDoms = 0;
+    gboolean partial;
     GPtrArray *list = NULL;
 
     if (!virtDBusConnectOpen(connect, NULL))
@@ -242,24 +298,33 @@ virtDBusDomainSnapshotEnumerate(gpointer userData)
     if (numDoms <= 0)
         return NULL;
 
+    results = virtDBusUtilFanOut((gpointer *)g_steal_pointer(&domains),
+                                 numDoms,
+                                 (GDestroyNotify)virtDBusUtilVirDomainListFree,
+                                 virtDBusDomainSnapshotListDomain,
+                                 virtDBusDomainSnapshotDomainKey,
+                                 (GDestroyNotify)g_strfreev,
+                                 connect,
+                                 VIRT_DBUS_UTIL_FAN_OUT_TIMEOUT,
+                                 &partial);
+
     list = g_ptr_array_new();
 
     for (gint i = 0; i < numDoms; i++) {
-        g_autoptr(virDomainSnapshotPtr) domainSnapshots = NULL;
-        gint numSnaps;
+        gchar **snapPaths = results[i];
 
-        numSnaps = virDomainListAllSnapshots(domains[i], &domainSnapshots, 0);
-        if (numSnaps <= 0)
+        if (!snapPaths)
             continue;
 
-        for (gint j = 0; j < numSnaps; j++) {
-            gchar *snapPath = virtDBusUtilBusPathForVirDomainSnapshot(domains[i],
-                                                                      domainSnapshots[j],
-                                                                      connect->domainSnapshotPath);
-            g_ptr_array_add(list, snapPath);
-        }
+        for (gint j = 0; snapPaths[j]; j++)
+            g_ptr_array_add(list, snapPaths[j]);
+        g_free(snapPaths);
     }
 
+    /* Do not keep the incomplete list in the enumerate cache. */
+    if (partial)
+        virtDBusGDBusInvalidateSubtree(connect->domainSnapshotPath);
+
     if (list->len > 0)
         g_ptr_array_add(list, NULL);
 
@@ -285,7 +350,10 @@ virtDBusDomainSnapshotRegister(virtDBusConnect *connect,
                                  connect->domainSnapshotPath,
                                  interfaceInfo,
                                  virtDBusDomainSnapshotEnumerate,
+                                 NULL,
                                  virtDBusDomainSnapshotMethodTable,
                                  virtDBusDomainSnapshotPropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
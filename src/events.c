@@ -1,10 +1,87 @@
 #include "domain.h"
 #include "events.h"
+#include "network.h"
+#include "secret.h"
 #include "util.h"
 #include "storagepool.h"
 
 #include <libvirt/libvirt.h>
 
+/* Lifecycle events announce objects with InterfacesAdded and their new
+ * properties with PropertiesChanged.  Building them takes libvirt calls
+ * which must not block the main loop delivering the events, so they are
+ * emitted from a single thread keeping the order of the events.  The
+ * Connect signals of the events are still emitted from the callbacks. */
+typedef void (*virtDBusEventsLifecycleFunc)(virtDBusConnect *connect,
+                                            gpointer object,
+                                            const gchar *path,
+                                            gint event,
+                                            gint detail);
+
+struct _virtDBusEventsLifecycle {
+    virtDBusEventsLifecycleFunc func;
+    virtDBusConnect *connect;
+    gpointer object;
+    virtDBusUtilHandleFreeFunc objectFree;
+    gchar *path;
+    gint event;
+    gint detail;
+};
+typedef struct _virtDBusEventsLifecycle virtDBusEventsLifecycle;
+
+static GMutex lifecycleLock;
+static GThreadPool *lifecyclePool = NULL;
+
+static void
+virtDBusEventsLifecycleThread(gpointer threadData,
+                              gpointer userData G_GNUC_UNUSED)
+{
+    virtDBusEventsLifecycle *lifecycle = threadData;
+
+    lifecycle->func(lifecycle->connect, lifecycle->object, lifecycle->path,
+                    lifecycle->event, lifecycle->detail);
+
+    lifecycle->objectFree(lifecycle->object);
+    g_free(lifecycle->path);
+    g_free(lifecycle);
+}
+
+/*
+ * Calls @func in the lifecycle thread.  Takes the reference of @object
+ * and @path.
+ */
+static void
+virtDBusEventsQueueLifecycle(virtDBusConnect *connect,
+                             virtDBusEventsLifecycleFunc func,
+                             gpointer object,
+                             virtDBusUtilHandleFreeFunc objectFree,
+                             gchar *path,
+                             gint event,
+                             gint detail)
+{
+    virtDBusEventsLifecycle *lifecycle = g_new0(virtDBusEventsLifecycle, 1);
+
+    lifecycle->func = func;
+    lifecycle->connect = connect;
+    lifecycle->object = object;
+    lifecycle->objectFree = objectFree;
+    lifecycle->path = path;
+    lifecycle->event = event;
+    lifecycle->detail = detail;
+
+    g_mutex_lock(&lifecycleLock);
+    if (!lifecyclePool) {
+        lifecyclePool = g_thread_pool_new(virtDBusEventsLifecycleThread,
+                                          NULL, 1, FALSE, NULL);
+    }
+    g_mutex_unlock(&lifecycleLock);
+
+    if (lifecyclePool)
+        g_thread_pool_push(lifecyclePool, lifecycle, NULL);
+    else
+        virtDBusEventsLifecycleThread(lifecycle, NULL);
+}
+
 static gint
 virtDBusEventsDomainAgentEvent(virConnectPtr connection G_GNUC_UNUSED,
                                virDomainPtr domain,
@@ -39,6 +116,8 @@ virtDBusEventsDomainBalloonChange(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -63,6 +142,8 @@ virtDBusEventsDomainBlockJob(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -95,6 +176,73 @@ virtDBusEventsDomainControlError(virConnectPtr connection G_GNUC_UNUSED,
     return 0;
 }
 
+/* Properties which may change with a lifecycle event.  Their new values
+ * are read back and sent with PropertiesChanged. */
+static const gchar *const *
+virtDBusEventsDomainChangedProperties(gint event)
+{
+    static const gchar *const defined[] = {
+        "Autostart", "Name", "Persistent", "Updated", NULL
+    };
+    static const gchar *const undefined[] = {
+        "Autostart", "Persistent", "Updated", NULL
+    };
+    static const gchar *const startedStopped[] = {
+        "Active", "Id", "Updated", NULL
+    };
+
+    switch (event) {
+    case VIR_DOMAIN_EVENT_DEFINED:
+        return defined;
+    case VIR_DOMAIN_EVENT_UNDEFINED:
+        return undefined;
+    case VIR_DOMAIN_EVENT_STARTED:
+    case VIR_DOMAIN_EVENT_STOPPED:
+        return startedStopped;
+    }
+
+    return NULL;
+}
+
+static void
+virtDBusEventsDomainLifecycle(virtDBusConnect *connect,
+                              gpointer object,
+                              const gchar *path,
+                              gint event,
+                              gint detail)
+{
+    virDomainPtr domain = object;
+    const gchar *const *properties;
+
+    switch (event) {
+    case VIR_DOMAIN_EVENT_DEFINED:
+        if (detail != VIR_DOMAIN_EVENT_DEFINED_UPDATED)
+            virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        break;
+    case VIR_DOMAIN_EVENT_UNDEFINED:
+        /* A running domain stays around as a transient one. */
+        if (virDomainIsActive(domain) != 1)
+            virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+        break;
+    case VIR_DOMAIN_EVENT_STARTED:
+        if (virDomainIsPersistent(domain) == 0)
+            virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        break;
+    case VIR_DOMAIN_EVENT_STOPPED:
+        /* Transient domains are gone once they stop. */
+        if (virDomainIsPersistent(domain) != 1)
+            virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+        break;
+    }
+
+    properties = virtDBusEventsDomainChangedProperties(event);
+    if (properties) {
+        virtDBusGDBusEmitPropertiesChanged(connect->bus, path,
+                                           VIRT_DBUS_DOMAIN_INTERFACE,
+                                           properties);
+    }
+}
+
 static gint
 virtDBusEventsDomainEvent(virConnectPtr connection G_GNUC_UNUSED,
                           virDomainPtr domain,
@@ -103,10 +251,22 @@ virtDBusEventsDomainEvent(virConnectPtr connection G_GNUC_UNUSED,
                           gpointer opaque)
 {
     virtDBusConnect *connect = opaque;
-    g_autofree gchar *path = NULL;
+    gchar *path = NULL;
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    /* Cached handles carry the domain ID which changes with the state. */
+    virtDBusUtilHandleCacheRemove(connect->domainCache, path);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+    virtDBusDomainStateInvalidate(connect, path);
+    virtDBusDomainAgentCacheInvalidate(connect, path);
+    virtDBusUtilFanOutForget(path);
+    virtDBusGDBusInvalidateSubtree(connect->domainPath);
+    if (event == VIR_DOMAIN_EVENT_UNDEFINED) {
+        virtDBusUtilHandleCacheClear(connect->domainSnapshotCache);
+        virtDBusGDBusInvalidateSubtree(connect->domainSnapshotPath);
+    }
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   connect->connectPath,
@@ -115,6 +275,12 @@ virtDBusEventsDomainEvent(virConnectPtr connection G_GNUC_UNUSED,
                                   g_variant_new("(oii)", path, event, detail),
                                   NULL);
 
+    virDomainRef(domain);
+    virtDBusEventsQueueLifecycle(connect, virtDBusEventsDomainLifecycle,
+                                 domain,
+                                 (virtDBusUtilHandleFreeFunc)virDomainFree,
+                                 path, event, detail);
+
     return 0;
 }
 
@@ -129,6 +295,8 @@ virtDBusEventsDomainDeviceAdded(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -173,6 +341,8 @@ virtDBusEventsDomainDeviceRemoved(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -280,7 +450,7 @@ virtDBusEventsDomainJobCompleted(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
-    gargs = virtDBusUtilTypedParamsToGVariant(params, nparams);
+    gargs = virtDBusUtilTypedParamsToGVariant(params, nparams, NULL);
 
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
@@ -305,6 +475,8 @@ virtDBusEventsDomainMetadataChange(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -459,6 +631,8 @@ virtDBusEventsDomainTrayChange(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -483,7 +657,9 @@ virtDBusEventsDomainTunable(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
-    gargs = virtDBusUtilTypedParamsToGVariant(params, nparams);
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
+    gargs = virtDBusUtilTypedParamsToGVariant(params, nparams, NULL);
 
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
@@ -532,6 +708,8 @@ virtDBusEventsDomainDiskChange(virConnectPtr connection G_GNUC_UNUSED,
 
     path = virtDBusUtilBusPathForVirDomain(domain, connect->domainPath);
 
+    virtDBusUtilXMLCacheRemove(connect->domainXMLCache, path);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -544,18 +722,84 @@ virtDBusEventsDomainDiskChange(virConnectPtr connection G_GNUC_UNUSED,
     return 0;
 }
 
+static const gchar *const *
+virtDBusEventsNetworkChangedProperties(gint event)
+{
+    static const gchar *const defined[] = {
+        "Autostart", "Name", "Persistent", NULL
+    };
+    static const gchar *const undefined[] = {
+        "Autostart", "Persistent", NULL
+    };
+    static const gchar *const startedStopped[] = {
+        "Active", NULL
+    };
+
+    switch (event) {
+    case VIR_NETWORK_EVENT_DEFINED:
+        return defined;
+    case VIR_NETWORK_EVENT_UNDEFINED:
+        return undefined;
+    case VIR_NETWORK_EVENT_STARTED:
+    case VIR_NETWORK_EVENT_STOPPED:
+        return startedStopped;
+    }
+
+    return NULL;
+}
+
+static void
+virtDBusEventsNetworkLifecycle(virtDBusConnect *connect,
+                               gpointer object,
+                               const gchar *path,
+                               gint event,
+                               gint detail G_GNUC_UNUSED)
+{
+    virNetworkPtr network = object;
+    const gchar *const *properties;
+
+    switch (event) {
+    case VIR_NETWORK_EVENT_DEFINED:
+        virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        break;
+    case VIR_NETWORK_EVENT_UNDEFINED:
+        if (virNetworkIsActive(network) != 1)
+            virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+        break;
+    case VIR_NETWORK_EVENT_STARTED:
+        if (virNetworkIsPersistent(network) == 0)
+            virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        break;
+    case VIR_NETWORK_EVENT_STOPPED:
+        if (virNetworkIsPersistent(network) != 1)
+            virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+        break;
+    }
+
+    properties = virtDBusEventsNetworkChangedProperties(event);
+    if (properties) {
+        virtDBusGDBusEmitPropertiesChanged(connect->bus, path,
+                                           VIRT_DBUS_NETWORK_INTERFACE,
+                                           properties);
+    }
+}
+
 static gint
 virtDBusEventsNetworkEvent(virConnectPtr connection G_GNUC_UNUSED,
                            virNetworkPtr network,
                            gint event,
-                           gint detail G_GNUC_UNUSED,
+                           gint detail,
                            gpointer opaque)
 {
     virtDBusConnect *connect = opaque;
-    g_autofree gchar *path = NULL;
+    gchar *path = NULL;
 
     path = virtDBusUtilBusPathForVirNetwork(network, connect->networkPath);
 
+    virtDBusUtilHandleCacheRemove(connect->networkCache, path);
+    virtDBusUtilXMLCacheRemove(connect->networkXMLCache, path);
+    virtDBusGDBusInvalidateSubtree(connect->networkPath);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   connect->connectPath,
@@ -564,9 +808,28 @@ virtDBusEventsNetworkEvent(virConnectPtr connection G_GNUC_UNUSED,
                                   g_variant_new("(oi)", path, event),
                                   NULL);
 
+    virNetworkRef(network);
+    virtDBusEventsQueueLifecycle(connect, virtDBusEventsNetworkLifecycle,
+                                 network,
+                                 (virtDBusUtilHandleFreeFunc)virNetworkFree,
+                                 path, event, detail);
+
     return 0;
 }
 
+static void
+virtDBusEventsNodeDeviceLifecycle(virtDBusConnect *connect,
+                                  gpointer object G_GNUC_UNUSED,
+                                  const gchar *path,
+                                  gint event,
+                                  gint detail G_GNUC_UNUSED)
+{
+    if (event == VIR_NODE_DEVICE_EVENT_CREATED)
+        virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+    else if (event == VIR_NODE_DEVICE_EVENT_DELETED)
+        virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+}
+
 static gint
 virtDBusEventsNodeDeviceEvent(virConnectPtr connection G_GNUC_UNUSED,
                               virNodeDevicePtr dev,
@@ -575,10 +838,13 @@ virtDBusEventsNodeDeviceEvent(virConnectPtr connection G_GNUC_UNUSED,
                               gpointer opaque)
 {
     virtDBusConnect *connect = opaque;
-    g_autofree gchar *path = NULL;
+    gchar *path = NULL;
 
     path = virtDBusUtilBusPathForVirNodeDevice(dev, connect->nodeDevPath);
 
+    virtDBusUtilHandleCacheRemove(connect->nodeDevCache, path);
+    virtDBusGDBusInvalidateSubtree(connect->nodeDevPath);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   connect->connectPath,
@@ -587,9 +853,36 @@ virtDBusEventsNodeDeviceEvent(virConnectPtr connection G_GNUC_UNUSED,
                                   g_variant_new("(oii)", path, event, detail),
                                   NULL);
 
+    virNodeDeviceRef(dev);
+    virtDBusEventsQueueLifecycle(connect, virtDBusEventsNodeDeviceLifecycle,
+                                 dev,
+                                 (virtDBusUtilHandleFreeFunc)virNodeDeviceFree,
+                                 path, event, detail);
+
     return 0;
 }
 
+static void
+virtDBusEventsSecretLifecycle(virtDBusConnect *connect,
+                              gpointer object G_GNUC_UNUSED,
+                              const gchar *path,
+                              gint event,
+                              gint detail G_GNUC_UNUSED)
+{
+    if (event == VIR_SECRET_EVENT_DEFINED) {
+        static const gchar *const properties[] = {
+            "UsageID", "UsageType", NULL
+        };
+
+        virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        virtDBusGDBusEmitPropertiesChanged(connect->bus, path,
+                                           VIRT_DBUS_SECRET_INTERFACE,
+                                           properties);
+    } else if (event == VIR_SECRET_EVENT_UNDEFINED) {
+        virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+    }
+}
+
 static gint
 virtDBusEventsSecretEvent(virConnectPtr connection G_GNUC_UNUSED,
                           virSecretPtr secret,
@@ -598,10 +891,13 @@ virtDBusEventsSecretEvent(virConnectPtr connection G_GNUC_UNUSED,
                           gpointer opaque)
 {
     virtDBusConnect *connect = opaque;
-    g_autofree gchar *path = NULL;
+    gchar *path = NULL;
 
     path = virtDBusUtilBusPathForVirSecret(secret, connect->secretPath);
 
+    virtDBusUtilHandleCacheRemove(connect->secretCache, path);
+    virtDBusGDBusInvalidateSubtree(connect->secretPath);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   connect->connectPath,
@@ -610,9 +906,77 @@ virtDBusEventsSecretEvent(virConnectPtr connection G_GNUC_UNUSED,
                                   g_variant_new("(oii)", path, event, detail),
                                   NULL);
 
+    virSecretRef(secret);
+    virtDBusEventsQueueLifecycle(connect, virtDBusEventsSecretLifecycle,
+                                 secret,
+                                 (virtDBusUtilHandleFreeFunc)virSecretFree,
+                                 path, event, detail);
+
     return 0;
 }
 
+static const gchar *const *
+virtDBusEventsStoragePoolChangedProperties(gint event)
+{
+    static const gchar *const defined[] = {
+        "Autostart", "Name", "Persistent", NULL
+    };
+    static const gchar *const undefined[] = {
+        "Autostart", "Persistent", NULL
+    };
+    static const gchar *const startedStopped[] = {
+        "Active", NULL
+    };
+
+    switch (event) {
+    case VIR_STORAGE_POOL_EVENT_DEFINED:
+        return defined;
+    case VIR_STORAGE_POOL_EVENT_UNDEFINED:
+        return undefined;
+    case VIR_STORAGE_POOL_EVENT_STARTED:
+    case VIR_STORAGE_POOL_EVENT_STOPPED:
+        return startedStopped;
+    }
+
+    return NULL;
+}
+
+static void
+virtDBusEventsStoragePoolLifecycle(virtDBusConnect *connect,
+                                   gpointer object,
+                                   const gchar *path,
+                                   gint event,
+                                   gint detail G_GNUC_UNUSED)
+{
+    virStoragePoolPtr storagePool = object;
+    const gchar *const *properties;
+
+    switch (event) {
+    case VIR_STORAGE_POOL_EVENT_DEFINED:
+        virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        break;
+    case VIR_STORAGE_POOL_EVENT_UNDEFINED:
+        if (virStoragePoolIsActive(storagePool) != 1)
+            virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+        break;
+    case VIR_STORAGE_POOL_EVENT_STARTED:
+        if (virStoragePoolIsPersistent(storagePool) == 0)
+            virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+        break;
+    case VIR_STORAGE_POOL_EVENT_STOPPED:
+        if (virStoragePoolIsPersistent(storagePool) != 1)
+            virtDBusGDBusEmitInterfacesRemoved(connect->bus, path);
+        break;
+    }
+
+    properties = virtDBusEventsStoragePoolChangedProperties(event);
+    if (properties) {
+        virtDBusGDBusEmitPropertiesChanged(connect->bus, path,
+                                           VIRT_DBUS_STORAGEPOOL_INTERFACE,
+                                           properties);
+    }
+}
+
 static gint
 virtDBusEventsStoragePoolEvent(virConnectPtr connection G_GNUC_UNUSED,
                                virStoragePoolPtr storagePool,
@@ -621,11 +985,19 @@ virtDBusEventsStoragePoolEvent(virConnectPtr connection G_GNUC_UNUSED,
                                gpointer opaque)
 {
     virtDBusConnect *connect = opaque;
-    g_autofree gchar *path = NULL;
+    gchar *path = NULL;
 
     path = virtDBusUtilBusPathForVirStoragePool(storagePool,
                                                 connect->storagePoolPath);
 
+    virtDBusUtilHandleCacheRemove(connect->storagePoolCache, path);
+    virtDBusUtilHandleCacheClear(connect->storageVolCache);
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, path);
+    virtDBusUtilXMLCacheClear(connect->storageVolXMLCache);
+    virtDBusUtilFanOutForget(path);
+    virtDBusGDBusInvalidateSubtree(connect->storagePoolPath);
+    virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   connect->connectPath,
@@ -634,6 +1006,12 @@ virtDBusEventsStoragePoolEvent(virConnectPtr connection G_GNUC_UNUSED,
                                   g_variant_new("(oii)", path, event, detail),
                                   NULL);
 
+    virStoragePoolRef(storagePool);
+    virtDBusEventsQueueLifecycle(connect, virtDBusEventsStoragePoolLifecycle,
+                                 storagePool,
+                                 (virtDBusUtilHandleFreeFunc)virStoragePoolFree,
+                                 path, event, detail);
+
     return 0;
 }
 
@@ -648,6 +1026,12 @@ virtDBusEventsStoragePoolRefresh(virConnectPtr connection G_GNUC_UNUSED,
     path = virtDBusUtilBusPathForVirStoragePool(storagePool,
                                                 connect->storagePoolPath);
 
+    /* Volumes may have been added or removed outside of libvirt. */
+    virtDBusUtilHandleCacheClear(connect->storageVolCache);
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, path);
+    virtDBusUtilXMLCacheClear(connect->storageVolXMLCache);
+    virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
     g_dbus_connection_emit_signal(connect->bus,
                                   NULL,
                                   path,
@@ -1,4 +1,5 @@
 #include "gdbus.h"
+#include "util.h"
 
 #include <gio/gunixfdlist.h>
 #include <glib/gprintf.h>
@@ -6,29 +7,133 @@
 struct _virtDBusGDBusMethodData {
     virtDBusGDBusMethodTable *methods;
     virtDBusGDBusPropertyTable *properties;
+    virtDBusGDBusPropertyGetAllFunc getAll;
+    GHashTable *methodIndex;
+    GHashTable *propertyIndex;
     gpointer *userData;
+
+    /* Results of methods and properties with a cacheTTL, see
+     * virtDBusGDBusCacheLookup.  NULL if there are none. */
+    GMutex cacheLock;
+    GHashTable *cache;
+    GQueue cacheOrder;
+
+    /* Subtree the objects belong to, NULL for a single object. */
+    struct _virtDBusGDBusSubtreeData *subtreeData;
 };
 typedef struct _virtDBusGDBusMethodData virtDBusGDBusMethodData;
 
+struct _virtDBusGDBusCacheEntry {
+    GVariant *value;
+    gint64 expires;
+    const gchar *key;
+    GList link;
+};
+typedef struct _virtDBusGDBusCacheEntry virtDBusGDBusCacheEntry;
+
 struct _virtDBusGDBusSubtreeData {
     GDBusInterfaceInfo *interface;
     virtDBusGDBusEnumerateFunc enumerate;
+    virtDBusGDBusLookupFunc lookup;
     virtDBusGDBusMethodData *methodData;
+
+    /* Result of the last enumeration, see virtDBusGDBusEnumerate. */
+    GMutex nodesLock;
+    gchar **nodes;
+    gboolean nodesValid;
+    gboolean nodesPending;
+    gint64 nodesTimestamp;
+    guint nodesGeneration;
+
+    /* Set by the first invalidation, see virtDBusGDBusInvalidateSubtree. */
+    gboolean nodesEnabled;
 };
 typedef struct _virtDBusGDBusSubtreeData virtDBusGDBusSubtreeData;
 
-struct _virtDBusGDBusThreadData {
+struct _virtDBusGDBusRegisterData {
+    GDBusConnection *bus;
+    const gchar *objectPath;
+    GDBusInterfaceInfo *interface;
+    virtDBusGDBusMethodData *methodData;
+    virtDBusGDBusSubtreeData *subtreeData;
+};
+typedef struct _virtDBusGDBusRegisterData virtDBusGDBusRegisterData;
+
+struct _virtDBusGDBusRegistration {
+    gchar *objectPath;
+    GDBusInterfaceInfo *interface;
+    virtDBusGDBusSubtreeData *subtreeData;
+    virtDBusGDBusMethodData *methodData;
+};
+typedef struct _virtDBusGDBusRegistration virtDBusGDBusRegistration;
+
+struct _virtDBusGDBusBatch {
+    GMutex lock;
+    GCond cond;
+    gsize pending;
+};
+typedef struct _virtDBusGDBusBatch virtDBusGDBusBatch;
+
+struct _virtDBusGDBusBatchEntry {
+    virtDBusGDBusBatch *batch;
     const gchar *objectPath;
     const gchar *interfaceName;
     const gchar *methodName;
-    GVariant *parameters;
-    GDBusMethodInvocation *invocation;
-    virtDBusGDBusMethodData *methodData;
+    GVariant *args;
+    GVariant *result;
+    GError *error;
+};
+typedef struct _virtDBusGDBusBatchEntry virtDBusGDBusBatchEntry;
+
+struct _virtDBusGDBusIngressCall {
+    GSourceFunc func;
+    gpointer data;
+    gboolean done;
 };
-typedef struct _virtDBusGDBusThreadData virtDBusGDBusThreadData;
+typedef struct _virtDBusGDBusIngressCall virtDBusGDBusIngressCall;
 
 static const gchar *dbusInterfacePrefix = NULL;
 
+/* Context of the thread that receives all method calls.  It does nothing
+ * else than pushing the calls into the thread pool so it is never delayed
+ * by signals, timers or libvirt events handled by the main loop. */
+static GMainContext *ingressContext = NULL;
+static GMutex ingressLock;
+static GCond ingressCond;
+
+/* Maximum age of a cached subtree enumeration in microseconds.  Subtrees
+ * are invalidated by events where libvirt has them, the age limit
+ * reconciles the cache with changes we are not notified about. */
+#define VIRT_DBUS_GDBUS_ENUMERATE_MAX_AGE (30 * G_USEC_PER_SEC)
+
+/* Upper bound of cached results per registration.  Arguments come from
+ * clients so the number of distinct calls is not limited otherwise. */
+#define VIRT_DBUS_GDBUS_CACHE_MAX_ENTRIES 64
+
+/* Every registered object and subtree so that method calls can be
+ * dispatched without going through the bus, see virtDBusGDBusCallBatch.
+ * Registrations are never removed as objects live as long as the daemon. */
+static GPtrArray *registrations = NULL;
+static GMutex registrationsLock;
+
+/* Processes the calls of all batches, see virtDBusGDBusCallBatch.  It is
+ * shared so that concurrent batches together never use more threads than
+ * the D-Bus thread pool. */
+static GThreadPool *batchPool = NULL;
+
+/* Upper bound of calls in one batch so that a single request cannot
+ * occupy the batch pool for an unbounded time. */
+#define VIRT_DBUS_GDBUS_BATCH_MAX_CALLS 256
+
+/* Refreshes cached subtree enumerations so that the ingress thread never
+ * has to wait for libvirt, see virtDBusGDBusEnumerate.  A single thread
+ * is enough as refreshes of one subtree are coalesced. */
+static GThreadPool *enumeratePool = NULL;
+
+/* Unique bus name of the client whose method call is being processed by
+ * the current thread, see virtDBusGDBusGetSender. */
+static GPrivate currentSender;
+
 /**
  * virtDBusGDBusLoadIntrospectData:
  * @interface: name of the interface
@@ -78,354 +183,2000 @@ virtDBusGDBusLoadIntrospectData(gchar const *interface,
 }
 
 static void
-virtDBusGDBusHandlePropertyGet(GVariant *parameters,
-                               GDBusMethodInvocation *invocation,
-                               const gchar *objectPath,
-                               virtDBusGDBusMethodData *data)
+virtDBusGDBusCacheEntryFree(gpointer opaque)
 {
-    virtDBusGDBusPropertyGetFunc getFunc = NULL;
-    const gchar *interface;
-    const gchar *name;
-    GVariant *value = NULL;
-    g_autoptr(GError) error = NULL;
+    virtDBusGDBusCacheEntry *entry = opaque;
 
-    g_variant_get(parameters, "(&s&s)", &interface, &name);
+    g_variant_unref(entry->value);
+    g_free(entry);
+}
 
-    for (gint i = 0; data->properties[i].name; i++) {
-        if (g_str_equal(name, data->properties[i].name)) {
-            getFunc = data->properties[i].getFunc;
-            break;
-        }
-    }
+static virtDBusGDBusMethodData *
+virtDBusGDBusMethodDataNew(virtDBusGDBusMethodTable *methods,
+                           virtDBusGDBusPropertyTable *properties,
+                           virtDBusGDBusPropertyGetAllFunc getAll,
+                           gpointer userData)
+{
+    virtDBusGDBusMethodData *data = g_new0(virtDBusGDBusMethodData, 1);
 
-    if (!getFunc) {
-        g_dbus_method_invocation_return_error(invocation,
-                                              G_DBUS_ERROR,
-                                              G_DBUS_ERROR_UNKNOWN_PROPERTY,
-                                              "unknown property '%s'", name);
-        return;
-    }
+    data->methods = methods;
+    data->properties = properties;
+    data->getAll = getAll;
+    data->userData = userData;
 
-    getFunc(objectPath, data->userData, &value, &error);
+    data->methodIndex = g_hash_table_new(g_str_hash, g_str_equal);
+    for (gint i = 0; methods[i].name; i++)
+        g_hash_table_insert(data->methodIndex, (gpointer)methods[i].name, &methods[i]);
 
-    if (error) {
-        g_dbus_method_invocation_return_gerror(invocation, error);
-        return;
-    }
+    data->propertyIndex = g_hash_table_new(g_str_hash, g_str_equal);
+    for (gint i = 0; properties[i].name; i++)
+        g_hash_table_insert(data->propertyIndex, (gpointer)properties[i].name, &properties[i]);
 
-    g_return_if_fail(value);
+    g_mutex_init(&data->cacheLock);
+    g_queue_init(&data->cacheOrder);
+    for (gint i = 0; !data->cache && methods[i].name; i++) {
+        if (methods[i].cacheTTL > 0)
+            data->cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                virtDBusGDBusCacheEntryFree);
+    }
+    for (gint i = 0; !data->cache && properties[i].name; i++) {
+        if (properties[i].cacheTTL > 0)
+            data->cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                virtDBusGDBusCacheEntryFree);
+    }
 
-    g_dbus_method_invocation_return_value(invocation,
-                                          g_variant_new("(v)", value));
+    return data;
 }
 
 static void
-virtDBusGDBusHandlePropertySet(GVariant *parameters,
-                               GDBusMethodInvocation *invocation,
-                               const gchar *objectPath,
-                               virtDBusGDBusMethodData *data)
+virtDBusGDBusMethodDataFree(gpointer opaque)
 {
-    virtDBusGDBusPropertySetFunc setFunc = NULL;
-    const gchar *interface;
-    const gchar *name;
-    g_autoptr(GVariant) value = NULL;
-    g_autoptr(GError) error = NULL;
+    virtDBusGDBusMethodData *data = opaque;
 
-    g_variant_get(parameters, "(&s&sv)", &interface, &name, &value);
+    g_hash_table_unref(data->methodIndex);
+    g_hash_table_unref(data->propertyIndex);
+    if (data->cache)
+        g_hash_table_unref(data->cache);
+    g_mutex_clear(&data->cacheLock);
+    g_free(data);
+}
 
-    for (gint i = 0; data->properties[i].name; i++) {
-        if (g_str_equal(name, data->properties[i].name)) {
-            setFunc = data->properties[i].setFunc;
-            break;
-        }
-    }
+/*
+ * Methods and properties are cached per object as subtrees share one
+ * method data for all their objects.  Property keys have no arguments so
+ * they cannot clash with a method of the same name.
+ */
+static gchar *
+virtDBusGDBusCacheKey(const gchar *objectPath,
+                      const gchar *name,
+                      GVariant *args)
+{
+    g_autofree gchar *printed = NULL;
 
-    if (!setFunc) {
-        g_dbus_method_invocation_return_error(invocation,
-                                              G_DBUS_ERROR,
-                                              G_DBUS_ERROR_UNKNOWN_PROPERTY,
-                                              "unknown property '%s'", name);
-        return;
-    }
+    if (!args)
+        return g_strdup_printf("%s %s", objectPath, name);
 
-    setFunc(value, objectPath, data->userData, &error);
+    printed = g_variant_print(args, TRUE);
 
-    if (error)
-        g_dbus_method_invocation_return_gerror(invocation, error);
-    else
-        g_dbus_method_invocation_return_value(invocation, NULL);
+    return g_strdup_printf("%s %s %s", objectPath, name, printed);
 }
 
+/* Has to be called with the cache lock held. */
 static void
-virtDBusGDBusHandlePropertyGetAll(GDBusMethodInvocation *invocation,
-                                  const gchar *objectPath,
-                                  virtDBusGDBusMethodData *data)
+virtDBusGDBusCacheDrop(virtDBusGDBusMethodData *data,
+                       virtDBusGDBusCacheEntry *entry)
 {
-    GVariant *value;
-    g_auto(GVariantBuilder) builder;
+    g_queue_unlink(&data->cacheOrder, &entry->link);
+    g_hash_table_remove(data->cache, entry->key);
+}
 
-    g_variant_builder_init(&builder, G_VARIANT_TYPE("(a{sv})"));
+/*
+ * Returns a new floating copy of the cached value sharing its data so
+ * the caller may treat it exactly like a value returned by a handler.
+ */
+static GVariant *
+virtDBusGDBusCacheLookup(virtDBusGDBusMethodData *data,
+                         const gchar *key)
+{
+    virtDBusGDBusCacheEntry *entry;
+    g_autoptr(GVariant) value = NULL;
+    g_autoptr(GBytes) bytes = NULL;
 
-    g_variant_builder_open(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_mutex_lock(&data->cacheLock);
 
-    for (gint i = 0; data->properties[i].name; i++) {
-        g_autoptr(GError) error = NULL;
+    entry = g_hash_table_lookup(data->cache, key);
+    if (entry && entry->expires <= g_get_monotonic_time()) {
+        virtDBusGDBusCacheDrop(data, entry);
+        entry = NULL;
+    }
 
-        data->properties[i].getFunc(objectPath, data->userData,
-                                    &value, &error);
+    if (entry)
+        value = g_variant_ref(entry->value);
 
-        if (error)
-            continue;
+    g_mutex_unlock(&data->cacheLock);
 
-        g_return_if_fail(value);
+    if (!value)
+        return NULL;
 
-        g_variant_builder_add(&builder, "{sv}",
-                              data->properties[i].name,
-                              g_variant_new_variant(value));
-    }
+    bytes = g_variant_get_data_as_bytes(value);
 
-    g_variant_builder_close(&builder);
+    return g_variant_new_from_bytes(g_variant_get_type(value), bytes, TRUE);
+}
 
-    g_dbus_method_invocation_return_value(invocation,
-                                          g_variant_builder_end(&builder));
+/*
+ * Takes the ownership of the floating @value and replaces it with
+ * a floating copy for the caller.  The oldest entry is dropped if the
+ * cache is full.
+ */
+static void
+virtDBusGDBusCacheInsert(virtDBusGDBusMethodData *data,
+                         gchar *key,
+                         GVariant **value,
+                         gint64 ttl)
+{
+    virtDBusGDBusCacheEntry *entry = g_new0(virtDBusGDBusCacheEntry, 1);
+    virtDBusGDBusCacheEntry *old;
+    g_autoptr(GBytes) bytes = NULL;
+
+    entry->value = g_variant_ref_sink(*value);
+    entry->expires = g_get_monotonic_time() + ttl;
+    entry->key = key;
+    entry->link.data = entry;
+
+    bytes = g_variant_get_data_as_bytes(entry->value);
+    *value = g_variant_new_from_bytes(g_variant_get_type(entry->value),
+                                      bytes, TRUE);
+
+    g_mutex_lock(&data->cacheLock);
+    old = g_hash_table_lookup(data->cache, key);
+    if (old)
+        virtDBusGDBusCacheDrop(data, old);
+    if (g_hash_table_size(data->cache) >= VIRT_DBUS_GDBUS_CACHE_MAX_ENTRIES)
+        virtDBusGDBusCacheDrop(data, g_queue_peek_head(&data->cacheOrder));
+    g_queue_push_tail_link(&data->cacheOrder, &entry->link);
+    g_hash_table_insert(data->cache, key, entry);
+    g_mutex_unlock(&data->cacheLock);
 }
 
 static void
-virtDBusGDBusHandleMethod(GVariant *parameters,
-                          GDBusMethodInvocation *invocation,
-                          const gchar *objectPath,
-                          const gchar *methodName,
-                          virtDBusGDBusMethodData *data)
+virtDBusGDBusCacheRemove(virtDBusGDBusMethodData *data,
+                         const gchar *key)
 {
-    virtDBusGDBusMethodFunc methodFunc = NULL;
-    GDBusMessage *msg = g_dbus_method_invocation_get_message(invocation);
-    GUnixFDList *inFDs = NULL;
-    GVariant *outArgs = NULL;
-    g_autoptr(GUnixFDList) outFDs = NULL;
-    g_autoptr(GError) error = NULL;
+    virtDBusGDBusCacheEntry *entry;
 
-    for (gint i = 0; data->methods[i].name; i++) {
-        if (g_str_equal(methodName, data->methods[i].name)) {
-            methodFunc = data->methods[i].methodFunc;
-            break;
+    g_mutex_lock(&data->cacheLock);
+    entry = g_hash_table_lookup(data->cache, key);
+    if (entry)
+        virtDBusGDBusCacheDrop(data, entry);
+    g_mutex_unlock(&data->cacheLock);
+}
+
+/*
+ * Verifies that the handler tables implement exactly what the interface
+ * XML describes so a mismatch is reported when the daemon starts instead
+ * of when a client happens to call the method.
+ */
+static gboolean
+virtDBusGDBusCheckTables(GDBusInterfaceInfo *interface,
+                         virtDBusGDBusMethodData *data,
+                         GError **error)
+{
+    for (gint i = 0; interface->methods && interface->methods[i]; i++) {
+        const gchar *name = interface->methods[i]->name;
+
+        if (!g_hash_table_contains(data->methodIndex, name)) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "no handler for method '%s' of interface '%s'",
+                        name, interface->name);
+            return FALSE;
         }
     }
 
-    if (!methodFunc) {
-        g_dbus_method_invocation_return_error(invocation,
-                                              G_DBUS_ERROR,
-                                              G_DBUS_ERROR_UNKNOWN_METHOD,
-                                              "unknown method '%s'", methodName);
-        return;
+    for (gint i = 0; data->methods[i].name; i++) {
+        if (!g_dbus_interface_info_lookup_method(interface, data->methods[i].name)) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "method '%s' is not defined by interface '%s'",
+                        data->methods[i].name, interface->name);
+            return FALSE;
+        }
     }
 
-    inFDs = g_dbus_message_get_unix_fd_list(msg);
-
-    methodFunc(parameters, inFDs, objectPath, data->userData,
-               &outArgs, &outFDs, &error);
-
-    if (error) {
-        g_dbus_method_invocation_return_gerror(invocation, error);
-        return;
+    for (gint i = 0; interface->properties && interface->properties[i]; i++) {
+        GDBusPropertyInfo *info = interface->properties[i];
+        virtDBusGDBusPropertyTable *property;
+        gboolean readable = !!(info->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE);
+        gboolean writable = !!(info->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE);
+
+        property = g_hash_table_lookup(data->propertyIndex, info->name);
+
+        if (!property || readable != !!property->getFunc ||
+            writable != !!property->setFunc) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "handlers for property '%s' of interface '%s' "
+                        "do not match its access",
+                        info->name, interface->name);
+            return FALSE;
+        }
     }
 
-    g_return_if_fail(outArgs || !outFDs);
+    for (gint i = 0; data->properties[i].name; i++) {
+        if (!g_dbus_interface_info_lookup_property(interface, data->properties[i].name)) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "property '%s' is not defined by interface '%s'",
+                        data->properties[i].name, interface->name);
+            return FALSE;
+        }
+    }
 
-    g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
-                                                            outArgs,
-                                                            outFDs);
+    return TRUE;
 }
 
-static void
-virtDBusGDBusMethodCallThread(gpointer threadData,
-                              gpointer userData G_GNUC_UNUSED)
+static virtDBusGDBusPropertyTable *
+virtDBusGDBusLookupProperty(virtDBusGDBusMethodData *data,
+                            const gchar *name)
 {
-    g_autofree virtDBusGDBusThreadData *data = threadData;
-
-    if (g_str_equal(data->interfaceName, "org.freedesktop.DBus.Properties")) {
-        if (g_str_equal(data->methodName, "Get")) {
-            virtDBusGDBusHandlePropertyGet(data->parameters, data->invocation,
-                                           data->objectPath, data->methodData);
-        } else if (g_str_equal(data->methodName, "Set")) {
-            virtDBusGDBusHandlePropertySet(data->parameters, data->invocation,
-                                           data->objectPath, data->methodData);
-        } else if (g_str_equal(data->methodName, "GetAll")) {
-            virtDBusGDBusHandlePropertyGetAll(data->invocation, data->objectPath,
-                                              data->methodData);
-        } else {
-            g_dbus_method_invocation_return_error(data->invocation,
-                                                  G_DBUS_ERROR,
-                                                  G_DBUS_ERROR_UNKNOWN_METHOD,
-                                                  "unknown method '%s'",
-                                                  data->methodName);
-        }
-    } else {
-        virtDBusGDBusHandleMethod(data->parameters, data->invocation,
-                                  data->objectPath, data->methodName,
-                                  data->methodData);
-    }
+    return g_hash_table_lookup(data->propertyIndex, name);
 }
 
-GThreadPool *threadPool;
+static gboolean
+virtDBusGDBusNodesFresh(virtDBusGDBusSubtreeData *data)
+{
+    return data->nodesValid &&
+           g_get_monotonic_time() - data->nodesTimestamp < VIRT_DBUS_GDBUS_ENUMERATE_MAX_AGE;
+}
 
-static void
-virtDBusGDBusHandleMethodCall(GDBusConnection *connection G_GNUC_UNUSED,
-                              const gchar *sender G_GNUC_UNUSED,
-                              const gchar *objectPath,
-                              const gchar *interfaceName,
-                              const gchar *methodName,
-                              GVariant *parameters,
-                              GDBusMethodInvocation *invocation,
-                              gpointer userData)
+/* Enumerations list either full object paths or node names, see
+ * virtDBusGDBusNodePath. */
+static gboolean
+virtDBusGDBusNodesContain(gchar **nodes,
+                          const gchar *objectPath)
 {
-    virtDBusGDBusThreadData *data = g_new0(virtDBusGDBusThreadData, 1);
+    const gchar *node = strrchr(objectPath, '/') + 1;
 
-    data->objectPath = objectPath;
-    data->interfaceName = interfaceName;
-    data->methodName = methodName;
-    data->parameters = parameters;
-    data->invocation = invocation;
-    data->methodData = userData;
+    for (gint i = 0; nodes && nodes[i]; i++) {
+        if (g_str_equal(nodes[i], objectPath) || g_str_equal(nodes[i], node))
+            return TRUE;
+    }
 
-    g_thread_pool_push(threadPool, data, NULL);
+    return FALSE;
 }
 
-static const GDBusInterfaceVTable virtDBusGDBusVtable = {
-    virtDBusGDBusHandleMethodCall,
-    NULL,
-    NULL,
-    { 0 }
-};
-
-/**
- * virtDBusGDBusRegisterObject:
- * @bus: GDBus connection
- * @objectPath: object path
- * @interface: interface info of the object
- * @methods: table of method handlers
- * @properties: table of property handlers
- * @userData: data that are passed to method and property handlers
- *
- * Registers a new D-Bus object that we would like to handle.
+/*
+ * Checks whether the last enumeration of the subtree lists the object so
+ * that it is known to exist without asking libvirt.
  */
-void
-virtDBusGDBusRegisterObject(GDBusConnection *bus,
-                            gchar const *objectPath,
-                            GDBusInterfaceInfo *interface,
-                            virtDBusGDBusMethodTable *methods,
-                            virtDBusGDBusPropertyTable *properties,
-                            gpointer userData)
+static gboolean
+virtDBusGDBusHasNode(virtDBusGDBusSubtreeData *data,
+                     const gchar *objectPath)
 {
-    virtDBusGDBusMethodData *data = g_new0(virtDBusGDBusMethodData, 1);
-
-    data->methods = methods;
-    data->properties = properties;
-    data->userData = userData;
+    g_autoptr(GMutexLocker) lock = g_mutex_locker_new(&data->nodesLock);
 
-    g_dbus_connection_register_object(bus,
-                                      objectPath,
-                                      interface,
-                                      &virtDBusGDBusVtable,
-                                      data, g_free,
-                                      NULL);
+    return virtDBusGDBusNodesFresh(data) &&
+           virtDBusGDBusNodesContain(data->nodes, objectPath);
 }
 
 static gchar **
-virtDBusGDBusEnumerate(GDBusConnection *connection G_GNUC_UNUSED,
-                       const gchar *sender G_GNUC_UNUSED,
-                       const gchar *objectPath G_GNUC_UNUSED,
-                       gpointer userData)
+virtDBusGDBusRefreshNodes(virtDBusGDBusSubtreeData *data)
 {
-    virtDBusGDBusSubtreeData *data = userData;
-
-    if (data->enumerate)
-        return data->enumerate(data->methodData->userData);
+    g_autoptr(GMutexLocker) lock = NULL;
+    gint64 now = g_get_monotonic_time();
+    guint generation;
+    gchar **nodes;
+
+    lock = g_mutex_locker_new(&data->nodesLock);
+    generation = data->nodesGeneration;
+    g_clear_pointer(&lock, g_mutex_locker_free);
+
+    nodes = data->enumerate(data->methodData->userData);
+
+    lock = g_mutex_locker_new(&data->nodesLock);
+    if (generation == data->nodesGeneration) {
+        g_strfreev(data->nodes);
+        data->nodes = g_strdupv(nodes);
+        data->nodesValid = TRUE;
+        data->nodesTimestamp = now;
+    }
 
-    return NULL;
+    return nodes;
 }
 
-static GDBusInterfaceInfo **
-virtDBusGDBusIntrospect(GDBusConnection *bus G_GNUC_UNUSED,
-                        const gchar *sender G_GNUC_UNUSED,
-                        const gchar *objectPath G_GNUC_UNUSED,
-                        const gchar *node G_GNUC_UNUSED,
-                        gpointer userData)
+static void
+virtDBusGDBusEnumerateThread(gpointer threadData,
+                             gpointer userData G_GNUC_UNUSED)
 {
-    virtDBusGDBusSubtreeData *data = userData;
-    GDBusInterfaceInfo **ret = g_new0(GDBusInterfaceInfo *, 2);
+    virtDBusGDBusSubtreeData *data = threadData;
 
-    ret[0] = g_dbus_interface_info_ref(data->interface);
+    /* Cleared before enumerating so that an invalidation arriving while
+     * libvirt is queried schedules another refresh. */
+    g_mutex_lock(&data->nodesLock);
+    data->nodesPending = FALSE;
+    g_mutex_unlock(&data->nodesLock);
 
-    return ret;
+    g_strfreev(virtDBusGDBusRefreshNodes(data));
 }
 
-static const GDBusInterfaceVTable *
-virtDBusGDBusDispatch(GDBusConnection *bus G_GNUC_UNUSED,
-                      const gchar *sender G_GNUC_UNUSED,
-                      const gchar *objectPath G_GNUC_UNUSED,
-                      const gchar *interfaceName G_GNUC_UNUSED,
-                      const gchar *node G_GNUC_UNUSED,
-                      gpointer *outUserData,
-                      gpointer userData)
+/* Has to be called with the nodes lock held. */
+static void
+virtDBusGDBusScheduleRefreshNodes(virtDBusGDBusSubtreeData *data)
 {
-    virtDBusGDBusSubtreeData *data = userData;
+    if (!data->enumerate || !enumeratePool || !data->nodesEnabled ||
+        data->nodesPending) {
+        return;
+    }
 
-    *outUserData = data->methodData;
-    return &virtDBusGDBusVtable;
+    data->nodesPending = TRUE;
+    g_thread_pool_push(enumeratePool, data, NULL);
 }
 
-static const GDBusSubtreeVTable virtDBusGDBusSubreeVtable = {
-    virtDBusGDBusEnumerate,
-    virtDBusGDBusIntrospect,
-    virtDBusGDBusDispatch,
-    { 0 }
-};
-
-static void
-virtDBusGDBusSubtreeDataFree(gpointer opaque)
+/*
+ * Returns the objects of the subtree, enumerating them if the cached list
+ * was invalidated or got too old.  Must not be called from the ingress
+ * thread, see virtDBusGDBusEnumerate.
+ */
+static gchar **
+virtDBusGDBusSubtreeNodes(virtDBusGDBusSubtreeData *data)
 {
-    virtDBusGDBusSubtreeData *data = opaque;
-    g_free(data->methodData);
-    g_free(data);
+    if (!data->enumerate)
+        return NULL;
+
+    /* Introspecting clients enumerate the subtree for every object so
+     * the list is reused until it is invalidated or gets too old. */
+    g_mutex_lock(&data->nodesLock);
+    if (virtDBusGDBusNodesFresh(data)) {
+        gchar **nodes = g_strdupv(data->nodes);
+
+        g_mutex_unlock(&data->nodesLock);
+        return nodes;
+    }
+    g_mutex_unlock(&data->nodesLock);
+
+    return virtDBusGDBusRefreshNodes(data);
 }
 
-/**
- * virtDBusGDBusRegisterSubtree:
- * @bus: GDBus connection
- * @objectPath: object prefix path
- * @interface: interface info of the object
- * @methods: table of method handlers
- * @properties: table of property handlers
- * @userData: data that are passed to method and property handlers
- *
- * Registers a new D-Bus object prefix that we would like to handle.
+/*
+ * Checks that the subtree contains the object.  Objects not listed by the
+ * last enumeration are looked up on their own as the list may be outdated
+ * or incomplete.  Must not be called from the ingress thread unless
+ * virtDBusGDBusHasNode succeeded.
  */
-void
-virtDBusGDBusRegisterSubtree(GDBusConnection *bus,
-                             gchar const *objectPath,
-                             GDBusInterfaceInfo *interface,
-                             virtDBusGDBusEnumerateFunc enumerate,
-                             virtDBusGDBusMethodTable *methods,
-                             virtDBusGDBusPropertyTable *properties,
-                             gpointer userData)
+static gboolean
+virtDBusGDBusSubtreeHasObject(virtDBusGDBusSubtreeData *data,
+                              const gchar *objectPath,
+                              GError **error)
 {
-    virtDBusGDBusSubtreeData *data = g_new0(virtDBusGDBusSubtreeData, 1);
+    if (!data->lookup || virtDBusGDBusHasNode(data, objectPath))
+        return TRUE;
 
-    data->methodData = g_new0(virtDBusGDBusMethodData, 1);
+    return data->lookup(objectPath, data->methodData->userData, error);
+}
 
-    data->interface = interface;
-    data->enumerate = enumerate;
-    data->methodData->methods = methods;
-    data->methodData->properties = properties;
-    data->methodData->userData = userData;
+static void
+virtDBusGDBusReadProperty(virtDBusGDBusMethodData *data,
+                          virtDBusGDBusPropertyTable *property,
+                          const gchar *objectPath,
+                          GVariant **value,
+                          GError **error)
+{
+    g_autofree gchar *key = NULL;
 
-    g_dbus_connection_register_subtree(bus,
-                                       objectPath,
-                                       &virtDBusGDBusSubreeVtable,
+    /* Inline getters only decode the object path. */
+    if ((property->flags & VIRT_DBUS_GDBUS_PROPERTY_INLINE) &&
+        data->subtreeData &&
+        !virtDBusGDBusSubtreeHasObject(data->subtreeData, objectPath, error)) {
+        return;
+    }
+
+    if (property->cacheTTL <= 0) {
+        property->getFunc(objectPath, data->userData, value, error);
+        return;
+    }
+
+    key = virtDBusGDBusCacheKey(objectPath, property->name, NULL);
+
+    *value = virtDBusGDBusCacheLookup(data, key);
+    if (*value)
+        return;
+
+    property->getFunc(objectPath, data->userData, value, error);
+
+    if (*value && !(error && *error))
+        virtDBusGDBusCacheInsert(data, g_steal_pointer(&key), value,
+                                 property->cacheTTL);
+}
+
+/*
+ * Reads the property bypassing the cache, for example after an event
+ * announced its change, and replaces the cached value with the result.
+ */
+static gboolean
+virtDBusGDBusRefreshProperty(virtDBusGDBusMethodData *data,
+                             const gchar *objectPath,
+                             const gchar *name,
+                             GVariant **value,
+                             GError **error)
+{
+    virtDBusGDBusPropertyTable *property;
+
+    property = virtDBusGDBusLookupProperty(data, name);
+
+    if (!property || !property->getFunc) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "unknown property '%s'", name);
+        return FALSE;
+    }
+
+    property->getFunc(objectPath, data->userData, value, error);
+
+    if (error && *error)
+        return FALSE;
+
+    g_return_val_if_fail(*value, FALSE);
+
+    if (property->cacheTTL > 0) {
+        virtDBusGDBusCacheInsert(data,
+                                 virtDBusGDBusCacheKey(objectPath, name, NULL),
+                                 value, property->cacheTTL);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+virtDBusGDBusGetProperty(virtDBusGDBusMethodData *data,
+                         const gchar *objectPath,
+                         const gchar *name,
+                         GVariant **value,
+                         GError **error)
+{
+    virtDBusGDBusPropertyTable *property;
+
+    property = virtDBusGDBusLookupProperty(data, name);
+
+    if (!property || !property->getFunc) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "unknown property '%s'", name);
+        return FALSE;
+    }
+
+    virtDBusGDBusReadProperty(data, property, objectPath, value, error);
+
+    if (error && *error)
+        return FALSE;
+
+    g_return_val_if_fail(*value, FALSE);
+
+    return TRUE;
+}
+
+static gboolean
+virtDBusGDBusSetProperty(virtDBusGDBusMethodData *data,
+                         const gchar *objectPath,
+                         const gchar *name,
+                         GVariant *value,
+                         GError **error)
+{
+    virtDBusGDBusPropertyTable *property;
+    virtDBusGDBusPropertySetFunc setFunc = NULL;
+
+    property = virtDBusGDBusLookupProperty(data, name);
+    if (property)
+        setFunc = property->setFunc;
+
+    if (!setFunc) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "unknown property '%s'", name);
+        return FALSE;
+    }
+
+    setFunc(value, objectPath, data->userData, error);
+
+    if (property->cacheTTL > 0) {
+        g_autofree gchar *key = virtDBusGDBusCacheKey(objectPath, name, NULL);
+
+        virtDBusGDBusCacheRemove(data, key);
+    }
+
+    return !(error && *error);
+}
+
+static GVariant *
+virtDBusGDBusGetPropertiesDict(virtDBusGDBusMethodData *data,
+                               const gchar *objectPath)
+{
+    guint nproperties = g_hash_table_size(data->propertyIndex);
+    GVariant **entries = g_newa(GVariant *, MAX(nproperties, 1));
+    guint nentries = 0;
+    g_autoptr(GVariant) values = NULL;
+    GVariant *value;
+
+    if (data->getAll) {
+        g_autoptr(GError) error = NULL;
+
+        data->getAll(objectPath, data->userData, &values, &error);
+        if (error)
+            g_clear_pointer(&values, g_variant_unref);
+        else if (values)
+            g_variant_ref_sink(values);
+    }
+
+    for (gint i = 0; data->properties[i].name; i++) {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) bulkValue = NULL;
+
+        /* virtDBusGDBusCheckTables ties getFunc to the READABLE flag. */
+        if (!data->properties[i].getFunc)
+            continue;
+
+        if (values)
+            bulkValue = g_variant_lookup_value(values, data->properties[i].name, NULL);
+
+        value = bulkValue;
+        if (!value) {
+            virtDBusGDBusReadProperty(data, &data->properties[i], objectPath,
+                                      &value, &error);
+        }
+
+        if (error)
+            continue;
+
+        g_return_val_if_fail(value, NULL);
+
+        entries[nentries++] = g_variant_new_dict_entry(g_variant_new_string(data->properties[i].name),
+                                                       g_variant_new_variant(value));
+    }
+
+    return g_variant_new_array(G_VARIANT_TYPE("{sv}"), entries, nentries);
+}
+
+static GVariant *
+virtDBusGDBusGetAllProperties(virtDBusGDBusMethodData *data,
+                              const gchar *objectPath)
+{
+    GVariant *dict = virtDBusGDBusGetPropertiesDict(data, objectPath);
+
+    g_return_val_if_fail(dict, NULL);
+
+    return g_variant_new_tuple(&dict, 1);
+}
+
+static void
+virtDBusGDBusHandlePropertyGet(GVariant *parameters,
+                               GDBusMethodInvocation *invocation,
+                               const gchar *objectPath,
+                               virtDBusGDBusMethodData *data)
+{
+    const gchar *interface;
+    const gchar *name;
+    GVariant *value = NULL;
+    g_autoptr(GError) error = NULL;
+
+    g_variant_get(parameters, "(&s&s)", &interface, &name);
+
+    if (!virtDBusGDBusGetProperty(data, objectPath, name, &value, &error)) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(v)", value));
+}
+
+static void
+virtDBusGDBusHandlePropertySet(GVariant *parameters,
+                               GDBusMethodInvocation *invocation,
+                               const gchar *objectPath,
+                               virtDBusGDBusMethodData *data)
+{
+    const gchar *interface;
+    const gchar *name;
+    g_autoptr(GVariant) value = NULL;
+    g_autoptr(GError) error = NULL;
+
+    g_variant_get(parameters, "(&s&sv)", &interface, &name, &value);
+
+    if (!virtDBusGDBusSetProperty(data, objectPath, name, value, &error))
+        g_dbus_method_invocation_return_gerror(invocation, error);
+    else
+        g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static void
+virtDBusGDBusHandlePropertyGetAll(GDBusMethodInvocation *invocation,
+                                  const gchar *objectPath,
+                                  virtDBusGDBusMethodData *data)
+{
+    GVariant *value = virtDBusGDBusGetAllProperties(data, objectPath);
+
+    g_return_if_fail(value);
+
+    g_dbus_method_invocation_return_value(invocation, value);
+}
+
+static gboolean
+virtDBusGDBusCallMethod(virtDBusGDBusMethodData *data,
+                        const gchar *objectPath,
+                        const gchar *methodName,
+                        GVariant *parameters,
+                        GUnixFDList *inFDs,
+                        GVariant **outArgs,
+                        GUnixFDList **outFDs,
+                        GError **error)
+{
+    virtDBusGDBusMethodTable *method;
+    g_autofree gchar *key = NULL;
+
+    method = g_hash_table_lookup(data->methodIndex, methodName);
+    if (!method || !method->methodFunc) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                    "unknown method '%s'", methodName);
+        return FALSE;
+    }
+
+    if (method->cacheTTL > 0) {
+        key = virtDBusGDBusCacheKey(objectPath, methodName, parameters);
+        *outArgs = virtDBusGDBusCacheLookup(data, key);
+        if (*outArgs)
+            return TRUE;
+    }
+
+    method->methodFunc(parameters, inFDs, objectPath, data->userData,
+                       outArgs, outFDs, error);
+
+    if (error && *error)
+        return FALSE;
+
+    g_return_val_if_fail(*outArgs || !*outFDs, FALSE);
+
+    /* File descriptors cannot be shared between replies. */
+    if (key && *outArgs && !*outFDs)
+        virtDBusGDBusCacheInsert(data, g_steal_pointer(&key), outArgs,
+                                 method->cacheTTL);
+
+    return TRUE;
+}
+
+static void
+virtDBusGDBusHandleMethod(GVariant *parameters,
+                          GDBusMethodInvocation *invocation,
+                          const gchar *objectPath,
+                          const gchar *methodName,
+                          virtDBusGDBusMethodData *data)
+{
+    GDBusMessage *msg = g_dbus_method_invocation_get_message(invocation);
+    GUnixFDList *inFDs = NULL;
+    GVariant *outArgs = NULL;
+    g_autoptr(GUnixFDList) outFDs = NULL;
+    g_autoptr(GError) error = NULL;
+
+    inFDs = g_dbus_message_get_unix_fd_list(msg);
+
+    g_private_set(&currentSender,
+                  (gpointer)g_dbus_method_invocation_get_sender(invocation));
+
+    if (!virtDBusGDBusCallMethod(data, objectPath, methodName, parameters,
+                                 inFDs, &outArgs, &outFDs, &error)) {
+        g_private_set(&currentSender, NULL);
+        if (error)
+            g_dbus_method_invocation_return_gerror(invocation, error);
+        return;
+    }
+
+    g_private_set(&currentSender, NULL);
+
+    g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+                                                            outArgs,
+                                                            outFDs);
+}
+
+/*
+ * The invocation itself is queued for the thread pool as it already
+ * carries everything needed to process the call so no per-call data
+ * have to be allocated.
+ */
+static void
+virtDBusGDBusMethodCallThread(gpointer threadData,
+                              gpointer userData G_GNUC_UNUSED)
+{
+    GDBusMethodInvocation *invocation = threadData;
+    const gchar *objectPath = g_dbus_method_invocation_get_object_path(invocation);
+    const gchar *interfaceName = g_dbus_method_invocation_get_interface_name(invocation);
+    const gchar *methodName = g_dbus_method_invocation_get_method_name(invocation);
+    GVariant *parameters = g_dbus_method_invocation_get_parameters(invocation);
+    virtDBusGDBusMethodData *methodData = g_dbus_method_invocation_get_user_data(invocation);
+
+    if (g_str_equal(interfaceName, "org.freedesktop.DBus.Properties")) {
+        if (g_str_equal(methodName, "Get")) {
+            virtDBusGDBusHandlePropertyGet(parameters, invocation,
+                                           objectPath, methodData);
+        } else if (g_str_equal(methodName, "Set")) {
+            virtDBusGDBusHandlePropertySet(parameters, invocation,
+                                           objectPath, methodData);
+        } else if (g_str_equal(methodName, "GetAll")) {
+            virtDBusGDBusHandlePropertyGetAll(invocation, objectPath,
+                                              methodData);
+        } else {
+            g_dbus_method_invocation_return_error(invocation,
+                                                  G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_UNKNOWN_METHOD,
+                                                  "unknown method '%s'",
+                                                  methodName);
+        }
+    } else {
+        virtDBusGDBusHandleMethod(parameters, invocation, objectPath,
+                                  methodName, methodData);
+    }
+}
+
+GThreadPool *threadPool;
+
+/*
+ * Properties that do not need libvirt are answered directly from the
+ * ingress thread, avoiding the round trip through the thread pool.  Such
+ * properties are derived from the object path, so objects of a subtree
+ * are answered directly only if its last enumeration lists them, other
+ * objects are looked up by virtDBusGDBusReadProperty in the thread pool.
+ */
+static gboolean
+virtDBusGDBusIsInlinePropertyGet(const gchar *objectPath,
+                                 const gchar *interfaceName,
+                                 const gchar *methodName,
+                                 GVariant *parameters,
+                                 virtDBusGDBusMethodData *data)
+{
+    virtDBusGDBusPropertyTable *property;
+    const gchar *name;
+
+    if (!g_str_equal(interfaceName, "org.freedesktop.DBus.Properties") ||
+        !g_str_equal(methodName, "Get")) {
+        return FALSE;
+    }
+
+    g_variant_get(parameters, "(&s&s)", NULL, &name);
+
+    property = virtDBusGDBusLookupProperty(data, name);
+    if (!property || !(property->flags & VIRT_DBUS_GDBUS_PROPERTY_INLINE))
+        return FALSE;
+
+    return !data->subtreeData ||
+           virtDBusGDBusHasNode(data->subtreeData, objectPath);
+}
+
+static void
+virtDBusGDBusHandleMethodCall(GDBusConnection *connection G_GNUC_UNUSED,
+                              const gchar *sender G_GNUC_UNUSED,
+                              const gchar *objectPath,
+                              const gchar *interfaceName,
+                              const gchar *methodName,
+                              GVariant *parameters,
+                              GDBusMethodInvocation *invocation,
+                              gpointer userData)
+{
+    if (virtDBusGDBusIsInlinePropertyGet(objectPath, interfaceName,
+                                         methodName, parameters, userData)) {
+        virtDBusGDBusHandlePropertyGet(parameters, invocation,
+                                       objectPath, userData);
+        return;
+    }
+
+    g_thread_pool_push(threadPool, invocation, NULL);
+}
+
+static const GDBusInterfaceVTable virtDBusGDBusVtable = {
+    virtDBusGDBusHandleMethodCall,
+    NULL,
+    NULL,
+    { 0 }
+};
+
+static gboolean
+virtDBusGDBusIngressCallFunc(gpointer opaque)
+{
+    virtDBusGDBusIngressCall *call = opaque;
+
+    call->func(call->data);
+
+    g_mutex_lock(&ingressLock);
+    call->done = TRUE;
+    g_cond_broadcast(&ingressCond);
+    g_mutex_unlock(&ingressLock);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Runs @func in the ingress thread and waits for it to finish.  GDBus
+ * dispatches method calls into the thread-default main context that was
+ * active when the object was registered so the registration itself has to
+ * happen in the ingress thread.
+ */
+static void
+virtDBusGDBusIngressInvoke(GSourceFunc func,
+                           gpointer data)
+{
+    virtDBusGDBusIngressCall call = { func, data, FALSE };
+
+    if (!ingressContext) {
+        func(data);
+        return;
+    }
+
+    g_main_context_invoke_full(ingressContext, G_PRIORITY_HIGH,
+                               virtDBusGDBusIngressCallFunc, &call, NULL);
+
+    g_mutex_lock(&ingressLock);
+    while (!call.done)
+        g_cond_wait(&ingressCond, &ingressLock);
+    g_mutex_unlock(&ingressLock);
+}
+
+static void
+virtDBusGDBusAddRegistration(const gchar *objectPath,
+                             GDBusInterfaceInfo *interface,
+                             virtDBusGDBusSubtreeData *subtreeData,
+                             virtDBusGDBusMethodData *methodData)
+{
+    virtDBusGDBusRegistration *registration = g_new0(virtDBusGDBusRegistration, 1);
+
+    registration->objectPath = g_strdup(objectPath);
+    registration->interface = g_dbus_interface_info_ref(interface);
+    registration->subtreeData = subtreeData;
+    registration->methodData = methodData;
+
+    g_mutex_lock(&registrationsLock);
+    if (!registrations)
+        registrations = g_ptr_array_new();
+    g_ptr_array_add(registrations, registration);
+    g_mutex_unlock(&registrationsLock);
+}
+
+static gboolean
+virtDBusGDBusRegistrationMatches(virtDBusGDBusRegistration *registration,
+                                 const gchar *objectPath)
+{
+    gsize len = strlen(registration->objectPath);
+
+    if (!registration->subtreeData)
+        return g_str_equal(objectPath, registration->objectPath);
+
+    /* Subtrees dispatch only to direct children of the prefix. */
+    return strncmp(objectPath, registration->objectPath, len) == 0 &&
+           objectPath[len] == '/' && objectPath[len + 1] &&
+           !strchr(objectPath + len + 1, '/');
+}
+
+static virtDBusGDBusRegistration *
+virtDBusGDBusLookupRegistration(const gchar *objectPath,
+                                const gchar *interfaceName)
+{
+    virtDBusGDBusRegistration *ret = NULL;
+
+    g_mutex_lock(&registrationsLock);
+    for (guint i = 0; registrations && i < registrations->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(registrations, i);
+
+        if (!g_str_equal(registration->interface->name, interfaceName))
+            continue;
+
+        if (!virtDBusGDBusRegistrationMatches(registration, objectPath))
+            continue;
+
+        ret = registration;
+        break;
+    }
+    g_mutex_unlock(&registrationsLock);
+
+    return ret;
+}
+
+/* Returns a copy of the list of registrations so that they can be walked
+ * without holding the lock while calling into libvirt. */
+static GPtrArray *
+virtDBusGDBusListRegistrations(void)
+{
+    GPtrArray *ret = g_ptr_array_new();
+
+    g_mutex_lock(&registrationsLock);
+    for (guint i = 0; registrations && i < registrations->len; i++)
+        g_ptr_array_add(ret, g_ptr_array_index(registrations, i));
+    g_mutex_unlock(&registrationsLock);
+
+    return ret;
+}
+
+static gboolean
+virtDBusGDBusRegisterObjectFunc(gpointer opaque)
+{
+    virtDBusGDBusRegisterData *data = opaque;
+
+    g_dbus_connection_register_object(data->bus,
+                                      data->objectPath,
+                                      data->interface,
+                                      &virtDBusGDBusVtable,
+                                      data->methodData,
+                                      virtDBusGDBusMethodDataFree,
+                                      NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * virtDBusGDBusRegisterObject:
+ * @bus: GDBus connection
+ * @objectPath: object path
+ * @interface: interface info of the object
+ * @methods: table of method handlers
+ * @properties: table of property handlers
+ * @userData: data that are passed to method and property handlers
+ * @error: return location for error
+ *
+ * Registers a new D-Bus object that we would like to handle.
+ *
+ * Returns TRUE on success, FALSE if the handler tables do not match
+ * @interface and sets @error.
+ */
+gboolean
+virtDBusGDBusRegisterObject(GDBusConnection *bus,
+                            gchar const *objectPath,
+                            GDBusInterfaceInfo *interface,
+                            virtDBusGDBusMethodTable *methods,
+                            virtDBusGDBusPropertyTable *properties,
+                            gpointer userData,
+                            GError **error)
+{
+    virtDBusGDBusMethodData *data;
+    virtDBusGDBusRegisterData registerData = { 0 };
+
+    data = virtDBusGDBusMethodDataNew(methods, properties, NULL, userData);
+
+    if (!virtDBusGDBusCheckTables(interface, data, error)) {
+        virtDBusGDBusMethodDataFree(data);
+        return FALSE;
+    }
+
+    virtDBusGDBusAddRegistration(objectPath, interface, NULL, data);
+
+    registerData.bus = bus;
+    registerData.objectPath = objectPath;
+    registerData.interface = interface;
+    registerData.methodData = data;
+
+    virtDBusGDBusIngressInvoke(virtDBusGDBusRegisterObjectFunc, &registerData);
+
+    return TRUE;
+}
+
+/*
+ * GDBus enumerates subtrees in the ingress thread which must not wait for
+ * libvirt.  The last enumeration is returned even if it was invalidated or
+ * got too old and a refresh is scheduled instead; until the first refresh
+ * finishes the subtree appears empty to introspection while method calls
+ * are still dispatched to its objects.  No refresh is scheduled before the
+ * first invalidation of the subtree.
+ */
+static gchar **
+virtDBusGDBusEnumerate(GDBusConnection *connection G_GNUC_UNUSED,
+                       const gchar *sender G_GNUC_UNUSED,
+                       const gchar *objectPath G_GNUC_UNUSED,
+                       gpointer userData)
+{
+    virtDBusGDBusSubtreeData *data = userData;
+    g_autoptr(GMutexLocker) lock = g_mutex_locker_new(&data->nodesLock);
+
+    if (!virtDBusGDBusNodesFresh(data))
+        virtDBusGDBusScheduleRefreshNodes(data);
+
+    return g_strdupv(data->nodes);
+}
+
+static GDBusInterfaceInfo **
+virtDBusGDBusIntrospect(GDBusConnection *bus G_GNUC_UNUSED,
+                        const gchar *sender G_GNUC_UNUSED,
+                        const gchar *objectPath G_GNUC_UNUSED,
+                        const gchar *node G_GNUC_UNUSED,
+                        gpointer userData)
+{
+    virtDBusGDBusSubtreeData *data = userData;
+    GDBusInterfaceInfo **ret = g_new0(GDBusInterfaceInfo *, 2);
+
+    ret[0] = g_dbus_interface_info_ref(data->interface);
+
+    return ret;
+}
+
+static const GDBusInterfaceVTable *
+virtDBusGDBusDispatch(GDBusConnection *bus G_GNUC_UNUSED,
+                      const gchar *sender G_GNUC_UNUSED,
+                      const gchar *objectPath G_GNUC_UNUSED,
+                      const gchar *interfaceName G_GNUC_UNUSED,
+                      const gchar *node G_GNUC_UNUSED,
+                      gpointer *outUserData,
+                      gpointer userData)
+{
+    virtDBusGDBusSubtreeData *data = userData;
+
+    *outUserData = data->methodData;
+    return &virtDBusGDBusVtable;
+}
+
+static const GDBusSubtreeVTable virtDBusGDBusSubreeVtable = {
+    virtDBusGDBusEnumerate,
+    virtDBusGDBusIntrospect,
+    virtDBusGDBusDispatch,
+    { 0 }
+};
+
+static void
+virtDBusGDBusSubtreeDataFree(gpointer opaque)
+{
+    virtDBusGDBusSubtreeData *data = opaque;
+    virtDBusGDBusMethodDataFree(data->methodData);
+    g_strfreev(data->nodes);
+    g_mutex_clear(&data->nodesLock);
+    g_free(data);
+}
+
+static gboolean
+virtDBusGDBusRegisterSubtreeFunc(gpointer opaque)
+{
+    virtDBusGDBusRegisterData *data = opaque;
+
+    g_dbus_connection_register_subtree(data->bus,
+                                       data->objectPath,
+                                       &virtDBusGDBusSubreeVtable,
                                        G_DBUS_SUBTREE_FLAGS_DISPATCH_TO_UNENUMERATED_NODES,
-                                       data,
+                                       data->subtreeData,
                                        virtDBusGDBusSubtreeDataFree,
                                        NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * virtDBusGDBusRegisterSubtree:
+ * @bus: GDBus connection
+ * @objectPath: object prefix path
+ * @interface: interface info of the object
+ * @enumerate: handler listing the objects of the subtree
+ * @lookup: optional handler checking that a single object exists, needed
+ *   if any property is flagged with VIRT_DBUS_GDBUS_PROPERTY_INLINE
+ * @methods: table of method handlers
+ * @properties: table of property handlers
+ * @getAll: optional handler reading several properties at once
+ * @userData: data that are passed to method and property handlers
+ * @error: return location for error
+ *
+ * Registers a new D-Bus object prefix that we would like to handle.
+ *
+ * Returns TRUE on success, FALSE if the handler tables do not match
+ * @interface and sets @error.
+ */
+gboolean
+virtDBusGDBusRegisterSubtree(GDBusConnection *bus,
+                             gchar const *objectPath,
+                             GDBusInterfaceInfo *interface,
+                             virtDBusGDBusEnumerateFunc enumerate,
+                             virtDBusGDBusLookupFunc lookup,
+                             virtDBusGDBusMethodTable *methods,
+                             virtDBusGDBusPropertyTable *properties,
+                             virtDBusGDBusPropertyGetAllFunc getAll,
+                             gpointer userData,
+                             GError **error)
+{
+    virtDBusGDBusSubtreeData *data;
+    virtDBusGDBusRegisterData registerData = { 0 };
+
+    data = g_new0(virtDBusGDBusSubtreeData, 1);
+    g_mutex_init(&data->nodesLock);
+    data->methodData = virtDBusGDBusMethodDataNew(methods, properties, getAll,
+                                                  userData);
+    data->methodData->subtreeData = data;
+    data->interface = interface;
+    data->enumerate = enumerate;
+    data->lookup = lookup;
+
+    if (!virtDBusGDBusCheckTables(interface, data->methodData, error)) {
+        virtDBusGDBusSubtreeDataFree(data);
+        return FALSE;
+    }
+
+    virtDBusGDBusAddRegistration(objectPath, interface, data, data->methodData);
+
+    registerData.bus = bus;
+    registerData.objectPath = objectPath;
+    registerData.subtreeData = data;
+
+    virtDBusGDBusIngressInvoke(virtDBusGDBusRegisterSubtreeFunc, &registerData);
+
+    return TRUE;
+}
+
+static gboolean
+virtDBusGDBusCheckArgs(GDBusArgInfo **args,
+                       GVariant *parameters,
+                       GError **error)
+{
+    g_autoptr(GString) signature = g_string_new("(");
+
+    for (gint i = 0; args && args[i]; i++)
+        g_string_append(signature, args[i]->signature);
+    g_string_append_c(signature, ')');
+
+    if (!g_str_equal(signature->str, g_variant_get_type_string(parameters))) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "type of arguments '%s' does not match expected type '%s'",
+                    g_variant_get_type_string(parameters), signature->str);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * GDBus validates Properties calls against the introspection data before
+ * they reach virtDBusGDBusHandleMethodCall, calls unpacked from a Batch
+ * have to be validated the same way.
+ */
+static gboolean
+virtDBusGDBusCheckBatchProperty(GDBusInterfaceInfo *interface,
+                                const gchar *name,
+                                GVariant *newValue,
+                                GError **error)
+{
+    GDBusPropertyInfo *info = g_dbus_interface_info_lookup_property(interface, name);
+
+    if (!info) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "no property '%s' on interface '%s'",
+                    name, interface->name);
+        return FALSE;
+    }
+
+    if (!newValue) {
+        if (!(info->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE)) {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                        "property '%s' is not readable", name);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (!(info->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_PROPERTY_READ_ONLY,
+                    "property '%s' is not writable", name);
+        return FALSE;
+    }
+
+    if (!g_variant_is_of_type(newValue, G_VARIANT_TYPE(info->signature))) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "type of property '%s' is '%s' but '%s' was given",
+                    name, info->signature,
+                    g_variant_get_type_string(newValue));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+virtDBusGDBusCallBatchProperties(virtDBusGDBusBatchEntry *entry,
+                                 GError **error)
+{
+    virtDBusGDBusRegistration *registration;
+    const gchar *interfaceName;
+    const gchar *name;
+    GVariant *value = NULL;
+    g_autoptr(GVariant) newValue = NULL;
+    const gchar *type;
+
+    if (g_str_equal(entry->methodName, "Get")) {
+        type = "(ss)";
+    } else if (g_str_equal(entry->methodName, "Set")) {
+        type = "(ssv)";
+    } else if (g_str_equal(entry->methodName, "GetAll")) {
+        type = "(s)";
+    } else {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                    "unknown method '%s'", entry->methodName);
+        return FALSE;
+    }
+
+    if (!g_str_equal(type, g_variant_get_type_string(entry->args))) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "type of arguments '%s' does not match expected type '%s'",
+                    g_variant_get_type_string(entry->args), type);
+        return FALSE;
+    }
+
+    g_variant_get_child(entry->args, 0, "&s", &interfaceName);
+
+    registration = virtDBusGDBusLookupRegistration(entry->objectPath,
+                                                   interfaceName);
+    if (!registration) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE,
+                    "unknown interface '%s' on object '%s'",
+                    interfaceName, entry->objectPath);
+        return FALSE;
+    }
+
+    if (g_str_equal(entry->methodName, "GetAll")) {
+        entry->result = virtDBusGDBusGetAllProperties(registration->methodData,
+                                                      entry->objectPath);
+        return !!entry->result;
+    }
+
+    if (g_str_equal(entry->methodName, "Get")) {
+        g_variant_get(entry->args, "(&s&s)", NULL, &name);
+        if (!virtDBusGDBusCheckBatchProperty(registration->interface, name,
+                                             NULL, error) ||
+            !virtDBusGDBusGetProperty(registration->methodData,
+                                      entry->objectPath, name,
+                                      &value, error)) {
+            return FALSE;
+        }
+        entry->result = g_variant_new("(v)", value);
+        return TRUE;
+    }
+
+    g_variant_get(entry->args, "(&s&sv)", NULL, &name, &newValue);
+    if (!virtDBusGDBusCheckBatchProperty(registration->interface, name,
+                                         newValue, error) ||
+        !virtDBusGDBusSetProperty(registration->methodData, entry->objectPath,
+                                  name, newValue, error)) {
+        return FALSE;
+    }
+    entry->result = g_variant_new("()");
+    return TRUE;
+}
+
+static gboolean
+virtDBusGDBusCallBatchMethod(virtDBusGDBusBatchEntry *entry,
+                             GError **error)
+{
+    virtDBusGDBusRegistration *registration;
+    GDBusMethodInfo *info;
+    GVariant *outArgs = NULL;
+    g_autoptr(GUnixFDList) outFDs = NULL;
+
+    registration = virtDBusGDBusLookupRegistration(entry->objectPath,
+                                                   entry->interfaceName);
+    if (!registration) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE,
+                    "unknown interface '%s' on object '%s'",
+                    entry->interfaceName, entry->objectPath);
+        return FALSE;
+    }
+
+    info = g_dbus_interface_info_lookup_method(registration->interface,
+                                               entry->methodName);
+    if (!info) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                    "unknown method '%s'", entry->methodName);
+        return FALSE;
+    }
+
+    if (!virtDBusGDBusCheckArgs(info->in_args, entry->args, error))
+        return FALSE;
+
+    if (!virtDBusGDBusCallMethod(registration->methodData, entry->objectPath,
+                                 entry->methodName, entry->args, NULL,
+                                 &outArgs, &outFDs, error)) {
+        return FALSE;
+    }
+
+    if (outFDs) {
+        /* Closes the returned file descriptors as they cannot be passed
+         * inside of the batch reply. */
+        if (outArgs)
+            g_variant_unref(g_variant_ref_sink(outArgs));
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                    "method '%s' returns file descriptors which is not "
+                    "supported in a batch", entry->methodName);
+        return FALSE;
+    }
+
+    entry->result = outArgs ? outArgs : g_variant_new("()");
+
+    return TRUE;
+}
+
+static void
+virtDBusGDBusCallBatchThread(gpointer opaque,
+                             gpointer userData G_GNUC_UNUSED)
+{
+    virtDBusGDBusBatchEntry *entry = opaque;
+
+    if (g_str_equal(entry->interfaceName, "org.freedesktop.DBus.Properties"))
+        virtDBusGDBusCallBatchProperties(entry, &entry->error);
+    else
+        virtDBusGDBusCallBatchMethod(entry, &entry->error);
+
+    if (entry->result)
+        g_variant_ref_sink(entry->result);
+
+    if (entry->batch) {
+        g_mutex_lock(&entry->batch->lock);
+        if (--entry->batch->pending == 0)
+            g_cond_signal(&entry->batch->cond);
+        g_mutex_unlock(&entry->batch->lock);
+    }
+}
+
+static GVariant *
+virtDBusGDBusBatchArgs(GVariant *args)
+{
+    gsize nargs = g_variant_n_children(args);
+    g_autofree GVariant **children = g_new0(GVariant *, nargs + 1);
+    GVariant *ret;
+
+    for (gsize i = 0; i < nargs; i++) {
+        g_autoptr(GVariant) child = g_variant_get_child_value(args, i);
+        children[i] = g_variant_get_variant(child);
+    }
+
+    ret = g_variant_ref_sink(g_variant_new_tuple(children, nargs));
+
+    for (gsize i = 0; i < nargs; i++)
+        g_variant_unref(children[i]);
+
+    return ret;
+}
+
+static GVariant *
+virtDBusGDBusBatchResult(GVariant *result)
+{
+    g_auto(GVariantBuilder) builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("av"));
+
+    for (gsize i = 0; result && i < g_variant_n_children(result); i++) {
+        g_autoptr(GVariant) child = g_variant_get_child_value(result, i);
+        g_variant_builder_add(&builder, "v", child);
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/**
+ * virtDBusGDBusCallBatch:
+ * @calls: array of calls with type a(osssav) containing object path,
+ *   interface, method and arguments of each call
+ * @pathPrefix: only objects with this path or below it may be called
+ * @error: return location for error or NULL
+ *
+ * Dispatches all @calls to the registered method and property handlers
+ * without going through the bus.  Calls of all batches are processed by
+ * one thread pool of the size of the D-Bus thread pool.  Calls that take
+ * or return file descriptors and nested batches are not supported.
+ *
+ * Returns a new floating GVariant with type a(avss) containing for each
+ * call, in the same order, the output arguments and, in case of failure,
+ * the D-Bus error name and message, or NULL and sets @error if there are
+ * more than VIRT_DBUS_GDBUS_BATCH_MAX_CALLS calls.
+ */
+GVariant *
+virtDBusGDBusCallBatch(GVariant *calls,
+                       const gchar *pathPrefix,
+                       GError **error)
+{
+    gsize ncalls = g_variant_n_children(calls);
+    gsize prefixLen = strlen(pathPrefix);
+    g_autofree virtDBusGDBusBatchEntry *entries = NULL;
+    virtDBusGDBusBatch batch = { 0 };
+    g_auto(GVariantBuilder) builder;
+
+    if (ncalls > VIRT_DBUS_GDBUS_BATCH_MAX_CALLS) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                    "batch contains %" G_GSIZE_FORMAT " calls, at most %d "
+                    "are allowed", ncalls, VIRT_DBUS_GDBUS_BATCH_MAX_CALLS);
+        return NULL;
+    }
+
+    entries = g_new0(virtDBusGDBusBatchEntry, ncalls);
+
+    g_mutex_init(&batch.lock);
+    g_cond_init(&batch.cond);
+
+    for (gsize i = 0; i < ncalls; i++) {
+        virtDBusGDBusBatchEntry *entry = &entries[i];
+        g_autoptr(GVariant) args = NULL;
+
+        g_variant_get_child(calls, i, "(&o&s&s@av)",
+                            &entry->objectPath, &entry->interfaceName,
+                            &entry->methodName, &args);
+        entry->args = virtDBusGDBusBatchArgs(args);
+
+        if (strncmp(entry->objectPath, pathPrefix, prefixLen) != 0 ||
+            (entry->objectPath[prefixLen] != '/' &&
+             entry->objectPath[prefixLen] != '\0')) {
+            g_set_error(&entry->error, G_DBUS_ERROR,
+                        G_DBUS_ERROR_UNKNOWN_OBJECT,
+                        "object '%s' is not under '%s'",
+                        entry->objectPath, pathPrefix);
+            continue;
+        }
+
+        /* A nested batch would wait for the batch pool from one of its
+         * own threads. */
+        if (g_str_equal(entry->methodName, "Batch")) {
+            g_set_error(&entry->error, G_DBUS_ERROR,
+                        G_DBUS_ERROR_NOT_SUPPORTED,
+                        "method '%s' is not supported in a batch",
+                        entry->methodName);
+            continue;
+        }
+
+        if (batchPool) {
+            g_mutex_lock(&batch.lock);
+            batch.pending++;
+            g_mutex_unlock(&batch.lock);
+
+            entry->batch = &batch;
+            g_thread_pool_push(batchPool, entry, NULL);
+        } else {
+            virtDBusGDBusCallBatchThread(entry, NULL);
+        }
+    }
+
+    g_mutex_lock(&batch.lock);
+    while (batch.pending > 0)
+        g_cond_wait(&batch.cond, &batch.lock);
+    g_mutex_unlock(&batch.lock);
+
+    g_mutex_clear(&batch.lock);
+    g_cond_clear(&batch.cond);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(avss)"));
+
+    for (gsize i = 0; i < ncalls; i++) {
+        virtDBusGDBusBatchEntry *entry = &entries[i];
+        g_autofree gchar *errorName = NULL;
+        g_autoptr(GVariant) result = entry->result;
+
+        if (!entry->error && !result) {
+            g_set_error(&entry->error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                        "method '%s' did not return any value",
+                        entry->methodName);
+        }
+
+        if (entry->error) {
+            errorName = g_dbus_error_encode_gerror(entry->error);
+            g_variant_builder_add(&builder, "(@avss)",
+                                  virtDBusGDBusBatchResult(NULL),
+                                  errorName, entry->error->message);
+            g_clear_error(&entry->error);
+        } else {
+            g_variant_builder_add(&builder, "(@avss)",
+                                  virtDBusGDBusBatchResult(result), "", "");
+        }
+
+        g_variant_unref(entry->args);
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/**
+ * virtDBusGDBusInvalidateSubtree:
+ * @objectPath: object prefix path of a registered subtree
+ *
+ * Marks the cached list of objects of the subtree as outdated and
+ * schedules its refresh.  Has to be called whenever an object is added
+ * to or removed from the subtree.
+ *
+ * Subtrees are not refreshed in the background until they are invalidated
+ * for the first time, which is expected to happen once the objects can be
+ * listed without side effects, for example after opening the libvirt
+ * connection.
+ */
+void
+virtDBusGDBusInvalidateSubtree(const gchar *objectPath)
+{
+    virtDBusGDBusSubtreeData *data = NULL;
+
+    g_mutex_lock(&registrationsLock);
+    for (guint i = 0; registrations && i < registrations->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(registrations, i);
+
+        if (registration->subtreeData &&
+            g_str_equal(registration->objectPath, objectPath)) {
+            data = registration->subtreeData;
+            break;
+        }
+    }
+    g_mutex_unlock(&registrationsLock);
+
+    if (!data)
+        return;
+
+    g_mutex_lock(&data->nodesLock);
+    data->nodesGeneration++;
+    data->nodesValid = FALSE;
+    data->nodesEnabled = TRUE;
+    virtDBusGDBusScheduleRefreshNodes(data);
+    g_mutex_unlock(&data->nodesLock);
+}
+
+/**
+ * virtDBusGDBusGetSender:
+ *
+ * Returns unique bus name of the client whose method call is handled by
+ * the calling thread or NULL if it is not known, for example for calls
+ * of Connect.Batch processed by other threads.  The name is valid only
+ * until the method handler returns.
+ */
+const gchar *
+virtDBusGDBusGetSender(void)
+{
+    return g_private_get(&currentSender);
+}
+
+/**
+ * virtDBusGDBusFlushCache:
+ * @objectPath: object path
+ *
+ * Drops cached results of methods and properties of all objects
+ * registered at @objectPath or below, typically because the underlying
+ * connection was reopened and may talk to a different host.
+ */
+void
+virtDBusGDBusFlushCache(const gchar *objectPath)
+{
+    gsize len = strlen(objectPath);
+
+    g_mutex_lock(&registrationsLock);
+    for (guint i = 0; registrations && i < registrations->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(registrations, i);
+        virtDBusGDBusMethodData *data = registration->methodData;
+
+        if (!data->cache ||
+            strncmp(registration->objectPath, objectPath, len) != 0 ||
+            (registration->objectPath[len] && registration->objectPath[len] != '/')) {
+            continue;
+        }
+
+        g_mutex_lock(&data->cacheLock);
+        g_queue_init(&data->cacheOrder);
+        g_hash_table_remove_all(data->cache);
+        g_mutex_unlock(&data->cacheLock);
+    }
+    g_mutex_unlock(&registrationsLock);
+}
+
+#define VIRT_DBUS_GDBUS_OBJECT_MANAGER_INTERFACE "org.freedesktop.DBus.ObjectManager"
+
+static const gchar virtDBusGDBusObjectManagerXML[] =
+    "<node>"
+    "  <interface name='" VIRT_DBUS_GDBUS_OBJECT_MANAGER_INTERFACE "'>"
+    "    <method name='GetManagedObjects'>"
+    "      <arg name='objects' type='a{oa{sa{sv}}}' direction='out'/>"
+    "    </method>"
+    "    <signal name='InterfacesAdded'>"
+    "      <arg name='object' type='o'/>"
+    "      <arg name='interfaces' type='a{sa{sv}}'/>"
+    "    </signal>"
+    "    <signal name='InterfacesRemoved'>"
+    "      <arg name='object' type='o'/>"
+    "      <arg name='interfaces' type='as'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+static gboolean
+virtDBusGDBusIsObjectManager(virtDBusGDBusRegistration *registration)
+{
+    return g_str_equal(registration->interface->name,
+                       VIRT_DBUS_GDBUS_OBJECT_MANAGER_INTERFACE);
+}
+
+static gboolean
+virtDBusGDBusIsDescendant(const gchar *objectPath,
+                          const gchar *prefix)
+{
+    gsize len = strlen(prefix);
+
+    return strncmp(objectPath, prefix, len) == 0 &&
+           objectPath[len] == '/' && objectPath[len + 1];
+}
+
+/* Subtree enumerations may return either full object paths or node names
+ * relative to the subtree prefix. */
+static gchar *
+virtDBusGDBusNodePath(const gchar *prefix,
+                      const gchar *node)
+{
+    if (node[0] == '/')
+        return g_strdup(node);
+
+    return g_strdup_printf("%s/%s", prefix, node);
+}
+
+static GVariant *
+virtDBusGDBusInterfaceEntry(virtDBusGDBusRegistration *registration,
+                            const gchar *objectPath)
+{
+    GVariant *dict = virtDBusGDBusGetPropertiesDict(registration->methodData,
+                                                    objectPath);
+
+    return g_variant_new_dict_entry(g_variant_new_string(registration->interface->name),
+                                    dict);
+}
+
+struct _virtDBusGDBusManagedObject {
+    gchar *objectPath;
+    virtDBusGDBusRegistration *registration;
+};
+typedef struct _virtDBusGDBusManagedObject virtDBusGDBusManagedObject;
+
+static void
+virtDBusGDBusManagedObjectFree(virtDBusGDBusManagedObject *object)
+{
+    g_free(object->objectPath);
+    g_free(object);
+}
+
+static virtDBusGDBusManagedObject *
+virtDBusGDBusManagedObjectCopy(virtDBusGDBusManagedObject *object)
+{
+    virtDBusGDBusManagedObject *ret = g_new0(virtDBusGDBusManagedObject, 1);
+
+    ret->objectPath = g_strdup(object->objectPath);
+    ret->registration = object->registration;
+
+    return ret;
+}
+
+static void
+virtDBusGDBusManagedObjectListFree(virtDBusGDBusManagedObject **objects)
+{
+    for (gint i = 0; objects[i]; i++)
+        virtDBusGDBusManagedObjectFree(objects[i]);
+    g_free(objects);
+}
+
+static gpointer
+virtDBusGDBusManagedObjectEntry(gpointer item,
+                                gpointer userData G_GNUC_UNUSED)
+{
+    virtDBusGDBusManagedObject *object = item;
+
+    return g_variant_ref_sink(virtDBusGDBusInterfaceEntry(object->registration,
+                                                          object->objectPath));
+}
+
+static gchar *
+virtDBusGDBusManagedObjectKey(gpointer item,
+                              gpointer userData G_GNUC_UNUSED)
+{
+    virtDBusGDBusManagedObject *object = item;
+
+    return g_strdup(object->objectPath);
+}
+
+static void
+virtDBusGDBusAddManagedObject(GPtrArray *objects,
+                              gchar *objectPath,
+                              virtDBusGDBusRegistration *registration)
+{
+    virtDBusGDBusManagedObject *object = g_new0(virtDBusGDBusManagedObject, 1);
+
+    object->objectPath = objectPath;
+    object->registration = registration;
+
+    g_ptr_array_add(objects, object);
+}
+
+static void
+virtDBusGDBusGetManagedObjects(GVariant *inArgs G_GNUC_UNUSED,
+                               GUnixFDList *inFDs G_GNUC_UNUSED,
+                               const gchar *objectPath,
+                               gpointer userData G_GNUC_UNUSED,
+                               GVariant **outArgs,
+                               GUnixFDList **outFDs G_GNUC_UNUSED,
+                               GError **error G_GNUC_UNUSED)
+{
+    g_autoptr(GPtrArray) list = virtDBusGDBusListRegistrations();
+    g_autoptr(GPtrArray) managed = NULL;
+    g_autoptr(GHashTable) objects = NULL;
+    virtDBusGDBusManagedObject **items;
+    g_autofree gpointer *results = NULL;
+    gboolean partial;
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    managed = g_ptr_array_new_with_free_func((GDestroyNotify)virtDBusGDBusManagedObjectFree);
+
+    for (guint i = 0; i < list->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(list, i);
+        g_auto(GStrv) nodes = NULL;
+
+        if (virtDBusGDBusIsObjectManager(registration) ||
+            !virtDBusGDBusIsDescendant(registration->objectPath, objectPath)) {
+            continue;
+        }
+
+        if (!registration->subtreeData) {
+            virtDBusGDBusAddManagedObject(managed,
+                                          g_strdup(registration->objectPath),
+                                          registration);
+            continue;
+        }
+
+        nodes = virtDBusGDBusSubtreeNodes(registration->subtreeData);
+        for (gint j = 0; nodes && nodes[j]; j++) {
+            virtDBusGDBusAddManagedObject(managed,
+                                          virtDBusGDBusNodePath(registration->objectPath,
+                                                                nodes[j]),
+                                          registration);
+        }
+    }
+
+    /* The fan-out may free its copy of the objects only after we gave up
+     * waiting for them. */
+    items = g_new0(virtDBusGDBusManagedObject *, managed->len + 1);
+    for (guint i = 0; i < managed->len; i++)
+        items[i] = virtDBusGDBusManagedObjectCopy(g_ptr_array_index(managed, i));
+
+    /* The properties of every object take libvirt calls, a few
+     * unresponsive objects must not hold up the whole reply.  Objects
+     * which time out are reported without their properties. */
+    results = virtDBusUtilFanOut((gpointer *)items,
+                                 managed->len,
+                                 (GDestroyNotify)virtDBusGDBusManagedObjectListFree,
+                                 virtDBusGDBusManagedObjectEntry,
+                                 virtDBusGDBusManagedObjectKey,
+                                 (GDestroyNotify)g_variant_unref,
+                                 NULL,
+                                 VIRT_DBUS_UTIL_FAN_OUT_TIMEOUT,
+                                 &partial);
+
+    objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                    (GDestroyNotify)g_ptr_array_unref);
+
+    for (guint i = 0; i < managed->len; i++) {
+        virtDBusGDBusManagedObject *object = g_ptr_array_index(managed, i);
+        GPtrArray *entries = g_hash_table_lookup(objects, object->objectPath);
+        GVariant *entry = results[i];
+
+        if (!entry) {
+            const gchar *name = object->registration->interface->name;
+
+            entry = g_variant_new_dict_entry(g_variant_new_string(name),
+                                             g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                                                 NULL, 0));
+            g_variant_ref_sink(entry);
+        }
+
+        if (!entries) {
+            entries = g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
+            g_hash_table_insert(objects, g_strdup(object->objectPath), entries);
+        }
+
+        g_ptr_array_add(entries, entry);
+    }
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{oa{sa{sv}}}"));
+
+    g_hash_table_iter_init(&iter, objects);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GPtrArray *entries = value;
+
+        g_variant_builder_add(&builder, "{o@a{sa{sv}}}", key,
+                              g_variant_new_array(G_VARIANT_TYPE("{sa{sv}}"),
+                                                  (GVariant **)entries->pdata,
+                                                  entries->len));
+    }
+
+    *outArgs = g_variant_new("(a{oa{sa{sv}}})", &builder);
+}
+
+static virtDBusGDBusPropertyTable virtDBusGDBusObjectManagerPropertyTable[] = {
+    { 0 }
+};
+
+static virtDBusGDBusMethodTable virtDBusGDBusObjectManagerMethodTable[] = {
+    { "GetManagedObjects", virtDBusGDBusGetManagedObjects, 0 },
+    { 0 }
+};
+
+static GDBusInterfaceInfo *objectManagerInfo = NULL;
+
+/**
+ * virtDBusGDBusRegisterObjectManager:
+ * @bus: GDBus connection
+ * @objectPath: object path
+ * @error: return location for error
+ *
+ * Registers org.freedesktop.DBus.ObjectManager on @objectPath.  It reports
+ * every object and subtree registered under @objectPath, changes have to
+ * be announced with virtDBusGDBusEmitInterfacesAdded() and
+ * virtDBusGDBusEmitInterfacesRemoved().
+ *
+ * Returns TRUE on success, FALSE on failure and sets @error.
+ */
+gboolean
+virtDBusGDBusRegisterObjectManager(GDBusConnection *bus,
+                                   const gchar *objectPath,
+                                   GError **error)
+{
+    if (!objectManagerInfo) {
+        g_autoptr(GDBusNodeInfo) nodeInfo = NULL;
+
+        nodeInfo = g_dbus_node_info_new_for_xml(virtDBusGDBusObjectManagerXML,
+                                                error);
+        if (!nodeInfo)
+            return FALSE;
+
+        objectManagerInfo = g_dbus_interface_info_ref(nodeInfo->interfaces[0]);
+    }
+
+    return virtDBusGDBusRegisterObject(bus, objectPath, objectManagerInfo,
+                                       virtDBusGDBusObjectManagerMethodTable,
+                                       virtDBusGDBusObjectManagerPropertyTable,
+                                       NULL, error);
+}
+
+static const gchar *
+virtDBusGDBusFindObjectManager(GPtrArray *list,
+                               const gchar *objectPath)
+{
+    for (guint i = 0; i < list->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(list, i);
+
+        if (virtDBusGDBusIsObjectManager(registration) &&
+            virtDBusGDBusIsDescendant(objectPath, registration->objectPath)) {
+            return registration->objectPath;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * virtDBusGDBusEmitInterfacesAdded:
+ * @bus: GDBus connection
+ * @objectPath: path of the new object
+ *
+ * Emits InterfacesAdded with the current properties of all interfaces of
+ * @objectPath from the object manager the object belongs to.
+ */
+void
+virtDBusGDBusEmitInterfacesAdded(GDBusConnection *bus,
+                                 const gchar *objectPath)
+{
+    g_autoptr(GPtrArray) list = virtDBusGDBusListRegistrations();
+    g_autoptr(GPtrArray) entries = g_ptr_array_new();
+    const gchar *managerPath;
+
+    managerPath = virtDBusGDBusFindObjectManager(list, objectPath);
+    if (!managerPath)
+        return;
+
+    for (guint i = 0; i < list->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(list, i);
+
+        if (virtDBusGDBusRegistrationMatches(registration, objectPath))
+            g_ptr_array_add(entries, virtDBusGDBusInterfaceEntry(registration,
+                                                                 objectPath));
+    }
+
+    if (entries->len == 0)
+        return;
+
+    g_dbus_connection_emit_signal(bus,
+                                  NULL,
+                                  managerPath,
+                                  VIRT_DBUS_GDBUS_OBJECT_MANAGER_INTERFACE,
+                                  "InterfacesAdded",
+                                  g_variant_new("(o@a{sa{sv}})", objectPath,
+                                                g_variant_new_array(G_VARIANT_TYPE("{sa{sv}}"),
+                                                                    (GVariant **)entries->pdata,
+                                                                    entries->len)),
+                                  NULL);
+}
+
+/**
+ * virtDBusGDBusEmitInterfacesRemoved:
+ * @bus: GDBus connection
+ * @objectPath: path of the removed object
+ *
+ * Emits InterfacesRemoved for all interfaces of @objectPath from the
+ * object manager the object belongs to.
+ */
+void
+virtDBusGDBusEmitInterfacesRemoved(GDBusConnection *bus,
+                                   const gchar *objectPath)
+{
+    g_autoptr(GPtrArray) list = virtDBusGDBusListRegistrations();
+    g_autoptr(GPtrArray) names = g_ptr_array_new();
+    const gchar *managerPath;
+
+    managerPath = virtDBusGDBusFindObjectManager(list, objectPath);
+    if (!managerPath)
+        return;
+
+    for (guint i = 0; i < list->len; i++) {
+        virtDBusGDBusRegistration *registration = g_ptr_array_index(list, i);
+
+        if (virtDBusGDBusRegistrationMatches(registration, objectPath))
+            g_ptr_array_add(names, registration->interface->name);
+    }
+
+    if (names->len == 0)
+        return;
+
+    g_ptr_array_add(names, NULL);
+
+    g_dbus_connection_emit_signal(bus,
+                                  NULL,
+                                  managerPath,
+                                  VIRT_DBUS_GDBUS_OBJECT_MANAGER_INTERFACE,
+                                  "InterfacesRemoved",
+                                  g_variant_new("(o^as)", objectPath,
+                                                names->pdata),
+                                  NULL);
+}
+
+/**
+ * virtDBusGDBusEmitPropertiesChanged:
+ * @bus: GDBus connection
+ * @objectPath: object path
+ * @interfaceName: interface of the properties
+ * @properties: NULL terminated list of names of properties that may have
+ *   changed
+ *
+ * Reads the current values of @properties, bypassing the property cache,
+ * and emits PropertiesChanged with all of them whether their values changed
+ * or not.  Properties which cannot be read are reported as invalidated.
+ * Nothing is emitted if no property can be read, typically because the
+ * object does not exist anymore.
+ */
+void
+virtDBusGDBusEmitPropertiesChanged(GDBusConnection *bus,
+                                   const gchar *objectPath,
+                                   const gchar *interfaceName,
+                                   const gchar *const *properties)
+{
+    virtDBusGDBusRegistration *registration;
+    GVariantBuilder changed;
+    GVariantBuilder invalidated;
+    guint nchanged = 0;
+
+    registration = virtDBusGDBusLookupRegistration(objectPath, interfaceName);
+    if (!registration)
+        return;
+
+    g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_init(&invalidated, G_VARIANT_TYPE("as"));
+
+    for (gint i = 0; properties[i]; i++) {
+        g_autoptr(GError) error = NULL;
+        GVariant *value = NULL;
+
+        if (virtDBusGDBusRefreshProperty(registration->methodData, objectPath,
+                                         properties[i], &value, &error)) {
+            g_variant_builder_add(&changed, "{sv}", properties[i], value);
+            nchanged++;
+        } else {
+            g_variant_builder_add(&invalidated, "s", properties[i]);
+        }
+    }
+
+    if (nchanged == 0) {
+        g_variant_builder_clear(&changed);
+        g_variant_builder_clear(&invalidated);
+        return;
+    }
+
+    g_dbus_connection_emit_signal(bus,
+                                  NULL,
+                                  objectPath,
+                                  "org.freedesktop.DBus.Properties",
+                                  "PropertiesChanged",
+                                  g_variant_new("(sa{sv}as)", interfaceName,
+                                                &changed, &invalidated),
+                                  NULL);
 }
 
 /**
@@ -446,6 +2197,65 @@ virtDBusGDBusPrepareThreadPool(gint maxThreads,
                                    maxThreads,
                                    FALSE,
                                    error);
+    if (!threadPool)
+        return FALSE;
+
+    batchPool = g_thread_pool_new(virtDBusGDBusCallBatchThread,
+                                  NULL,
+                                  maxThreads,
+                                  FALSE,
+                                  error);
+    if (!batchPool)
+        return FALSE;
+
+    enumeratePool = g_thread_pool_new(virtDBusGDBusEnumerateThread,
+                                      NULL, 1, FALSE, error);
+
+    return !!enumeratePool;
+}
+
+static gpointer
+virtDBusGDBusIngressThread(gpointer opaque)
+{
+    g_autoptr(GMainLoop) loop = opaque;
+
+    g_main_context_push_thread_default(ingressContext);
+    g_main_loop_run(loop);
+    g_main_context_pop_thread_default(ingressContext);
+
+    return NULL;
+}
+
+/**
+ * virtDBusGDBusPrepareIngressContext:
+ * @error: return location for error or NULL
+ *
+ * Starts a dedicated thread with its own main context.  Objects and
+ * subtrees registered afterwards receive their method calls in that
+ * thread which only queues them for the thread pool, independently of
+ * the load of the main loop.
+ *
+ * Returns TRUE on success, FALSE on error and sets @error.
+ */
+gboolean
+virtDBusGDBusPrepareIngressContext(GError **error)
+{
+    GMainContext *context = g_main_context_new();
+    GMainLoop *loop = g_main_loop_new(context, FALSE);
+    GThread *thread;
+
+    ingressContext = context;
+
+    thread = g_thread_try_new("dbus-ingress", virtDBusGDBusIngressThread,
+                              loop, error);
+    if (!thread) {
+        ingressContext = NULL;
+        g_main_loop_unref(loop);
+        g_main_context_unref(context);
+        return FALSE;
+    }
+
+    g_thread_unref(thread);
 
-    return !!threadPool;
+    return TRUE;
 }
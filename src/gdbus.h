@@ -56,6 +56,24 @@ typedef void
                                 gpointer userData,
                                 GError **error);
 
+/**
+ * virtDBusGDBusPropertyGetAllFunc:
+ * @objectPath: the object path the method was called on
+ * @userData: user data passed when registering new object or subtree
+ * @values: return location for a{sv} dictionary of property values
+ * @error: return location for error
+ *
+ * Handles D-Bus GetAll action by reading several properties at once,
+ * typically resolving the object only once and sharing libvirt calls
+ * between properties.  Properties missing in @values are read by their
+ * own getters.  In case of error the handler has to set an @error.
+ */
+typedef void
+(*virtDBusGDBusPropertyGetAllFunc)(const gchar *objectPath,
+                                   gpointer userData,
+                                   GVariant **values,
+                                   GError **error);
+
 /**
  * virtDBusGDBusEnumerateFunc:
  * @userData: user data passed when registering new subtree
@@ -67,16 +85,63 @@ typedef void
 typedef gchar **
 (*virtDBusGDBusEnumerateFunc)(gpointer userData);
 
+/**
+ * virtDBusGDBusLookupFunc:
+ * @objectPath: D-Bus object path
+ * @userData: user data passed when registering new subtree
+ * @error: return location for error
+ *
+ * Checks that an object of the subtree exists without enumerating the
+ * whole subtree, typically by looking it up in libvirt.
+ *
+ * Returns TRUE if the object exists, FALSE otherwise and sets @error.
+ */
+typedef gboolean
+(*virtDBusGDBusLookupFunc)(const gchar *objectPath,
+                           gpointer userData,
+                           GError **error);
+
+/**
+ * virtDBusGDBusMethodTable:
+ * @name: name of the method
+ * @methodFunc: handler of the method
+ * @cacheTTL: time in microseconds for which results are reused for calls
+ *   with equal arguments on the same object, 0 disables caching.  Only
+ *   for methods without side effects whose result rarely changes.
+ */
 struct _virtDBusGDBusMethodTable {
     const gchar *name;
     virtDBusGDBusMethodFunc methodFunc;
+    gint64 cacheTTL;
 };
 typedef struct _virtDBusGDBusMethodTable virtDBusGDBusMethodTable;
 
+/**
+ * virtDBusGDBusPropertyFlags:
+ * @VIRT_DBUS_GDBUS_PROPERTY_INLINE: the getter never talks to libvirt,
+ *   typically because the value is derived from the object path, and is
+ *   called directly from the thread receiving the method call for objects
+ *   which are known to exist
+ */
+typedef enum {
+    VIRT_DBUS_GDBUS_PROPERTY_INLINE = (1 << 0),
+} virtDBusGDBusPropertyFlags;
+
+/**
+ * virtDBusGDBusPropertyTable:
+ * @name: name of the property
+ * @getFunc: getter of the property
+ * @setFunc: setter of the property
+ * @flags: bitwise-OR of #virtDBusGDBusPropertyFlags
+ * @cacheTTL: time in microseconds for which the value returned by
+ *   @getFunc is reused, 0 disables caching
+ */
 struct _virtDBusGDBusPropertyTable {
     const gchar *name;
     virtDBusGDBusPropertyGetFunc getFunc;
     virtDBusGDBusPropertySetFunc setFunc;
+    guint flags;
+    gint64 cacheTTL;
 };
 typedef struct _virtDBusGDBusPropertyTable virtDBusGDBusPropertyTable;
 
@@ -87,22 +152,62 @@ GDBusInterfaceInfo *
 virtDBusGDBusLoadIntrospectData(gchar const *interface,
                                 GError **error);
 
-void
+gboolean
 virtDBusGDBusRegisterObject(GDBusConnection *bus,
                             gchar const *objectPath,
                             GDBusInterfaceInfo *interface,
                             virtDBusGDBusMethodTable *methods,
                             virtDBusGDBusPropertyTable *properties,
-                            gpointer userData);
+                            gpointer userData,
+                            GError **error);
 
-void
+gboolean
 virtDBusGDBusRegisterSubtree(GDBusConnection *bus,
                              gchar const *objectPath,
                              GDBusInterfaceInfo *interface,
                              virtDBusGDBusEnumerateFunc enumerate,
+                             virtDBusGDBusLookupFunc lookup,
                              virtDBusGDBusMethodTable *methods,
                              virtDBusGDBusPropertyTable *properties,
-                             gpointer userData);
+                             virtDBusGDBusPropertyGetAllFunc getAll,
+                             gpointer userData,
+                             GError **error);
+
+void
+virtDBusGDBusInvalidateSubtree(const gchar *objectPath);
+
+void
+virtDBusGDBusFlushCache(const gchar *objectPath);
+
+const gchar *
+virtDBusGDBusGetSender(void);
+
+gboolean
+virtDBusGDBusRegisterObjectManager(GDBusConnection *bus,
+                                   const gchar *objectPath,
+                                   GError **error);
+
+void
+virtDBusGDBusEmitInterfacesAdded(GDBusConnection *bus,
+                                 const gchar *objectPath);
+
+void
+virtDBusGDBusEmitInterfacesRemoved(GDBusConnection *bus,
+                                   const gchar *objectPath);
+
+void
+virtDBusGDBusEmitPropertiesChanged(GDBusConnection *bus,
+                                   const gchar *objectPath,
+                                   const gchar *interfaceName,
+                                   const gchar *const *properties);
+
+GVariant *
+virtDBusGDBusCallBatch(GVariant *calls,
+                       const gchar *pathPrefix,
+                       GError **error);
+
+gboolean
+virtDBusGDBusPrepareIngressContext(GError **error);
 
 gboolean
 virtDBusGDBusPrepareThreadPool(gint maxThreads,
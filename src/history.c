@@ -0,0 +1,421 @@
+#include "history.h"
+
+#include <math.h>
+
+struct _virtDBusHistoryTier {
+    guint resolution;
+    guint capacity;
+};
+typedef struct _virtDBusHistoryTier virtDBusHistoryTier;
+
+/* Resolutions in seconds and number of slots of the ring buffers kept for
+ * every field, from the finest to the coarsest.  Coarser tiers average
+ * all samples falling into their slot. */
+static const virtDBusHistoryTier virtDBusHistoryTiers[] = {
+    { 1, 600 },
+    { 60, 1440 },
+};
+
+#define VIRT_DBUS_HISTORY_NTIERS G_N_ELEMENTS(virtDBusHistoryTiers)
+
+/* Series not updated for a whole slot of the coarsest tier belong to
+ * objects or devices which are gone and may be evicted for new ones. */
+#define VIRT_DBUS_HISTORY_EVICT_AGE \
+    (virtDBusHistoryTiers[VIRT_DBUS_HISTORY_NTIERS - 1].resolution)
+
+struct _virtDBusHistorySeries {
+    /* Link in the list of series ordered by their last update, the key of
+     * the object in the objects table and the fields table of the object
+     * so that eviction does not have to search for the series. */
+    GList lru;
+    const gchar *object;
+    GHashTable *fields;
+    gchar *field;
+    gint64 updated;
+    gint64 slot[VIRT_DBUS_HISTORY_NTIERS];
+    gdouble sum[VIRT_DBUS_HISTORY_NTIERS];
+    guint count[VIRT_DBUS_HISTORY_NTIERS];
+    gdouble *values[VIRT_DBUS_HISTORY_NTIERS];
+};
+typedef struct _virtDBusHistorySeries virtDBusHistorySeries;
+
+struct _virtDBusHistory {
+    GMutex lock;
+    GHashTable *objects;
+    GQueue lru;
+    gchar **fields;
+    guint nseries;
+    guint maxSeries;
+};
+
+static gsize historyMaxMemory = 0;
+static gchar **historyFields = NULL;
+
+/**
+ * virtDBusHistorySetDefaults:
+ * @maxMemory: memory limit of the history of every connection in bytes,
+ *   0 disables the history
+ * @fields: comma separated patterns of recorded stats fields, see
+ *   virtDBusUtilFieldMatches()
+ *
+ * Configures histories created by virtDBusHistoryNewDefault().
+ */
+void
+virtDBusHistorySetDefaults(gsize maxMemory,
+                           const gchar *fields)
+{
+    historyMaxMemory = maxMemory;
+    g_strfreev(historyFields);
+    historyFields = g_strsplit(fields, ",", -1);
+}
+
+static gsize
+virtDBusHistorySeriesSize(void)
+{
+    gsize size = sizeof(virtDBusHistorySeries);
+
+    for (gsize i = 0; i < VIRT_DBUS_HISTORY_NTIERS; i++)
+        size += virtDBusHistoryTiers[i].capacity * sizeof(gdouble);
+
+    return size;
+}
+
+static void
+virtDBusHistorySeriesFree(gpointer opaque)
+{
+    virtDBusHistorySeries *series = opaque;
+
+    for (gsize i = 0; i < VIRT_DBUS_HISTORY_NTIERS; i++)
+        g_free(series->values[i]);
+    g_free(series->field);
+    g_free(series);
+}
+
+static virtDBusHistorySeries *
+virtDBusHistorySeriesNew(void)
+{
+    virtDBusHistorySeries *series = g_new0(virtDBusHistorySeries, 1);
+
+    series->lru.data = series;
+
+    for (gsize i = 0; i < VIRT_DBUS_HISTORY_NTIERS; i++) {
+        series->slot[i] = -1;
+        series->values[i] = g_new(gdouble, virtDBusHistoryTiers[i].capacity);
+        for (guint j = 0; j < virtDBusHistoryTiers[i].capacity; j++)
+            series->values[i][j] = NAN;
+    }
+
+    return series;
+}
+
+/**
+ * virtDBusHistoryNew:
+ * @maxMemory: upper bound of the memory used by the recorded values in
+ *   bytes
+ * @fields: NULL-terminated list of patterns of recorded fields
+ *
+ * Creates a history of stats values of many objects, each recorded field
+ * is kept in a ring buffer of a fixed size for every tier.  When the
+ * memory limit is reached the field updated longest ago is dropped if it
+ * was not updated for VIRT_DBUS_HISTORY_EVICT_AGE seconds, otherwise new
+ * fields are not recorded.
+ */
+virtDBusHistory *
+virtDBusHistoryNew(gsize maxMemory,
+                   const gchar *const *fields)
+{
+    virtDBusHistory *history = g_new0(virtDBusHistory, 1);
+
+    g_mutex_init(&history->lock);
+    history->objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)g_hash_table_unref);
+    g_queue_init(&history->lru);
+    history->fields = g_strdupv((gchar **)fields);
+    history->maxSeries = MIN(maxMemory / virtDBusHistorySeriesSize(),
+                             G_MAXUINT);
+
+    return history;
+}
+
+/**
+ * virtDBusHistoryNewDefault:
+ *
+ * Returns new history configured by virtDBusHistorySetDefaults() or NULL
+ * if the history is disabled.
+ */
+virtDBusHistory *
+virtDBusHistoryNewDefault(void)
+{
+    if (historyMaxMemory == 0 || !historyFields || !historyFields[0])
+        return NULL;
+
+    return virtDBusHistoryNew(historyMaxMemory,
+                              (const gchar *const *)historyFields);
+}
+
+void
+virtDBusHistoryFree(virtDBusHistory *history)
+{
+    g_hash_table_unref(history->objects);
+    g_strfreev(history->fields);
+    g_mutex_clear(&history->lock);
+    g_free(history);
+}
+
+void
+virtDBusHistoryClear(virtDBusHistory *history)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&history->lock);
+
+    g_hash_table_remove_all(history->objects);
+    g_queue_init(&history->lru);
+    history->nseries = 0;
+}
+
+const gchar *const *
+virtDBusHistoryGetFields(virtDBusHistory *history)
+{
+    return (const gchar *const *)history->fields;
+}
+
+/* Has to be called with the history lock held. */
+static gboolean
+virtDBusHistoryEvict(virtDBusHistory *history,
+                     gint64 timestamp)
+{
+    virtDBusHistorySeries *oldest = g_queue_peek_head(&history->lru);
+    GHashTable *fields;
+
+    if (!oldest || timestamp - oldest->updated < VIRT_DBUS_HISTORY_EVICT_AGE)
+        return FALSE;
+
+    g_queue_unlink(&history->lru, &oldest->lru);
+    fields = oldest->fields;
+    g_hash_table_remove(fields, oldest->field);
+    history->nseries--;
+
+    if (g_hash_table_size(fields) == 0)
+        g_hash_table_remove(history->objects, oldest->object);
+
+    return TRUE;
+}
+
+/**
+ * virtDBusHistoryAdd:
+ * @history: history
+ * @object: name of the object, typically its object path
+ * @field: name of the field
+ * @timestamp: UNIX time of the sample in seconds
+ * @value: value of the field
+ *
+ * Records @value in every tier.  Slots skipped since the previous sample
+ * are marked as missing, samples older than the previous one are ignored.
+ */
+void
+virtDBusHistoryAdd(virtDBusHistory *history,
+                   const gchar *object,
+                   const gchar *field,
+                   gint64 timestamp,
+                   gdouble value)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&history->lock);
+    GHashTable *fields;
+    virtDBusHistorySeries *series = NULL;
+
+    fields = g_hash_table_lookup(history->objects, object);
+    if (fields)
+        series = g_hash_table_lookup(fields, field);
+
+    if (!series) {
+        gchar *objectKey = NULL;
+
+        if (history->nseries >= history->maxSeries &&
+            !virtDBusHistoryEvict(history, timestamp)) {
+            return;
+        }
+
+        /* Eviction may have removed the last field of the object. */
+        if (!g_hash_table_lookup_extended(history->objects, object,
+                                          (gpointer *)&objectKey,
+                                          (gpointer *)&fields)) {
+            objectKey = g_strdup(object);
+            fields = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                           virtDBusHistorySeriesFree);
+            g_hash_table_insert(history->objects, objectKey, fields);
+        }
+
+        series = virtDBusHistorySeriesNew();
+        series->object = objectKey;
+        series->fields = fields;
+        series->field = g_strdup(field);
+        g_hash_table_insert(fields, series->field, series);
+        history->nseries++;
+    } else {
+        g_queue_unlink(&history->lru, &series->lru);
+    }
+
+    g_queue_push_tail_link(&history->lru, &series->lru);
+
+    for (gsize i = 0; i < VIRT_DBUS_HISTORY_NTIERS; i++) {
+        const virtDBusHistoryTier *tier = virtDBusHistoryTiers + i;
+        gint64 slot = timestamp / tier->resolution;
+
+        if (slot < series->slot[i])
+            continue;
+
+        if (slot != series->slot[i]) {
+            if (series->slot[i] >= 0) {
+                gint64 gap = MIN(slot - series->slot[i] - 1,
+                                 (gint64)tier->capacity);
+
+                for (gint64 j = 1; j <= gap; j++)
+                    series->values[i][(series->slot[i] + j) % tier->capacity] = NAN;
+            }
+            series->slot[i] = slot;
+            series->sum[i] = 0;
+            series->count[i] = 0;
+        }
+
+        series->sum[i] += value;
+        series->count[i]++;
+        series->values[i][slot % tier->capacity] = series->sum[i] / series->count[i];
+    }
+
+    series->updated = timestamp;
+}
+
+/**
+ * virtDBusHistoryAddTypedParams:
+ * @history: history
+ * @object: name of the object
+ * @timestamp: UNIX time of the sample in seconds
+ * @params: typed parameters, typically a stats record
+ * @nparams: number of @params
+ *
+ * Records numeric values of the fields selected for @history.
+ */
+void
+virtDBusHistoryAddTypedParams(virtDBusHistory *history,
+                              const gchar *object,
+                              gint64 timestamp,
+                              virTypedParameterPtr params,
+                              gint nparams)
+{
+    for (gint i = 0; i < nparams; i++) {
+        gdouble value;
+
+        if (!virtDBusUtilFieldSelected((const gchar *const *)history->fields,
+                                       params[i].field)) {
+            continue;
+        }
+
+        switch (params[i].type) {
+        case VIR_TYPED_PARAM_INT:
+            value = params[i].value.i;
+            break;
+        case VIR_TYPED_PARAM_UINT:
+            value = params[i].value.ui;
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+            value = params[i].value.l;
+            break;
+        case VIR_TYPED_PARAM_ULLONG:
+            value = params[i].value.ul;
+            break;
+        case VIR_TYPED_PARAM_DOUBLE:
+            value = params[i].value.d;
+            break;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            value = params[i].value.b;
+            break;
+        case VIR_TYPED_PARAM_STRING:
+        default:
+            continue;
+        }
+
+        virtDBusHistoryAdd(history, object, params[i].field, timestamp, value);
+    }
+}
+
+/**
+ * virtDBusHistoryGet:
+ * @history: history
+ * @object: name of the object
+ * @fields: NULL-terminated list of patterns of returned fields, NULL or
+ *   empty list returns all recorded fields
+ * @now: current UNIX time in seconds
+ * @range: number of seconds before @now to return
+ *
+ * Returns the values of the finest tier covering @range, or of the
+ * coarsest tier if none does, as floating a(sxuad) array of the field
+ * name, UNIX time of the first value, resolution in seconds and the
+ * values where missing ones are NaN.
+ */
+GVariant *
+virtDBusHistoryGet(virtDBusHistory *history,
+                   const gchar *object,
+                   const gchar *const *fields,
+                   gint64 now,
+                   guint range)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&history->lock);
+    const virtDBusHistoryTier *tier;
+    g_autofree gdouble *values = NULL;
+    GVariantBuilder builder;
+    GHashTable *objectFields;
+    GHashTableIter iter;
+    const gchar *field;
+    virtDBusHistorySeries *series;
+    gsize ntier = 0;
+    gint64 first;
+    gint64 last;
+    guint nvalues;
+
+    for (ntier = 0; ntier < VIRT_DBUS_HISTORY_NTIERS - 1; ntier++) {
+        if ((guint64)virtDBusHistoryTiers[ntier].resolution *
+            virtDBusHistoryTiers[ntier].capacity >= range) {
+            break;
+        }
+    }
+    tier = virtDBusHistoryTiers + ntier;
+
+    nvalues = MAX(1, MIN(((guint64)range + tier->resolution - 1) / tier->resolution,
+                         tier->capacity));
+    last = now / tier->resolution;
+    first = last - nvalues + 1;
+    values = g_new(gdouble, nvalues);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sxuad)"));
+
+    objectFields = g_hash_table_lookup(history->objects, object);
+    if (!objectFields)
+        return g_variant_builder_end(&builder);
+
+    g_hash_table_iter_init(&iter, objectFields);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&field, (gpointer *)&series)) {
+        gint64 newest = series->slot[ntier];
+
+        if (!virtDBusUtilFieldSelected(fields, field))
+            continue;
+
+        /* Slots outside of the last capacity slots of the series were
+         * overwritten or not written yet. */
+        for (guint i = 0; i < nvalues; i++) {
+            gint64 slot = first + i;
+
+            if (newest < 0 || slot < 0 || slot > newest ||
+                slot <= newest - tier->capacity)
+                values[i] = NAN;
+            else
+                values[i] = series->values[ntier][slot % tier->capacity];
+        }
+
+        g_variant_builder_add(&builder, "(sxu@ad)", field,
+                              first * tier->resolution, tier->resolution,
+                              g_variant_new_fixed_array(G_VARIANT_TYPE_DOUBLE,
+                                                        values, nvalues,
+                                                        sizeof(gdouble)));
+    }
+
+    return g_variant_builder_end(&builder);
+}
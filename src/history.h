@@ -0,0 +1,52 @@
+#pragma once
+
+#include "util.h"
+
+/* Stats fields recorded unless configured otherwise. */
+#define VIRT_DBUS_HISTORY_DEFAULT_FIELDS \
+    "cpu.time,balloon.current,block.*.bytes,block.*.reqs,net.*.bytes,net.*.pkts"
+
+typedef struct _virtDBusHistory virtDBusHistory;
+
+void
+virtDBusHistorySetDefaults(gsize maxMemory,
+                           const gchar *fields);
+
+virtDBusHistory *
+virtDBusHistoryNew(gsize maxMemory,
+                   const gchar *const *fields);
+
+virtDBusHistory *
+virtDBusHistoryNewDefault(void);
+
+void
+virtDBusHistoryFree(virtDBusHistory *history);
+
+void
+virtDBusHistoryClear(virtDBusHistory *history);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusHistory, virtDBusHistoryFree);
+
+const gchar *const *
+virtDBusHistoryGetFields(virtDBusHistory *history);
+
+void
+virtDBusHistoryAdd(virtDBusHistory *history,
+                   const gchar *object,
+                   const gchar *field,
+                   gint64 timestamp,
+                   gdouble value);
+
+void
+virtDBusHistoryAddTypedParams(virtDBusHistory *history,
+                              const gchar *object,
+                              gint64 timestamp,
+                              virTypedParameterPtr params,
+                              gint nparams);
+
+GVariant *
+virtDBusHistoryGet(virtDBusHistory *history,
+                   const gchar *object,
+                   const gchar *const *fields,
+                   gint64 now,
+                   guint range);
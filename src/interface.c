@@ -9,10 +9,16 @@ virtDBusInterfaceGetVirInterface(virtDBusConnect *connect,
                                  GError **error)
 {
     virInterfacePtr interface;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    interface = virtDBusUtilHandleCacheLookup(connect->interfaceCache, objectPath,
+                                              connect->connection, &generation);
+    if (interface)
+        return interface;
+
     interface = virtDBusUtilVirInterfaceFromBusPath(connect->connection,
                                                     objectPath,
                                                     connect->interfacePath);
@@ -21,6 +27,9 @@ virtDBusInterfaceGetVirInterface(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->interfaceCache, objectPath,
+                                  connect->connection, interface, generation);
+
     return interface;
 }
 
@@ -98,16 +107,11 @@ virtDBusInterfaceGetMAC(const gchar *objectPath,
                         GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virInterface) interface = NULL;
-    const gchar *mac;
-
-    interface = virtDBusInterfaceGetVirInterface(connect, objectPath, error);
-    if (!interface)
-        return;
+    g_autofree gchar *mac = NULL;
 
-    mac = virInterfaceGetMACString(interface);
+    mac = virtDBusUtilNameFromBusPath(objectPath, connect->interfacePath, error);
     if (!mac)
-        return virtDBusUtilSetLastVirtError(error);
+        return;
 
     *value = g_variant_new("s", mac);
 }
@@ -171,27 +175,36 @@ virtDBusInterfaceUndefine(GVariant *inArgs G_GNUC_UNUSED,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virInterface) interface = NULL;
+    gint ret;
 
     interface = virtDBusInterfaceGetVirInterface(connect, objectPath, error);
     if (!interface)
         return;
 
-    if (virInterfaceUndefine(interface) < 0)
-        virtDBusUtilSetLastVirtError(error);
+    virtDBusUtilHandleCacheRemove(connect->interfaceCache, objectPath);
+
+    ret = virInterfaceUndefine(interface);
+
+    virtDBusGDBusInvalidateSubtree(connect->interfacePath);
+
+    if (ret < 0)
+        return virtDBusUtilSetLastVirtError(error);
+
+    virtDBusGDBusEmitInterfacesRemoved(connect->bus, objectPath);
 }
 
 static virtDBusGDBusPropertyTable virtDBusInterfacePropertyTable[] = {
-    { "Active", virtDBusInterfaceGetActive, NULL },
-    { "MAC", virtDBusInterfaceGetMAC, NULL },
-    { "Name", virtDBusInterfaceGetName, NULL },
+    { "Active", virtDBusInterfaceGetActive, NULL, 0, 0 },
+    { "MAC", virtDBusInterfaceGetMAC, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
+    { "Name", virtDBusInterfaceGetName, NULL, 0, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusInterfaceMethodTable[] = {
-    { "Create", virtDBusInterfaceCreate },
-    { "Destroy", virtDBusInterfaceDestroy },
-    { "GetXMLDesc", virtDBusInterfaceGetXMLDesc },
-    { "Undefine", virtDBusInterfaceUndefine },
+    { "Create", virtDBusInterfaceCreate, 0 },
+    { "Destroy", virtDBusInterfaceDestroy, 0 },
+    { "GetXMLDesc", virtDBusInterfaceGetXMLDesc, 0 },
+    { "Undefine", virtDBusInterfaceUndefine, 0 },
     { 0 }
 };
 
@@ -223,6 +236,19 @@ virtDBusInterfaceEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusInterfaceExists(const gchar *objectPath,
+                        gpointer userData,
+                        GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virInterface) interface = NULL;
+
+    interface = virtDBusInterfaceGetVirInterface(connect, objectPath, error);
+
+    return !!interface;
+}
+
 static GDBusInterfaceInfo *interfaceInfo;
 
 void
@@ -243,7 +269,10 @@ virtDBusInterfaceRegister(virtDBusConnect *connect,
                                  connect->interfacePath,
                                  interfaceInfo,
                                  virtDBusInterfaceEnumerate,
+                                 virtDBusInterfaceExists,
                                  virtDBusInterfaceMethodTable,
                                  virtDBusInterfacePropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
@@ -1,4 +1,7 @@
 #include "connect.h"
+#include "history.h"
+#include "stats.h"
+#include "statsfile.h"
 #include "util.h"
 
 #include <glib-unix.h>
@@ -97,6 +100,13 @@ main(gint argc, gchar *argv[])
     static gboolean systemOpt = FALSE;
     static gboolean sessionOpt = FALSE;
     static gint maxThreads = VIRT_DBUS_MAX_THREADS;
+    static gint statsMaxStaleness = VIRT_DBUS_STATS_DEFAULT_MAX_STALENESS;
+    static gint statsHistoryMemory = 0;
+    static gchar *statsHistoryFields = NULL;
+    static gchar *statsFileDir = NULL;
+    static gchar *statsFileGroup = NULL;
+    static gint statsFileInterval = 1000;
+    static gchar *statsFileFields = NULL;
     GBusType busType;
     g_auto(virtDBusGDBusSource) sigintSource = 0;
     g_auto(virtDBusGDBusSource) sigtermSource = 0;
@@ -113,6 +123,20 @@ main(gint argc, gchar *argv[])
             "Connect to the session bus", NULL },
         { "threads", 't', 0, G_OPTION_ARG_INT, &maxThreads,
             "Configure maximal number of worker threads", "N" },
+        { "stats-max-staleness", 0, 0, G_OPTION_ARG_INT, &statsMaxStaleness,
+            "Fill in stats of busy domains on request from samples up to SECONDS old", "SECONDS" },
+        { "stats-history-memory", 0, 0, G_OPTION_ARG_INT, &statsHistoryMemory,
+            "Record history of domain stats in up to MIB of memory per connection", "MIB" },
+        { "stats-history-fields", 0, 0, G_OPTION_ARG_STRING, &statsHistoryFields,
+            "Comma separated patterns of recorded stats fields", "PATTERNS" },
+        { "stats-file-dir", 0, 0, G_OPTION_ARG_FILENAME, &statsFileDir,
+            "Publish stats of all domains in memory-mapped files in DIR", "DIR" },
+        { "stats-file-group", 0, 0, G_OPTION_ARG_STRING, &statsFileGroup,
+            "Allow GROUP to read the stats files", "GROUP" },
+        { "stats-file-interval", 0, 0, G_OPTION_ARG_INT, &statsFileInterval,
+            "Update the stats files every MS milliseconds", "MS" },
+        { "stats-file-fields", 0, 0, G_OPTION_ARG_STRING, &statsFileFields,
+            "Comma separated patterns of the columns of the stats files", "PATTERNS" },
         { 0 }
     };
 
@@ -129,6 +153,34 @@ main(gint argc, gchar *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if (statsMaxStaleness < 0) {
+        g_printerr("--stats-max-staleness must not be negative.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (statsHistoryMemory < 0) {
+        g_printerr("--stats-history-memory must not be negative.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (statsFileInterval < 100) {
+        g_printerr("--stats-file-interval must be at least 100.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    virtDBusStatsSetMaxStaleness((gint64)statsMaxStaleness * G_USEC_PER_SEC);
+    virtDBusHistorySetDefaults((gsize)statsHistoryMemory * 1024 * 1024,
+                               statsHistoryFields ? statsHistoryFields :
+                               VIRT_DBUS_HISTORY_DEFAULT_FIELDS);
+    if (!virtDBusStatsFileSetDefaults(statsFileDir, statsFileGroup,
+                                      statsFileInterval,
+                                      statsFileFields ? statsFileFields :
+                                      VIRT_DBUS_STATS_FILE_DEFAULT_FIELDS,
+                                      &error)) {
+        g_printerr("--stats-file-group: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+
     if (sessionOpt) {
         busType = G_BUS_TYPE_SESSION;
     } else if (systemOpt) {
@@ -155,6 +207,11 @@ main(gint argc, gchar *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if (!virtDBusGDBusPrepareIngressContext(&error)) {
+        g_printerr("%s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+
     loop = g_main_loop_new(NULL, FALSE);
 
     sigtermSource = g_unix_signal_add(SIGTERM,
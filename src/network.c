@@ -18,10 +18,16 @@ virtDBusNetworkGetVirNetwork(virtDBusConnect *connect,
                              GError **error)
 {
     virNetworkPtr network;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    network = virtDBusUtilHandleCacheLookup(connect->networkCache, objectPath,
+                                            connect->connection, &generation);
+    if (network)
+        return network;
+
     network = virtDBusUtilVirNetworkFromBusPath(connect->connection,
                                                 objectPath,
                                                 connect->networkPath);
@@ -30,6 +36,9 @@ virtDBusNetworkGetVirNetwork(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->networkCache, objectPath,
+                                  connect->connection, network, generation);
+
     return network;
 }
 
@@ -123,16 +132,11 @@ virtDBusNetworkGetUUID(const gchar *objectPath,
                        GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virNetwork) network = NULL;
     gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
 
-    network = virtDBusNetworkGetVirNetwork(connect, objectPath, error);
-    if (!network)
+    if (!virtDBusUtilUUIDFromBusPath(objectPath, connect->networkPath, uuid, error))
         return;
 
-    if (virNetworkGetUUIDString(network, uuid) < 0)
-        return virtDBusUtilSetLastVirtError(error);
-
     *value = g_variant_new("s", uuid);
 }
 
@@ -143,6 +147,7 @@ virtDBusNetworkSetAutostart(GVariant *value,
                             GError **error)
 {
     virtDBusConnect *connect = userData;
+    static const gchar *const properties[] = { "Autostart", NULL };
     g_autoptr(virNetwork) network = NULL;
     gboolean autostart;
 
@@ -154,6 +159,9 @@ virtDBusNetworkSetAutostart(GVariant *value,
 
     if (virNetworkSetAutostart(network, autostart) < 0)
         return virtDBusUtilSetLastVirtError(error);
+
+    virtDBusGDBusEmitPropertiesChanged(connect->bus, objectPath,
+                                       VIRT_DBUS_NETWORK_INTERFACE, properties);
 }
 
 static void
@@ -174,6 +182,8 @@ virtDBusNetworkCreate(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virNetworkCreate(network) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->networkXMLCache, objectPath);
 }
 
 static void
@@ -194,6 +204,8 @@ virtDBusNetworkDestroy(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virNetworkDestroy(network) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->networkXMLCache, objectPath);
 }
 
 static void
@@ -255,10 +267,18 @@ virtDBusNetworkGetXMLDesc(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virNetwork) network = NULL;
     g_autofree gchar *xml = NULL;
+    guint generation;
     guint flags;
 
     g_variant_get(inArgs, "(u)", &flags);
 
+    xml = virtDBusUtilXMLCacheLookup(connect->networkXMLCache, objectPath,
+                                     flags, &generation);
+    if (xml) {
+        *outArgs = g_variant_new("(s)", xml);
+        return;
+    }
+
     network = virtDBusNetworkGetVirNetwork(connect, objectPath, error);
     if (!network)
         return;
@@ -267,6 +287,9 @@ virtDBusNetworkGetXMLDesc(GVariant *inArgs,
     if (!xml)
         return virtDBusUtilSetLastVirtError(error);
 
+    virtDBusUtilXMLCacheInsert(connect->networkXMLCache, objectPath, flags, xml,
+                               generation);
+
     *outArgs = g_variant_new("(s)", xml);
 }
 
@@ -288,6 +311,8 @@ virtDBusNetworkUndefine(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virNetworkUndefine(network) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->networkXMLCache, objectPath);
 }
 
 static void
@@ -318,24 +343,26 @@ virtDBusNetworkUpdate(GVariant *inArgs,
     if (virNetworkUpdate(network, command, section,
                          parentIndex, xml, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->networkXMLCache, objectPath);
 }
 
 static virtDBusGDBusPropertyTable virtDBusNetworkPropertyTable[] = {
-    { "Active", virtDBusNetworkGetActive, NULL },
-    { "Autostart", virtDBusNetworkGetAutostart, virtDBusNetworkSetAutostart },
-    { "Name", virtDBusNetworkGetName, NULL },
-    { "Persistent", virtDBusNetworkGetPersistent, NULL },
-    { "UUID", virtDBusNetworkGetUUID, NULL },
+    { "Active", virtDBusNetworkGetActive, NULL, 0, 0 },
+    { "Autostart", virtDBusNetworkGetAutostart, virtDBusNetworkSetAutostart, 0, 0 },
+    { "Name", virtDBusNetworkGetName, NULL, 0, 0 },
+    { "Persistent", virtDBusNetworkGetPersistent, NULL, 0, 0 },
+    { "UUID", virtDBusNetworkGetUUID, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusNetworkMethodTable[] = {
-    { "Create", virtDBusNetworkCreate },
-    { "Destroy", virtDBusNetworkDestroy },
-    { "GetDHCPLeases", virtDBusNetworkGetDHCPLeases },
-    { "GetXMLDesc", virtDBusNetworkGetXMLDesc },
-    { "Undefine", virtDBusNetworkUndefine },
-    { "Update", virtDBusNetworkUpdate },
+    { "Create", virtDBusNetworkCreate, 0 },
+    { "Destroy", virtDBusNetworkDestroy, 0 },
+    { "GetDHCPLeases", virtDBusNetworkGetDHCPLeases, 0 },
+    { "GetXMLDesc", virtDBusNetworkGetXMLDesc, 0 },
+    { "Undefine", virtDBusNetworkUndefine, 0 },
+    { "Update", virtDBusNetworkUpdate, 0 },
     { 0 }
 };
 
@@ -367,6 +394,19 @@ virtDBusNetworkEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusNetworkExists(const gchar *objectPath,
+                      gpointer userData,
+                      GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virNetwork) network = NULL;
+
+    network = virtDBusNetworkGetVirNetwork(connect, objectPath, error);
+
+    return !!network;
+}
+
 static GDBusInterfaceInfo *interfaceInfo = NULL;
 
 void
@@ -386,7 +426,10 @@ virtDBusNetworkRegister(virtDBusConnect *connect,
                                  connect->networkPath,
                                  interfaceInfo,
                                  virtDBusNetworkEnumerate,
+                                 virtDBusNetworkExists,
                                  virtDBusNetworkMethodTable,
                                  virtDBusNetworkPropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
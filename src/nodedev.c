@@ -9,10 +9,16 @@ virtDBusNodeDeviceGetVirNodeDevice(virtDBusConnect *connect,
                                    GError **error)
 {
     virNodeDevicePtr dev;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    dev = virtDBusUtilHandleCacheLookup(connect->nodeDevCache, objectPath,
+                                        connect->connection, &generation);
+    if (dev)
+        return dev;
+
     dev = virtDBusUtilVirNodeDeviceFromBusPath(connect->connection,
                                                objectPath,
                                                connect->nodeDevPath);
@@ -21,6 +27,9 @@ virtDBusNodeDeviceGetVirNodeDevice(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->nodeDevCache, objectPath,
+                                  connect->connection, dev, generation);
+
     return dev;
 }
 
@@ -31,16 +40,11 @@ virtDBusNodeDeviceGetName(const gchar *objectPath,
                           GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virNodeDevice) dev = NULL;
-    const gchar *name;
-
-    dev = virtDBusNodeDeviceGetVirNodeDevice(connect, objectPath, error);
-    if (!dev)
-        return;
+    g_autofree gchar *name = NULL;
 
-    name = virNodeDeviceGetName(dev);
+    name = virtDBusUtilNameFromBusPath(objectPath, connect->nodeDevPath, error);
     if (!name)
-        return virtDBusUtilSetLastVirtError(error);
+        return;
 
     *value = g_variant_new("s", name);
 }
@@ -214,18 +218,18 @@ virtDBusNodeDeviceReset(GVariant *inArgs G_GNUC_UNUSED,
 }
 
 static virtDBusGDBusPropertyTable virtDBusNodeDevicePropertyTable[] = {
-    { "Name", virtDBusNodeDeviceGetName, NULL },
-    { "Parent", virtDBusNodeDeviceGetParent, NULL },
+    { "Name", virtDBusNodeDeviceGetName, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
+    { "Parent", virtDBusNodeDeviceGetParent, NULL, 0, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusNodeDeviceMethodTable[] = {
-    { "Destroy", virtDBusNodeDeviceDestroy },
-    { "Detach", virtDBusNodeDeviceDetach },
-    { "GetXMLDesc", virtDBusNodeDeviceGetXMLDesc },
-    { "ListCaps", virtDBusNodeDeviceListCaps },
-    { "ReAttach", virtDBusNodeDeviceReAttach },
-    { "Reset", virtDBusNodeDeviceReset },
+    { "Destroy", virtDBusNodeDeviceDestroy, 0 },
+    { "Detach", virtDBusNodeDeviceDetach, 0 },
+    { "GetXMLDesc", virtDBusNodeDeviceGetXMLDesc, 0 },
+    { "ListCaps", virtDBusNodeDeviceListCaps, 0 },
+    { "ReAttach", virtDBusNodeDeviceReAttach, 0 },
+    { "Reset", virtDBusNodeDeviceReset, 0 },
     { 0 }
 };
 
@@ -257,6 +261,19 @@ virtDBusNodeDeviceEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusNodeDeviceExists(const gchar *objectPath,
+                         gpointer userData,
+                         GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virNodeDevice) dev = NULL;
+
+    dev = virtDBusNodeDeviceGetVirNodeDevice(connect, objectPath, error);
+
+    return !!dev;
+}
+
 static GDBusInterfaceInfo *interfaceInfo;
 
 void
@@ -277,7 +294,10 @@ virtDBusNodeDeviceRegister(virtDBusConnect *connect,
                                  connect->nodeDevPath,
                                  interfaceInfo,
                                  virtDBusNodeDeviceEnumerate,
+                                 virtDBusNodeDeviceExists,
                                  virtDBusNodeDeviceMethodTable,
                                  virtDBusNodeDevicePropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
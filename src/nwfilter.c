@@ -9,10 +9,16 @@ virtDBusNWFilterGetVirNWFilter(virtDBusConnect *connect,
                                GError **error)
 {
     virNWFilterPtr nwfilter;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    nwfilter = virtDBusUtilHandleCacheLookup(connect->nwfilterCache, objectPath,
+                                             connect->connection, &generation);
+    if (nwfilter)
+        return nwfilter;
+
     nwfilter = virtDBusUtilVirNWFilterFromBusPath(connect->connection,
                                                   objectPath,
                                                   connect->nwfilterPath);
@@ -21,6 +27,9 @@ virtDBusNWFilterGetVirNWFilter(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->nwfilterCache, objectPath,
+                                  connect->connection, nwfilter, generation);
+
     return nwfilter;
 }
 
@@ -52,16 +61,11 @@ virtDBusNWFilterGetUUID(const gchar *objectPath,
                         GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virNWFilter) nwfilter = NULL;
     gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
 
-    nwfilter = virtDBusNWFilterGetVirNWFilter(connect, objectPath, error);
-    if (!nwfilter)
+    if (!virtDBusUtilUUIDFromBusPath(objectPath, connect->nwfilterPath, uuid, error))
         return;
 
-    if (virNWFilterGetUUIDString(nwfilter, uuid) < 0)
-        return virtDBusUtilSetLastVirtError(error);
-
     *value = g_variant_new("s", uuid);
 }
 
@@ -103,24 +107,33 @@ virtDBusNWFilterUndefine(GVariant *inArgs G_GNUC_UNUSED,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virNWFilter) nwfilter = NULL;
+    gint ret;
 
     nwfilter = virtDBusNWFilterGetVirNWFilter(connect, objectPath, error);
     if (!nwfilter)
         return;
 
-    if (virNWFilterUndefine(nwfilter) < 0)
-        virtDBusUtilSetLastVirtError(error);
+    virtDBusUtilHandleCacheRemove(connect->nwfilterCache, objectPath);
+
+    ret = virNWFilterUndefine(nwfilter);
+
+    virtDBusGDBusInvalidateSubtree(connect->nwfilterPath);
+
+    if (ret < 0)
+        return virtDBusUtilSetLastVirtError(error);
+
+    virtDBusGDBusEmitInterfacesRemoved(connect->bus, objectPath);
 }
 
 static virtDBusGDBusPropertyTable virtDBusNWFilterPropertyTable[] = {
-    { "Name", virtDBusNWFilterGetName, NULL },
-    { "UUID", virtDBusNWFilterGetUUID, NULL },
+    { "Name", virtDBusNWFilterGetName, NULL, 0, 0 },
+    { "UUID", virtDBusNWFilterGetUUID, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusNWFilterMethodTable[] = {
-    { "GetXMLDesc", virtDBusNWFilterGetXMLDesc },
-    { "Undefine", virtDBusNWFilterUndefine},
+    { "GetXMLDesc", virtDBusNWFilterGetXMLDesc, 0 },
+    { "Undefine", virtDBusNWFilterUndefine, 0 },
     { 0 }
 };
 
@@ -152,6 +165,19 @@ virtDBusNWFilterEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusNWFilterExists(const gchar *objectPath,
+                       gpointer userData,
+                       GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virNWFilter) nwfilter = NULL;
+
+    nwfilter = virtDBusNWFilterGetVirNWFilter(connect, objectPath, error);
+
+    return !!nwfilter;
+}
+
 static GDBusInterfaceInfo *interfaceInfo;
 
 void
@@ -172,7 +198,10 @@ virtDBusNWFilterRegister(virtDBusConnect *connect,
                                  connect->nwfilterPath,
                                  interfaceInfo,
                                  virtDBusNWFilterEnumerate,
+                                 virtDBusNWFilterExists,
                                  virtDBusNWFilterMethodTable,
                                  virtDBusNWFilterPropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
@@ -0,0 +1,825 @@
+#include "sampler.h"
+#include "connect.h"
+#include "domain.h"
+#include "threshold.h"
+
+/* Shortest sampling interval in milliseconds so that a client cannot make
+ * us poll libvirt in a busy loop. */
+#define VIRT_DBUS_SAMPLER_MIN_INTERVAL 100
+
+/* Upper bound of subscriptions of one client.  Every subscription keeps
+ * the last values sent to its client.  Subscriptions of the daemon itself
+ * do not count. */
+#define VIRT_DBUS_SAMPLER_MAX_SUBSCRIPTIONS 64
+
+/* Interval of sampling for the stats history in milliseconds, it matches
+ * the finest resolution of the history. */
+#define VIRT_DBUS_SAMPLER_HISTORY_INTERVAL 1000
+
+/* Interval of evaluating threshold rules in milliseconds. */
+#define VIRT_DBUS_SAMPLER_THRESHOLDS_INTERVAL 1000
+
+/* IDs of the subscriptions of the daemon itself, never given to clients. */
+#define VIRT_DBUS_SAMPLER_HISTORY_ID 0
+#define VIRT_DBUS_SAMPLER_STATS_FILE_ID (G_MAXUINT - 1)
+#define VIRT_DBUS_SAMPLER_THRESHOLDS_ID G_MAXUINT
+
+/* The stats history, the stats file and the threshold rules are fed by
+ * subscriptions without a sender so that they share libvirt calls with
+ * the subscribed clients. */
+typedef enum {
+    VIRT_DBUS_SAMPLER_CLIENT,
+    VIRT_DBUS_SAMPLER_HISTORY,
+    VIRT_DBUS_SAMPLER_STATS_FILE,
+    VIRT_DBUS_SAMPLER_THRESHOLDS,
+} virtDBusSamplerKind;
+
+struct _virtDBusSamplerSubscription {
+    guint id;
+    virtDBusSamplerKind kind;
+    gchar *sender;
+    guint stats;
+    guint flags;
+    gint64 interval;
+    gint64 due;
+    GHashTable *last;
+};
+typedef struct _virtDBusSamplerSubscription virtDBusSamplerSubscription;
+
+struct _virtDBusSampler {
+    virtDBusConnect *connect;
+    GMutex lock;
+    GHashTable *subscriptions;
+    guint nextId;
+    GSource *timer;
+    guint timerInterval;
+    GThreadPool *pool;
+    gboolean sampling;
+    guint nameOwnerChangedId;
+    virtDBusThresholds *thresholds;
+};
+
+static void
+virtDBusSamplerSubscriptionFree(gpointer opaque)
+{
+    virtDBusSamplerSubscription *sub = opaque;
+
+    g_free(sub->sender);
+    g_hash_table_unref(sub->last);
+    g_free(sub);
+}
+
+/* Has to be called with the sampler lock held. */
+static virtDBusSamplerSubscription *
+virtDBusSamplerAddSubscription(virtDBusSampler *sampler,
+                               guint id,
+                               virtDBusSamplerKind kind,
+                               const gchar *sender,
+                               guint stats,
+                               guint interval,
+                               guint flags)
+{
+    virtDBusSamplerSubscription *sub = g_new0(virtDBusSamplerSubscription, 1);
+
+    sub->id = id;
+    sub->kind = kind;
+    sub->sender = g_strdup(sender);
+    sub->stats = stats;
+    sub->flags = flags;
+    sub->interval = (gint64)interval * 1000;
+    sub->due = g_get_monotonic_time();
+    sub->last = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify)g_hash_table_unref);
+
+    g_hash_table_insert(sampler->subscriptions, GUINT_TO_POINTER(id), sub);
+
+    return sub;
+}
+
+/* Has to be called with the sampler lock held. */
+static guint
+virtDBusSamplerCountSubscriptions(virtDBusSampler *sampler,
+                                  const gchar *sender)
+{
+    GHashTableIter iter;
+    virtDBusSamplerSubscription *sub;
+    guint count = 0;
+
+    g_hash_table_iter_init(&iter, sampler->subscriptions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sub)) {
+        if (sub->kind == VIRT_DBUS_SAMPLER_CLIENT &&
+            g_strcmp0(sub->sender, sender) == 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static guint
+virtDBusSamplerGCD(guint a,
+                   guint b)
+{
+    while (b) {
+        guint tmp = a % b;
+        a = b;
+        b = tmp;
+    }
+
+    return a;
+}
+
+static gboolean
+virtDBusSamplerTick(gpointer opaque)
+{
+    virtDBusSampler *sampler = opaque;
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+
+    /* Ticks are skipped while libvirt is slower than the interval. */
+    if (!sampler->sampling) {
+        sampler->sampling = TRUE;
+        g_thread_pool_push(sampler->pool, sampler, NULL);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/*
+ * The timer ticks with the greatest common divisor of the intervals of
+ * all subscriptions so that every subscription is served on time by one
+ * timer.  Has to be called with the sampler lock held.
+ */
+static void
+virtDBusSamplerReschedule(virtDBusSampler *sampler)
+{
+    GHashTableIter iter;
+    virtDBusSamplerSubscription *sub;
+    guint interval = 0;
+
+    g_hash_table_iter_init(&iter, sampler->subscriptions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sub))
+        interval = virtDBusSamplerGCD(interval, (guint)(sub->interval / 1000));
+
+    if (interval > 0)
+        interval = MAX(interval, VIRT_DBUS_SAMPLER_MIN_INTERVAL);
+
+    if (interval == sampler->timerInterval)
+        return;
+
+    if (sampler->timer) {
+        g_source_destroy(sampler->timer);
+        g_source_unref(sampler->timer);
+        sampler->timer = NULL;
+    }
+
+    sampler->timerInterval = interval;
+
+    if (interval == 0)
+        return;
+
+    sampler->timer = g_timeout_source_new(interval);
+    g_source_set_callback(sampler->timer, virtDBusSamplerTick, sampler, NULL);
+    g_source_attach(sampler->timer, NULL);
+}
+
+/* Has to be called with the sampler lock held. */
+static gboolean
+virtDBusSamplerIsDue(virtDBusSampler *sampler,
+                     virtDBusSamplerSubscription *sub,
+                     gint64 now)
+{
+    /* Timers never fire early but they may fire late so subscriptions
+     * due within half of a tick are served right away instead of being
+     * delayed by a whole tick. */
+    return sub->due - now <= (gint64)sampler->timerInterval * 1000 / 2;
+}
+
+/*
+ * Returns changes of the fields the subscription is interested in since
+ * the last values sent to its client or NULL if nothing has changed.
+ * Domains which were not sampled are forgotten.
+ */
+static GVariant *
+virtDBusSamplerDelta(virtDBusSamplerSubscription *sub,
+                     GPtrArray *paths,
+                     GPtrArray *records)
+{
+    g_autoptr(GHashTable) sampled = g_hash_table_new(g_str_hash, g_str_equal);
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    const gchar *path;
+    guint nchanged = 0;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+
+    for (guint i = 0; i < paths->len; i++) {
+        GHashTable *last;
+        GVariantIter fields;
+        const gchar *name;
+        GVariant *value;
+        gboolean changed = FALSE;
+
+        path = g_ptr_array_index(paths, i);
+        g_hash_table_add(sampled, (gpointer)path);
+
+        last = g_hash_table_lookup(sub->last, path);
+        if (!last) {
+            last = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)g_variant_unref);
+            g_hash_table_insert(sub->last, g_strdup(path), last);
+        }
+
+        g_variant_iter_init(&fields, g_ptr_array_index(records, i));
+        while (g_variant_iter_loop(&fields, "{&sv}", &name, &value)) {
+            GVariant *prev;
+
+            if (!virtDBusStatsFieldInGroups(name, sub->stats))
+                continue;
+
+            prev = g_hash_table_lookup(last, name);
+            if (prev && g_variant_equal(prev, value))
+                continue;
+
+            g_hash_table_replace(last, g_strdup(name), g_variant_ref(value));
+
+            if (!changed) {
+                g_variant_builder_open(&builder, G_VARIANT_TYPE("(oa{sv})"));
+                g_variant_builder_add(&builder, "o", path);
+                g_variant_builder_open(&builder, G_VARIANT_TYPE("a{sv}"));
+                changed = TRUE;
+            }
+            g_variant_builder_add(&builder, "{sv}", name, value);
+        }
+
+        if (changed) {
+            g_variant_builder_close(&builder);
+            g_variant_builder_close(&builder);
+            nchanged++;
+        }
+    }
+
+    g_hash_table_iter_init(&iter, sub->last);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&path, NULL)) {
+        if (!g_hash_table_contains(sampled, path))
+            g_hash_table_iter_remove(&iter);
+    }
+
+    if (nchanged == 0) {
+        g_variant_builder_clear(&builder);
+        return NULL;
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/* Returns new reference to @record completed with @rates. */
+static GVariant *
+virtDBusSamplerWithRates(GVariant *record,
+                         GVariant *rates)
+{
+    GVariantBuilder builder;
+    GVariantIter iter;
+    const gchar *name;
+    GVariant *value;
+
+    if (!rates)
+        return g_variant_ref(record);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    g_variant_iter_init(&iter, rates);
+    while (g_variant_iter_loop(&iter, "{&sv}", &name, &value))
+        g_variant_builder_add(&builder, "{sv}", name, value);
+
+    g_variant_iter_init(&iter, record);
+    while (g_variant_iter_loop(&iter, "{&sv}", &name, &value))
+        g_variant_builder_add(&builder, "{sv}", name, value);
+
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static void
+virtDBusSamplerThresholdCrossed(const gchar *owner,
+                                const gchar *object,
+                                guint id,
+                                const gchar *field,
+                                gdouble value,
+                                gboolean crossed,
+                                gpointer opaque)
+{
+    virtDBusConnect *connect = opaque;
+
+    /* Only the client that added the rule knows its ID. */
+    g_dbus_connection_emit_signal(connect->bus,
+                                  owner,
+                                  object,
+                                  VIRT_DBUS_DOMAIN_INTERFACE,
+                                  "ThresholdCrossed",
+                                  g_variant_new("(usdb)", id, field,
+                                                value, crossed),
+                                  NULL);
+}
+
+/*
+ * Collects stats of all domains once for every due subscription with
+ * the given libvirt flags, asking libvirt for the union of their stats
+ * groups, and sends every subscriber the values which changed for it.
+ * Rates are derived only if some of the subscriptions asked for them.
+ */
+static void
+virtDBusSamplerCollect(virtDBusSampler *sampler,
+                       guint flags,
+                       gint64 now)
+{
+    virtDBusConnect *connect = sampler->connect;
+    g_autoptr(virDomainStatsRecordPtr) records = NULL;
+    g_autoptr(GPtrArray) paths = NULL;
+    g_autoptr(GPtrArray) grecords = NULL;
+    g_autoptr(GPtrArray) rateRecords = NULL;
+    g_autoptr(GError) error = NULL;
+    GHashTableIter iter;
+    virtDBusSamplerSubscription *sub;
+    guint stats = 0;
+    gboolean allStats = FALSE;
+    gboolean rates = FALSE;
+    gint64 timestamp;
+    gint nrecords;
+
+    g_mutex_lock(&sampler->lock);
+    g_hash_table_iter_init(&iter, sampler->subscriptions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sub)) {
+        if ((sub->flags & ~VIRT_DBUS_STATS_FLAGS) != flags ||
+            !virtDBusSamplerIsDue(sampler, sub, now)) {
+            continue;
+        }
+        if (sub->stats == 0)
+            allStats = TRUE;
+        if (sub->flags & VIRT_DBUS_STATS_RATES)
+            rates = TRUE;
+        stats |= sub->stats;
+    }
+    g_mutex_unlock(&sampler->lock);
+
+    if (allStats)
+        stats = 0;
+
+    if (!virtDBusConnectOpen(connect, &error))
+        return;
+
+    nrecords = virtDBusStatsGetAllDomainStats(connect->connection, stats,
+                                              &records, flags);
+    if (nrecords < 0)
+        return;
+
+    timestamp = g_get_real_time() / G_USEC_PER_SEC;
+
+    paths = g_ptr_array_new_with_free_func(g_free);
+    grecords = g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
+    rateRecords = g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
+    for (gint i = 0; i < nrecords; i++) {
+        GVariant *grecord;
+
+        grecord = virtDBusUtilTypedParamsToGVariant(records[i]->params,
+                                                    records[i]->nparams,
+                                                    NULL);
+        g_ptr_array_add(paths,
+                        virtDBusUtilBusPathForVirDomain(records[i]->dom,
+                                                        connect->domainPath));
+        g_ptr_array_add(grecords, g_variant_ref_sink(grecord));
+
+        if (rates) {
+            g_autoptr(GVariant) recordRates = NULL;
+
+            recordRates = virtDBusStatsGetRates(connect->statsCache, records[i]);
+            g_ptr_array_add(rateRecords,
+                            virtDBusSamplerWithRates(grecord, recordRates));
+        }
+    }
+
+    g_mutex_lock(&sampler->lock);
+    g_hash_table_iter_init(&iter, sampler->subscriptions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sub)) {
+        GPtrArray *subRecords = grecords;
+        GVariant *delta;
+
+        if ((sub->flags & ~VIRT_DBUS_STATS_FLAGS) != flags ||
+            !virtDBusSamplerIsDue(sampler, sub, now)) {
+            continue;
+        }
+
+        sub->due += sub->interval;
+        if (sub->due <= now)
+            sub->due = now + sub->interval;
+
+        if (sub->flags & VIRT_DBUS_STATS_RATES)
+            subRecords = rateRecords;
+
+        switch (sub->kind) {
+        case VIRT_DBUS_SAMPLER_HISTORY:
+            for (gint i = 0; i < nrecords; i++) {
+                virtDBusHistoryAddTypedParams(connect->statsHistory,
+                                              g_ptr_array_index(paths, i),
+                                              timestamp,
+                                              records[i]->params,
+                                              records[i]->nparams);
+            }
+            break;
+
+        case VIRT_DBUS_SAMPLER_STATS_FILE:
+            /* Domains which do not fit are left out until it can grow. */
+            virtDBusStatsFileUpdate(connect->statsFile, connect->statsCache,
+                                    records, nrecords, g_get_real_time(),
+                                    NULL);
+            break;
+
+        case VIRT_DBUS_SAMPLER_THRESHOLDS:
+            for (guint i = 0; i < paths->len; i++) {
+                virtDBusThresholdsEvaluate(sampler->thresholds,
+                                           g_ptr_array_index(paths, i),
+                                           g_ptr_array_index(subRecords, i),
+                                           now,
+                                           virtDBusSamplerThresholdCrossed,
+                                           connect);
+            }
+            /* Fields missing for a minute belong to domains which are
+             * gone or were hot-unplugged. */
+            virtDBusThresholdsPrune(sampler->thresholds,
+                                    now - 60 * G_USEC_PER_SEC);
+            break;
+
+        case VIRT_DBUS_SAMPLER_CLIENT:
+            delta = virtDBusSamplerDelta(sub, paths, subRecords);
+            if (!delta)
+                break;
+
+            g_dbus_connection_emit_signal(connect->bus,
+                                          sub->sender,
+                                          connect->connectPath,
+                                          VIRT_DBUS_CONNECT_INTERFACE,
+                                          "DomainStatsChanged",
+                                          g_variant_new("(u@a(oa{sv}))",
+                                                        sub->id, delta),
+                                          NULL);
+            break;
+        }
+    }
+    g_mutex_unlock(&sampler->lock);
+}
+
+static void
+virtDBusSamplerThread(gpointer data G_GNUC_UNUSED,
+                      gpointer userData)
+{
+    virtDBusSampler *sampler = userData;
+    g_autoptr(GArray) flagsList = g_array_new(FALSE, FALSE, sizeof(guint));
+    gint64 now = g_get_monotonic_time();
+    GHashTableIter iter;
+    virtDBusSamplerSubscription *sub;
+
+    g_mutex_lock(&sampler->lock);
+    g_hash_table_iter_init(&iter, sampler->subscriptions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sub)) {
+        gboolean known = FALSE;
+        guint flags;
+
+        if (!virtDBusSamplerIsDue(sampler, sub, now))
+            continue;
+
+        flags = sub->flags & ~VIRT_DBUS_STATS_FLAGS;
+        for (guint i = 0; i < flagsList->len && !known; i++)
+            known = g_array_index(flagsList, guint, i) == flags;
+        if (!known)
+            g_array_append_val(flagsList, flags);
+    }
+    g_mutex_unlock(&sampler->lock);
+
+    /* Flags filter the list of domains so subscriptions with different
+     * flags cannot share one call.  Rates are derived by us and do not
+     * need a call of their own, stale samples are never used. */
+    for (guint i = 0; i < flagsList->len; i++)
+        virtDBusSamplerCollect(sampler, g_array_index(flagsList, guint, i), now);
+
+    g_mutex_lock(&sampler->lock);
+    sampler->sampling = FALSE;
+    g_mutex_unlock(&sampler->lock);
+}
+
+/*
+ * Threshold rules are evaluated by a subscription which exists only while
+ * there are rules and asks libvirt just for the stats groups their
+ * metrics belong to.  Has to be called with the sampler lock held.
+ */
+static void
+virtDBusSamplerUpdateThresholds(virtDBusSampler *sampler)
+{
+    g_auto(GStrv) metrics = NULL;
+    virtDBusSamplerSubscription *sub;
+
+    sub = g_hash_table_lookup(sampler->subscriptions,
+                              GUINT_TO_POINTER(VIRT_DBUS_SAMPLER_THRESHOLDS_ID));
+
+    if (virtDBusThresholdsCount(sampler->thresholds) == 0) {
+        if (sub) {
+            g_hash_table_remove(sampler->subscriptions,
+                                GUINT_TO_POINTER(VIRT_DBUS_SAMPLER_THRESHOLDS_ID));
+        }
+        virtDBusSamplerReschedule(sampler);
+        return;
+    }
+
+    if (!sub) {
+        sub = virtDBusSamplerAddSubscription(sampler,
+                                             VIRT_DBUS_SAMPLER_THRESHOLDS_ID,
+                                             VIRT_DBUS_SAMPLER_THRESHOLDS,
+                                             NULL, 0,
+                                             VIRT_DBUS_SAMPLER_THRESHOLDS_INTERVAL,
+                                             VIRT_DBUS_STATS_RATES);
+    }
+
+    metrics = virtDBusThresholdsGetMetrics(sampler->thresholds);
+    sub->stats = virtDBusStatsGroupsForFields((const gchar *const *)metrics);
+
+    virtDBusSamplerReschedule(sampler);
+}
+
+static void
+virtDBusSamplerNameOwnerChanged(GDBusConnection *bus G_GNUC_UNUSED,
+                                const gchar *senderName G_GNUC_UNUSED,
+                                const gchar *objectPath G_GNUC_UNUSED,
+                                const gchar *interfaceName G_GNUC_UNUSED,
+                                const gchar *signalName G_GNUC_UNUSED,
+                                GVariant *parameters,
+                                gpointer userData)
+{
+    virtDBusSampler *sampler = userData;
+    virtDBusUtilAutoLock lock = NULL;
+    const gchar *name;
+    const gchar *newOwner;
+    GHashTableIter iter;
+    virtDBusSamplerSubscription *sub;
+
+    g_variant_get(parameters, "(&s&s&s)", &name, NULL, &newOwner);
+
+    /* Subscriptions of clients which left the bus are dropped. */
+    if (newOwner[0] != '\0')
+        return;
+
+    lock = g_mutex_locker_new(&sampler->lock);
+
+    g_hash_table_iter_init(&iter, sampler->subscriptions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sub)) {
+        if (g_strcmp0(sub->sender, name) == 0)
+            g_hash_table_iter_remove(&iter);
+    }
+
+    virtDBusThresholdsRemoveOwner(sampler->thresholds, name);
+
+    virtDBusSamplerUpdateThresholds(sampler);
+}
+
+/**
+ * virtDBusSamplerNew:
+ * @connect: connection whose domains are sampled
+ *
+ * Creates a sampler which collects stats of all domains of @connect on
+ * behalf of subscribed clients, see virtDBusSamplerSubscribe(), for
+ * threshold rules, see virtDBusSamplerAddThresholdRule(), and for the
+ * stats history and the stats file of @connect if they are enabled.  Has to be called from
+ * the main loop thread.
+ */
+virtDBusSampler *
+virtDBusSamplerNew(virtDBusConnect *connect)
+{
+    virtDBusSampler *sampler = g_new0(virtDBusSampler, 1);
+
+    sampler->connect = connect;
+    g_mutex_init(&sampler->lock);
+    sampler->subscriptions = g_hash_table_new_full(g_direct_hash,
+                                                   g_direct_equal,
+                                                   NULL,
+                                                   virtDBusSamplerSubscriptionFree);
+    sampler->pool = g_thread_pool_new(virtDBusSamplerThread, sampler,
+                                      1, FALSE, NULL);
+    sampler->thresholds = virtDBusThresholdsNew();
+    sampler->nameOwnerChangedId =
+        g_dbus_connection_signal_subscribe(connect->bus,
+                                           "org.freedesktop.DBus",
+                                           "org.freedesktop.DBus",
+                                           "NameOwnerChanged",
+                                           "/org/freedesktop/DBus",
+                                           NULL,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           virtDBusSamplerNameOwnerChanged,
+                                           sampler,
+                                           NULL);
+
+    if (connect->statsHistory) {
+        virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+        const gchar *const *fields = virtDBusHistoryGetFields(connect->statsHistory);
+
+        virtDBusSamplerAddSubscription(sampler,
+                                       VIRT_DBUS_SAMPLER_HISTORY_ID,
+                                       VIRT_DBUS_SAMPLER_HISTORY,
+                                       NULL,
+                                       virtDBusStatsGroupsForFields(fields),
+                                       VIRT_DBUS_SAMPLER_HISTORY_INTERVAL,
+                                       0);
+
+        virtDBusSamplerReschedule(sampler);
+    }
+
+    if (connect->statsFile) {
+        virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+        const gchar *const *fields = virtDBusStatsFileGetFields(connect->statsFile);
+
+        virtDBusSamplerAddSubscription(sampler,
+                                       VIRT_DBUS_SAMPLER_STATS_FILE_ID,
+                                       VIRT_DBUS_SAMPLER_STATS_FILE,
+                                       NULL,
+                                       virtDBusStatsGroupsForFields(fields),
+                                       virtDBusStatsFileGetInterval(connect->statsFile),
+                                       0);
+
+        virtDBusSamplerReschedule(sampler);
+    }
+
+    return sampler;
+}
+
+void
+virtDBusSamplerFree(virtDBusSampler *sampler)
+{
+    g_dbus_connection_signal_unsubscribe(sampler->connect->bus,
+                                         sampler->nameOwnerChangedId);
+
+    if (sampler->timer) {
+        g_source_destroy(sampler->timer);
+        g_source_unref(sampler->timer);
+    }
+
+    if (sampler->pool)
+        g_thread_pool_free(sampler->pool, TRUE, TRUE);
+
+    g_hash_table_unref(sampler->subscriptions);
+    virtDBusThresholdsFree(sampler->thresholds);
+    g_mutex_clear(&sampler->lock);
+    g_free(sampler);
+}
+
+/**
+ * virtDBusSamplerSubscribe:
+ * @sampler: sampler of the connection
+ * @sender: unique bus name of the subscribing client
+ * @stats: stats groups as passed to virConnectGetAllDomainStats
+ * @interval: sampling interval in milliseconds
+ * @flags: flags as passed to virConnectGetAllDomainStats
+ * @error: return location for error
+ *
+ * Starts sending DomainStatsChanged signals to @sender every @interval
+ * with the fields of @stats groups which changed since the previous
+ * signal.  The first signal carries all fields.  Subscriptions with equal
+ * @flags share one libvirt call per tick.
+ *
+ * Returns ID of the subscription or 0 on error.
+ */
+guint
+virtDBusSamplerSubscribe(virtDBusSampler *sampler,
+                         const gchar *sender,
+                         guint stats,
+                         guint interval,
+                         guint flags,
+                         GError **error)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+    virtDBusSamplerSubscription *sub;
+
+    if (!sender) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                    "stats subscriptions require a direct method call");
+        return 0;
+    }
+
+    if (interval < VIRT_DBUS_SAMPLER_MIN_INTERVAL) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "sampling interval must be at least %d ms",
+                    VIRT_DBUS_SAMPLER_MIN_INTERVAL);
+        return 0;
+    }
+
+    if (virtDBusSamplerCountSubscriptions(sampler, sender) >= VIRT_DBUS_SAMPLER_MAX_SUBSCRIPTIONS) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                    "too many stats subscriptions");
+        return 0;
+    }
+
+    /* The number of subscriptions is limited only per client so the IDs
+     * may wrap around to ones still in use. */
+    do {
+        if (++sampler->nextId >= VIRT_DBUS_SAMPLER_STATS_FILE_ID)
+            sampler->nextId = VIRT_DBUS_SAMPLER_HISTORY_ID + 1;
+    } while (g_hash_table_contains(sampler->subscriptions,
+                                   GUINT_TO_POINTER(sampler->nextId)));
+
+    sub = virtDBusSamplerAddSubscription(sampler, sampler->nextId,
+                                         VIRT_DBUS_SAMPLER_CLIENT, sender,
+                                         stats, interval, flags);
+
+    virtDBusSamplerReschedule(sampler);
+
+    return sub->id;
+}
+
+/**
+ * virtDBusSamplerUnsubscribe:
+ * @sampler: sampler of the connection
+ * @sender: unique bus name of the client
+ * @id: ID returned by virtDBusSamplerSubscribe()
+ * @error: return location for error
+ *
+ * Stops sending stats to @sender.  Clients may cancel only their own
+ * subscriptions.
+ */
+gboolean
+virtDBusSamplerUnsubscribe(virtDBusSampler *sampler,
+                           const gchar *sender,
+                           guint id,
+                           GError **error)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+    virtDBusSamplerSubscription *sub;
+
+    sub = g_hash_table_lookup(sampler->subscriptions, GUINT_TO_POINTER(id));
+    if (!sub || sub->kind != VIRT_DBUS_SAMPLER_CLIENT ||
+        g_strcmp0(sub->sender, sender) != 0) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "no stats subscription with ID %u", id);
+        return FALSE;
+    }
+
+    g_hash_table_remove(sampler->subscriptions, GUINT_TO_POINTER(id));
+
+    virtDBusSamplerReschedule(sampler);
+
+    return TRUE;
+}
+
+/**
+ * virtDBusSamplerAddThresholdRule:
+ * @sampler: sampler of the connection
+ * @sender: unique bus name of the client adding the rule
+ * @metric: pattern of checked stats fields, rates included
+ * @comparison: one of "<", "<=", ">", ">=", "==" or "!="
+ * @threshold: value the fields are compared with
+ * @hold: time in milliseconds the comparison has to hold
+ * @error: return location for error
+ *
+ * Starts evaluating the rule on every sample of all domains.  The
+ * ThresholdCrossed signal is emitted on the domain object when a field
+ * crosses the threshold and again when it returns.  The rule ends with
+ * virtDBusSamplerRemoveThresholdRule() or when @sender leaves the bus.
+ *
+ * Returns ID of the rule or 0 on error.
+ */
+guint
+virtDBusSamplerAddThresholdRule(virtDBusSampler *sampler,
+                                const gchar *sender,
+                                const gchar *metric,
+                                const gchar *comparison,
+                                gdouble threshold,
+                                guint hold,
+                                GError **error)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+    guint id;
+
+    if (!sender) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                    "threshold rules require a direct method call");
+        return 0;
+    }
+
+    id = virtDBusThresholdsAdd(sampler->thresholds, sender, metric,
+                               comparison, threshold, hold, error);
+    if (id == 0)
+        return 0;
+
+    virtDBusSamplerUpdateThresholds(sampler);
+
+    return id;
+}
+
+gboolean
+virtDBusSamplerRemoveThresholdRule(virtDBusSampler *sampler,
+                                   const gchar *sender,
+                                   guint id,
+                                   GError **error)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&sampler->lock);
+
+    if (!virtDBusThresholdsRemove(sampler->thresholds, sender, id, error))
+        return FALSE;
+
+    virtDBusSamplerUpdateThresholds(sampler);
+
+    return TRUE;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "gdbus.h"
+
+struct virtDBusConnect;
+
+typedef struct _virtDBusSampler virtDBusSampler;
+
+virtDBusSampler *
+virtDBusSamplerNew(struct virtDBusConnect *connect);
+
+void
+virtDBusSamplerFree(virtDBusSampler *sampler);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusSampler, virtDBusSamplerFree);
+
+guint
+virtDBusSamplerSubscribe(virtDBusSampler *sampler,
+                         const gchar *sender,
+                         guint stats,
+                         guint interval,
+                         guint flags,
+                         GError **error);
+
+gboolean
+virtDBusSamplerUnsubscribe(virtDBusSampler *sampler,
+                           const gchar *sender,
+                           guint id,
+                           GError **error);
+
+guint
+virtDBusSamplerAddThresholdRule(virtDBusSampler *sampler,
+                                const gchar *sender,
+                                const gchar *metric,
+                                const gchar *comparison,
+                                gdouble threshold,
+                                guint hold,
+                                GError **error);
+
+gboolean
+virtDBusSamplerRemoveThresholdRule(virtDBusSampler *sampler,
+                                   const gchar *sender,
+                                   guint id,
+                                   GError **error);
@@ -9,10 +9,16 @@ virtDBusSecretGetVirSecret(virtDBusConnect *connect,
                            GError **error)
 {
     virSecretPtr secret;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    secret = virtDBusUtilHandleCacheLookup(connect->secretCache, objectPath,
+                                           connect->connection, &generation);
+    if (secret)
+        return secret;
+
     secret = virtDBusUtilVirSecretFromBusPath(connect->connection,
                                               objectPath,
                                               connect->secretPath);
@@ -21,6 +27,9 @@ virtDBusSecretGetVirSecret(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->secretCache, objectPath,
+                                  connect->connection, secret, generation);
+
     return secret;
 }
 
@@ -31,16 +40,11 @@ virtDBusSecretGetUUID(const gchar *objectPath,
                       GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virSecret) secret = NULL;
     gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
 
-    secret = virtDBusSecretGetVirSecret(connect, objectPath, error);
-    if (!secret)
+    if (!virtDBusUtilUUIDFromBusPath(objectPath, connect->secretPath, uuid, error))
         return;
 
-    if (virSecretGetUUIDString(secret, uuid) < 0)
-        return virtDBusUtilSetLastVirtError(error);
-
     *value = g_variant_new("s", uuid);
 }
 
@@ -203,17 +207,17 @@ virtDBusSecretUndefine(GVariant *inArgs G_GNUC_UNUSED,
 }
 
 static virtDBusGDBusPropertyTable virtDBusSecretPropertyTable[] = {
-    { "UUID", virtDBusSecretGetUUID, NULL },
-    { "UsageID", virtDBusSecretGetUsageID, NULL },
-    { "UsageType", virtDBusSecretGetUsageType, NULL },
+    { "UUID", virtDBusSecretGetUUID, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
+    { "UsageID", virtDBusSecretGetUsageID, NULL, 0, 0 },
+    { "UsageType", virtDBusSecretGetUsageType, NULL, 0, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusSecretMethodTable[] = {
-    { "GetXMLDesc", virtDBusSecretGetXMLDesc },
-    { "Undefine", virtDBusSecretUndefine },
-    { "GetValue", virtDBusSecretGetValue },
-    { "SetValue", virtDBusSecretSetValue },
+    { "GetXMLDesc", virtDBusSecretGetXMLDesc, 0 },
+    { "Undefine", virtDBusSecretUndefine, 0 },
+    { "GetValue", virtDBusSecretGetValue, 0 },
+    { "SetValue", virtDBusSecretSetValue, 0 },
     { 0 }
 };
 
@@ -245,6 +249,19 @@ virtDBusSecretEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusSecretExists(const gchar *objectPath,
+                     gpointer userData,
+                     GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virSecret) secret = NULL;
+
+    secret = virtDBusSecretGetVirSecret(connect, objectPath, error);
+
+    return !!secret;
+}
+
 static GDBusInterfaceInfo *interfaceInfo;
 
 void
@@ -264,7 +281,10 @@ virtDBusSecretRegister(virtDBusConnect *connect,
                                  connect->secretPath,
                                  interfaceInfo,
                                  virtDBusSecretEnumerate,
+                                 virtDBusSecretExists,
                                  virtDBusSecretMethodTable,
                                  virtDBusSecretPropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
@@ -0,0 +1,1027 @@
+#include "stats.h"
+
+#if LIBVIR_VERSION_NUMBER < 4005000
+# define VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT (1 << 29)
+#endif
+
+/* Flags of virConnectGetAllDomainStats which change the content of the
+ * records, the remaining ones only filter the list of domains. */
+#define VIRT_DBUS_STATS_RECORD_FLAGS \
+    (VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS)
+
+/* Number of threads collecting complete samples of busy domains.  They
+ * block until the job of the domain finishes or libvirt gives up. */
+#define VIRT_DBUS_STATS_REFRESH_THREADS 2
+
+/* Rates are derived from counter samples at least this far apart, in
+ * microseconds, and shared by all consumers in between so that clients
+ * asking shortly after each other do not get noise from tiny intervals. */
+#define VIRT_DBUS_STATS_RATE_MIN_INTERVAL (1 * G_USEC_PER_SEC)
+
+/* Counter samples of domains nobody asked rates for are dropped after
+ * this time in microseconds. */
+#define VIRT_DBUS_STATS_RATE_MAX_AGE (10 * 60 * G_USEC_PER_SEC)
+
+#define VIRT_DBUS_STATS_CPU_TIME "cpu.time"
+#define VIRT_DBUS_STATS_CPU_UTILIZATION "cpu.utilization"
+
+/* Counters whose per-second rates are reported as "<counter>.rate". */
+static const gchar *const virtDBusStatsRateCounters[] = {
+    "block.*.rd.reqs",
+    "block.*.rd.bytes",
+    "block.*.wr.reqs",
+    "block.*.wr.bytes",
+    "block.*.fl.reqs",
+    "net.*.rx.bytes",
+    "net.*.rx.pkts",
+    "net.*.tx.bytes",
+    "net.*.tx.pkts",
+    NULL
+};
+
+struct _virtDBusStatsGroup {
+    guint stats;
+    const gchar *prefix;
+};
+typedef struct _virtDBusStatsGroup virtDBusStatsGroup;
+
+/* Prefixes of the fields reported for every stats group. */
+static const virtDBusStatsGroup virtDBusStatsGroups[] = {
+    { VIR_DOMAIN_STATS_STATE, "state." },
+    { VIR_DOMAIN_STATS_CPU_TOTAL, "cpu." },
+    { VIR_DOMAIN_STATS_BALLOON, "balloon." },
+    { VIR_DOMAIN_STATS_VCPU, "vcpu." },
+    { VIR_DOMAIN_STATS_INTERFACE, "net." },
+    { VIR_DOMAIN_STATS_BLOCK, "block." },
+    { VIR_DOMAIN_STATS_PERF, "perf." },
+#if LIBVIR_VERSION_NUMBER >= 4010000
+    { VIR_DOMAIN_STATS_IOTHREAD, "iothread." },
+#endif
+#if LIBVIR_VERSION_NUMBER >= 6000000
+    { VIR_DOMAIN_STATS_MEMORY, "memory." },
+#endif
+#if LIBVIR_VERSION_NUMBER >= 7002000
+    { VIR_DOMAIN_STATS_DIRTYRATE, "dirtyrate." },
+#endif
+#if LIBVIR_VERSION_NUMBER >= 8009000
+    { VIR_DOMAIN_STATS_VM, "vm." },
+#endif
+};
+
+struct _virtDBusStatsSample {
+    GVariant *record;
+    gint64 timestamp;
+};
+typedef struct _virtDBusStatsSample virtDBusStatsSample;
+
+/* Records may carry only some counters, for example when a busy domain
+ * reports CPU stats but not block stats, so every counter keeps the time
+ * of its own last sample and its last derived rate. */
+struct _virtDBusStatsCounter {
+    guint64 value;
+    guint bits;
+    gint64 timestamp;
+    gdouble rate;
+    gboolean hasRate;
+};
+typedef struct _virtDBusStatsCounter virtDBusStatsCounter;
+
+struct _virtDBusStatsCounters {
+    guint domainId;
+    gint64 timestamp;
+    GHashTable *values;
+    GVariant *rates;
+};
+typedef struct _virtDBusStatsCounters virtDBusStatsCounters;
+
+struct _virtDBusStatsCache {
+    GMutex lock;
+    GHashTable *samples;
+    GHashTable *pending;
+    GThreadPool *refreshPool;
+    guint generation;
+    gint64 pruneTimestamp;
+    GHashTable *counters;
+    gint64 countersPruneTimestamp;
+};
+
+struct _virtDBusStatsRefresh {
+    virDomainPtr domain;
+    guint stats;
+    guint flags;
+    gchar **fields;
+    gchar *key;
+    guint generation;
+};
+typedef struct _virtDBusStatsRefresh virtDBusStatsRefresh;
+
+/* Maximum age of the last complete sample of a domain which may still be
+ * used in place of stats unavailable because the domain is busy, in
+ * microseconds.  0 disables VIRT_DBUS_STATS_STALE. */
+static gint64 statsMaxStaleness =
+    VIRT_DBUS_STATS_DEFAULT_MAX_STALENESS * G_USEC_PER_SEC;
+
+/**
+ * virtDBusStatsSetMaxStaleness:
+ * @maxStaleness: maximum age of reused samples in microseconds
+ *
+ * Bounds the age of the samples filling in stats of busy domains for
+ * callers passing VIRT_DBUS_STATS_STALE.  The flag is ignored if
+ * @maxStaleness is 0.
+ *
+ * Has to be called before any stats are collected.
+ */
+void
+virtDBusStatsSetMaxStaleness(gint64 maxStaleness)
+{
+    statsMaxStaleness = maxStaleness;
+}
+
+/**
+ * virtDBusStatsFieldInGroups:
+ * @field: name of a stats field
+ * @stats: stats groups as passed to virConnectGetAllDomainStats
+ *
+ * Checks whether @field belongs to one of the @stats groups so that
+ * fields of a record collected for a superset of groups can be split
+ * between several requesters.  0 stands for all groups and fields of
+ * groups unknown to us are accepted if @stats asks for an unknown group.
+ */
+gboolean
+virtDBusStatsFieldInGroups(const gchar *field,
+                           guint stats)
+{
+    guint known = 0;
+
+    if (stats == 0)
+        return TRUE;
+
+    for (gsize i = 0; i < G_N_ELEMENTS(virtDBusStatsGroups); i++) {
+        if (g_str_has_prefix(field, virtDBusStatsGroups[i].prefix))
+            return (stats & virtDBusStatsGroups[i].stats) != 0;
+        known |= virtDBusStatsGroups[i].stats;
+    }
+
+    return (stats & ~known) != 0;
+}
+
+/**
+ * virtDBusStatsGroupsForFields:
+ * @fields: NULL-terminated list of patterns of fields, see
+ *   virtDBusUtilFieldMatches()
+ *
+ * Returns stats groups reporting the fields matching @fields, 0 standing
+ * for all groups if some pattern does not start with a known prefix.
+ */
+guint
+virtDBusStatsGroupsForFields(const gchar *const *fields)
+{
+    guint stats = 0;
+
+    if (!fields || !fields[0])
+        return 0;
+
+    for (gint i = 0; fields[i]; i++) {
+        guint group = 0;
+
+        for (gsize j = 0; j < G_N_ELEMENTS(virtDBusStatsGroups); j++) {
+            if (g_str_has_prefix(fields[i], virtDBusStatsGroups[j].prefix)) {
+                group = virtDBusStatsGroups[j].stats;
+                break;
+            }
+        }
+
+        if (group == 0)
+            return 0;
+
+        stats |= group;
+    }
+
+    return stats;
+}
+
+static void
+virtDBusStatsSampleFree(gpointer opaque)
+{
+    virtDBusStatsSample *sample = opaque;
+
+    g_variant_unref(sample->record);
+    g_free(sample);
+}
+
+static void
+virtDBusStatsCountersFree(gpointer opaque)
+{
+    virtDBusStatsCounters *counters = opaque;
+
+    g_hash_table_unref(counters->values);
+    if (counters->rates)
+        g_variant_unref(counters->rates);
+    g_free(counters);
+}
+
+static void
+virtDBusStatsRefreshFree(virtDBusStatsRefresh *refresh)
+{
+    virDomainFree(refresh->domain);
+    g_strfreev(refresh->fields);
+    g_free(refresh->key);
+    g_free(refresh);
+}
+
+/* Samples differ by the requested stats groups, the flags changing the
+ * content and the field projection. */
+static gchar *
+virtDBusStatsKey(virDomainPtr domain,
+                 guint stats,
+                 guint flags,
+                 const gchar *const *fields)
+{
+    gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
+    g_autofree gchar *projection = NULL;
+
+    virDomainGetUUIDString(domain, uuid);
+
+    if (fields)
+        projection = g_strjoinv(" ", (gchar **)fields);
+
+    return g_strdup_printf("%s %x %x %s", uuid, stats,
+                           flags & VIRT_DBUS_STATS_RECORD_FLAGS,
+                           projection ? projection : "");
+}
+
+static void
+virtDBusStatsStore(virtDBusStatsCache *cache,
+                   const gchar *key,
+                   GVariant *record,
+                   guint generation)
+{
+    virtDBusStatsSample *sample;
+    gint64 now = g_get_monotonic_time();
+    GHashTableIter iter;
+
+    if (generation != cache->generation)
+        return;
+
+    /* Samples of deleted domains are never looked up again so expired
+     * samples are dropped every now and then. */
+    if (now - cache->pruneTimestamp > statsMaxStaleness) {
+        g_hash_table_iter_init(&iter, cache->samples);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&sample)) {
+            if (now - sample->timestamp > statsMaxStaleness)
+                g_hash_table_iter_remove(&iter);
+        }
+        cache->pruneTimestamp = now;
+    }
+
+    sample = g_new0(virtDBusStatsSample, 1);
+    sample->record = g_variant_ref_sink(record);
+    sample->timestamp = now;
+    g_hash_table_replace(cache->samples, g_strdup(key), sample);
+}
+
+static void
+virtDBusStatsRefreshThread(gpointer data,
+                           gpointer userData)
+{
+    virtDBusStatsRefresh *refresh = data;
+    virtDBusStatsCache *cache = userData;
+    virDomainPtr domains[] = { refresh->domain, NULL };
+    g_autoptr(virDomainStatsRecordPtr) records = NULL;
+    GVariant *record = NULL;
+
+    if (virDomainListGetStats(domains, refresh->stats, &records,
+                              refresh->flags) == 1) {
+        record = virtDBusUtilTypedParamsToGVariant(records[0]->params,
+                                                   records[0]->nparams,
+                                                   (const gchar *const *)refresh->fields);
+    }
+
+    g_mutex_lock(&cache->lock);
+    if (record)
+        virtDBusStatsStore(cache, refresh->key, record, refresh->generation);
+    g_hash_table_remove(cache->pending, refresh->key);
+    g_mutex_unlock(&cache->lock);
+
+    virtDBusStatsRefreshFree(refresh);
+}
+
+virtDBusStatsCache *
+virtDBusStatsCacheNew(void)
+{
+    virtDBusStatsCache *cache = g_new0(virtDBusStatsCache, 1);
+
+    g_mutex_init(&cache->lock);
+    cache->samples = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, virtDBusStatsSampleFree);
+    cache->pending = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, NULL);
+    cache->counters = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            g_free, virtDBusStatsCountersFree);
+
+    return cache;
+}
+
+void
+virtDBusStatsCacheFree(virtDBusStatsCache *cache)
+{
+    if (cache->refreshPool)
+        g_thread_pool_free(cache->refreshPool, TRUE, TRUE);
+    g_hash_table_unref(cache->samples);
+    g_hash_table_unref(cache->pending);
+    g_hash_table_unref(cache->counters);
+    g_mutex_clear(&cache->lock);
+    g_free(cache);
+}
+
+void
+virtDBusStatsCacheClear(virtDBusStatsCache *cache)
+{
+    g_mutex_lock(&cache->lock);
+    g_hash_table_remove_all(cache->samples);
+    g_hash_table_remove_all(cache->counters);
+    cache->generation++;
+    g_mutex_unlock(&cache->lock);
+}
+
+/* Has to be called with the cache lock held. */
+static void
+virtDBusStatsScheduleRefresh(virtDBusStatsCache *cache,
+                             virDomainPtr domain,
+                             guint stats,
+                             guint flags,
+                             const gchar *const *fields,
+                             const gchar *key)
+{
+    virtDBusStatsRefresh *refresh;
+
+    if (g_hash_table_contains(cache->pending, key))
+        return;
+
+    if (!cache->refreshPool) {
+        cache->refreshPool = g_thread_pool_new(virtDBusStatsRefreshThread,
+                                               cache,
+                                               VIRT_DBUS_STATS_REFRESH_THREADS,
+                                               FALSE, NULL);
+        if (!cache->refreshPool)
+            return;
+    }
+
+    refresh = g_new0(virtDBusStatsRefresh, 1);
+    refresh->domain = domain;
+    virDomainRef(domain);
+    refresh->stats = stats;
+    refresh->flags = flags & VIRT_DBUS_STATS_RECORD_FLAGS;
+    refresh->fields = g_strdupv((gchar **)fields);
+    refresh->key = g_strdup(key);
+    refresh->generation = cache->generation;
+
+    g_hash_table_add(cache->pending, g_strdup(key));
+    g_thread_pool_push(cache->refreshPool, refresh, NULL);
+}
+
+static gboolean
+virtDBusStatsUseStale(guint flags)
+{
+    return (flags & VIRT_DBUS_STATS_STALE) && statsMaxStaleness > 0;
+}
+
+static gboolean
+virtDBusStatsNoWaitUnsupported(void)
+{
+    virErrorPtr err = virGetLastError();
+
+    return err && err->code == VIR_ERR_INVALID_ARG;
+}
+
+/**
+ * virtDBusStatsGetAllDomainStats:
+ *
+ * Wrapper of virConnectGetAllDomainStats() which does not wait for
+ * domain jobs if VIRT_DBUS_STATS_STALE is in @flags.
+ */
+gint
+virtDBusStatsGetAllDomainStats(virConnectPtr connection,
+                               guint stats,
+                               virDomainStatsRecordPtr **records,
+                               guint flags)
+{
+    gboolean stale = virtDBusStatsUseStale(flags);
+    gint ret;
+
+    flags &= ~VIRT_DBUS_STATS_FLAGS;
+
+    if (!stale)
+        return virConnectGetAllDomainStats(connection, stats, records, flags);
+
+    ret = virConnectGetAllDomainStats(connection, stats, records,
+                                      flags | VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT);
+    if (ret < 0 && virtDBusStatsNoWaitUnsupported())
+        ret = virConnectGetAllDomainStats(connection, stats, records, flags);
+
+    return ret;
+}
+
+/**
+ * virtDBusStatsListGetStats:
+ *
+ * Wrapper of virDomainListGetStats() which does not wait for domain jobs
+ * if VIRT_DBUS_STATS_STALE is in @flags.
+ */
+gint
+virtDBusStatsListGetStats(virDomainPtr *domains,
+                          guint stats,
+                          virDomainStatsRecordPtr **records,
+                          guint flags)
+{
+    gboolean stale = virtDBusStatsUseStale(flags);
+    gint ret;
+
+    flags &= ~VIRT_DBUS_STATS_FLAGS;
+
+    if (!stale)
+        return virDomainListGetStats(domains, stats, records, flags);
+
+    ret = virDomainListGetStats(domains, stats, records,
+                                flags | VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT);
+    if (ret < 0 && virtDBusStatsNoWaitUnsupported())
+        ret = virDomainListGetStats(domains, stats, records, flags);
+
+    return ret;
+}
+
+/*
+ * Values of the sample which are missing in the fresh record are appended
+ * to it.  Returns the number of such values.
+ */
+static guint
+virtDBusStatsMerge(GVariantBuilder *builder,
+                   GVariant *fresh,
+                   GVariant *sample)
+{
+    g_autoptr(GHashTable) keys = g_hash_table_new(g_str_hash, g_str_equal);
+    GVariantIter iter;
+    const gchar *name;
+    GVariant *value;
+    guint nmissing = 0;
+
+    g_variant_iter_init(&iter, fresh);
+    while (g_variant_iter_loop(&iter, "{&sv}", &name, &value)) {
+        g_hash_table_add(keys, (gpointer)name);
+        g_variant_builder_add(builder, "{sv}", name, value);
+    }
+
+    if (!sample)
+        return 0;
+
+    g_variant_iter_init(&iter, sample);
+    while (g_variant_iter_loop(&iter, "{&sv}", &name, &value)) {
+        if (g_hash_table_contains(keys, name))
+            continue;
+        g_variant_builder_add(builder, "{sv}", name, value);
+        nmissing++;
+    }
+
+    return nmissing;
+}
+
+/**
+ * virtDBusStatsCounterDelta:
+ * @prev: previous value of a counter
+ * @cur: current value of the counter
+ * @bits: width of the counter, 32 or 64
+ * @delta: return location for the increase of the counter
+ *
+ * Computes the increase of a counter between two samples.  32-bit
+ * counters wrap around, a 64-bit counter cannot wrap in practice so if it
+ * went backwards it was reset, for example because a device was detached
+ * and attached again.
+ *
+ * Returns FALSE if the increase is unknown because of a reset.
+ */
+gboolean
+virtDBusStatsCounterDelta(guint64 prev,
+                          guint64 cur,
+                          guint bits,
+                          guint64 *delta)
+{
+    if (cur >= prev) {
+        *delta = cur - prev;
+        return TRUE;
+    }
+
+    if (bits == 32 && prev <= G_MAXUINT32) {
+        *delta = (guint64)G_MAXUINT32 - prev + cur + 1;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+virtDBusStatsIsRateCounter(const gchar *field)
+{
+    if (g_str_equal(field, VIRT_DBUS_STATS_CPU_TIME))
+        return TRUE;
+
+    for (gint i = 0; virtDBusStatsRateCounters[i]; i++) {
+        if (virtDBusUtilFieldMatches(virtDBusStatsRateCounters[i], field))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+virtDBusStatsParamCounter(virTypedParameterPtr param,
+                          virtDBusStatsCounter *counter)
+{
+    if (!virtDBusStatsIsRateCounter(param->field))
+        return FALSE;
+
+    if (param->type == VIR_TYPED_PARAM_UINT) {
+        counter->value = param->value.ui;
+        counter->bits = 32;
+    } else if (param->type == VIR_TYPED_PARAM_ULLONG) {
+        counter->value = param->value.ul;
+        counter->bits = 64;
+    } else if (param->type == VIR_TYPED_PARAM_LLONG && param->value.l >= 0) {
+        counter->value = param->value.l;
+        counter->bits = 64;
+    } else {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Updates the counter @name from the sample @cur taken at @now.  A new
+ * rate is derived only once the previous sample is old enough, in between
+ * the previous sample and rate are kept.  Returns TRUE if the rate
+ * changed.
+ */
+static gboolean
+virtDBusStatsUpdateCounter(GHashTable *values,
+                           const gchar *name,
+                           virtDBusStatsCounter *cur,
+                           gint64 now)
+{
+    virtDBusStatsCounter *prev = g_hash_table_lookup(values, name);
+    gdouble seconds;
+    guint64 delta;
+
+    if (!prev) {
+        prev = g_new0(virtDBusStatsCounter, 1);
+        prev->value = cur->value;
+        prev->bits = cur->bits;
+        prev->timestamp = now;
+        g_hash_table_insert(values, g_strdup(name), prev);
+        return FALSE;
+    }
+
+    if (now - prev->timestamp < VIRT_DBUS_STATS_RATE_MIN_INTERVAL)
+        return FALSE;
+
+    seconds = (gdouble)(now - prev->timestamp) / G_USEC_PER_SEC;
+
+    if (prev->bits == cur->bits &&
+        virtDBusStatsCounterDelta(prev->value, cur->value, cur->bits, &delta)) {
+        /* CPU time is in nanoseconds, the utilization is a percentage of
+         * one host CPU. */
+        if (g_str_equal(name, VIRT_DBUS_STATS_CPU_TIME))
+            prev->rate = (gdouble)delta / (seconds * 1e7);
+        else
+            prev->rate = (gdouble)delta / seconds;
+        prev->hasRate = TRUE;
+    } else {
+        prev->hasRate = FALSE;
+    }
+
+    prev->value = cur->value;
+    prev->bits = cur->bits;
+    prev->timestamp = now;
+
+    return TRUE;
+}
+
+/* Counters that were not sampled for a long time, typically of detached
+ * devices, are dropped together with their rates. */
+static GVariant *
+virtDBusStatsBuildRates(GHashTable *values,
+                        gint64 now)
+{
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    const gchar *name;
+    virtDBusStatsCounter *counter;
+    guint nrates = 0;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    g_hash_table_iter_init(&iter, values);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&name, (gpointer *)&counter)) {
+        g_autofree gchar *rateName = NULL;
+
+        if (now - counter->timestamp > VIRT_DBUS_STATS_RATE_MAX_AGE) {
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+
+        if (!counter->hasRate)
+            continue;
+
+        if (g_str_equal(name, VIRT_DBUS_STATS_CPU_TIME))
+            rateName = g_strdup(VIRT_DBUS_STATS_CPU_UTILIZATION);
+        else
+            rateName = g_strdup_printf("%s.rate", name);
+
+        g_variant_builder_add(&builder, "{sv}", rateName,
+                              g_variant_new_double(counter->rate));
+        nrates++;
+    }
+
+    if (nrates == 0) {
+        g_variant_builder_clear(&builder);
+        return NULL;
+    }
+
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/* Returns new reference to the selected rates or NULL if there are none. */
+static GVariant *
+virtDBusStatsProjectRates(GVariant *rates,
+                          const gchar *const *fields)
+{
+    GVariantBuilder builder;
+    GVariantIter iter;
+    const gchar *name;
+    GVariant *value;
+    guint nrates = 0;
+
+    if (!fields || !fields[0])
+        return g_variant_ref(rates);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    g_variant_iter_init(&iter, rates);
+    while (g_variant_iter_loop(&iter, "{&sv}", &name, &value)) {
+        if (!virtDBusUtilFieldSelected(fields, name))
+            continue;
+        g_variant_builder_add(&builder, "{sv}", name, value);
+        nrates++;
+    }
+
+    if (nrates == 0) {
+        g_variant_builder_clear(&builder);
+        return NULL;
+    }
+
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/**
+ * virtDBusStatsUpdateRates:
+ * @cache: stats cache of the connection
+ * @uuid: UUID of the domain
+ * @domainId: ID of the domain
+ * @params: stats of the domain
+ * @nparams: number of @params
+ * @now: monotonic time the stats were collected at
+ *
+ * Rates of the counters in @params are derived from the previous sample
+ * of each counter kept for the whole connection so that they are computed
+ * once for all consumers.  Counters missing from @params keep their last
+ * rate.  A restart of the domain changes its ID and starts over.
+ *
+ * Returns new reference to a{sv} dictionary of all known rates of the
+ * domain or NULL if none are known yet.
+ */
+GVariant *
+virtDBusStatsUpdateRates(virtDBusStatsCache *cache,
+                         const gchar *uuid,
+                         guint domainId,
+                         virTypedParameterPtr params,
+                         gint nparams,
+                         gint64 now)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    virtDBusStatsCounters *counters;
+    GHashTableIter iter;
+    gboolean changed = FALSE;
+
+    if (now - cache->countersPruneTimestamp > VIRT_DBUS_STATS_RATE_MAX_AGE) {
+        g_hash_table_iter_init(&iter, cache->counters);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&counters)) {
+            if (now - counters->timestamp > VIRT_DBUS_STATS_RATE_MAX_AGE)
+                g_hash_table_iter_remove(&iter);
+        }
+        cache->countersPruneTimestamp = now;
+    }
+
+    counters = g_hash_table_lookup(cache->counters, uuid);
+    if (!counters || counters->domainId != domainId) {
+        counters = g_new0(virtDBusStatsCounters, 1);
+        counters->domainId = domainId;
+        counters->values = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 g_free, g_free);
+        g_hash_table_replace(cache->counters, g_strdup(uuid), counters);
+    }
+
+    counters->timestamp = now;
+
+    for (gint i = 0; i < nparams; i++) {
+        virtDBusStatsCounter cur = { 0 };
+
+        if (!virtDBusStatsParamCounter(params + i, &cur))
+            continue;
+
+        if (virtDBusStatsUpdateCounter(counters->values, params[i].field,
+                                       &cur, now)) {
+            changed = TRUE;
+        }
+    }
+
+    if (changed) {
+        if (counters->rates)
+            g_variant_unref(counters->rates);
+        counters->rates = virtDBusStatsBuildRates(counters->values, now);
+    }
+
+    if (!counters->rates)
+        return NULL;
+
+    return g_variant_ref(counters->rates);
+}
+
+static GVariant *
+virtDBusStatsRates(virtDBusStatsCache *cache,
+                   virDomainStatsRecordPtr record,
+                   const gchar *const *fields)
+{
+    g_autoptr(GVariant) rates = NULL;
+    gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
+
+    virDomainGetUUIDString(record->dom, uuid);
+
+    rates = virtDBusStatsUpdateRates(cache, uuid, virDomainGetID(record->dom),
+                                     record->params, record->nparams,
+                                     g_get_monotonic_time());
+    if (!rates)
+        return NULL;
+
+    return virtDBusStatsProjectRates(rates, fields);
+}
+
+/**
+ * virtDBusStatsGetRates:
+ * @cache: stats cache of the connection
+ * @record: stats record returned by libvirt
+ *
+ * Returns new reference to a{sv} dictionary of the rates derived from
+ * @record as described in virtDBusStatsRecordToGVariant() or NULL if none
+ * are known yet.
+ */
+GVariant *
+virtDBusStatsGetRates(virtDBusStatsCache *cache,
+                      virDomainStatsRecordPtr record)
+{
+    return virtDBusStatsRates(cache, record, NULL);
+}
+
+/**
+ * virtDBusStatsRecordToGVariant:
+ * @cache: stats cache of the connection
+ * @record: stats record returned by libvirt
+ * @stats: stats groups which were requested
+ * @flags: flags of the stats method
+ * @fields: patterns of fields to return, see
+ *   virtDBusUtilTypedParamsToGVariant()
+ *
+ * Converts @record into a{sv} dictionary.
+ *
+ * With VIRT_DBUS_STATS_STALE in @flags the record is completed from the
+ * last sample of the domain if the domain was busy and the missing values
+ * are refreshed in background, otherwise the record becomes the last
+ * sample.  The record then gets a VIRT_DBUS_STATS_SAMPLE_AGE entry with
+ * the age of its oldest value in milliseconds.
+ *
+ * With VIRT_DBUS_STATS_RATES in @flags the record also gets per-second
+ * rates of block and interface counters named "<counter>.rate" and
+ * "cpu.utilization" with the CPU time used in percent of one host CPU,
+ * all of them doubles.  They are left out until the domain was sampled
+ * twice since it was started.
+ *
+ * Returns floating GVariant.
+ */
+GVariant *
+virtDBusStatsRecordToGVariant(virtDBusStatsCache *cache,
+                              virDomainStatsRecordPtr record,
+                              guint stats,
+                              guint flags,
+                              const gchar *const *fields)
+{
+    g_autoptr(GVariant) fresh = NULL;
+    g_autoptr(GVariant) rates = NULL;
+    g_autofree gchar *key = NULL;
+    virtDBusStatsSample *sample;
+    gboolean stale = virtDBusStatsUseStale(flags);
+    gint64 age = 0;
+    GVariantBuilder builder;
+
+    fresh = virtDBusUtilTypedParamsToGVariant(record->params, record->nparams,
+                                              fields);
+
+    if (flags & VIRT_DBUS_STATS_RATES)
+        rates = virtDBusStatsRates(cache, record, fields);
+
+    if (!stale && !rates)
+        return g_steal_pointer(&fresh);
+
+    g_variant_ref_sink(fresh);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    if (rates)
+        virtDBusStatsMerge(&builder, rates, NULL);
+
+    if (!stale) {
+        virtDBusStatsMerge(&builder, fresh, NULL);
+        return g_variant_builder_end(&builder);
+    }
+
+    key = virtDBusStatsKey(record->dom, stats, flags, fields);
+
+    g_mutex_lock(&cache->lock);
+
+    sample = g_hash_table_lookup(cache->samples, key);
+    if (sample) {
+        age = g_get_monotonic_time() - sample->timestamp;
+        if (age > statsMaxStaleness) {
+            g_hash_table_remove(cache->samples, key);
+            sample = NULL;
+        }
+    }
+
+    if (virtDBusStatsMerge(&builder, fresh, sample ? sample->record : NULL) > 0) {
+        virtDBusStatsScheduleRefresh(cache, record->dom, stats, flags,
+                                     fields, key);
+    } else {
+        virtDBusStatsStore(cache, key, fresh, cache->generation);
+        age = 0;
+    }
+
+    g_mutex_unlock(&cache->lock);
+
+    g_variant_builder_add(&builder, "{sv}", VIRT_DBUS_STATS_SAMPLE_AGE,
+                          g_variant_new_uint64(age / 1000));
+
+    return g_variant_builder_end(&builder);
+}
+
+/**
+ * virtDBusStatsMetricValue:
+ * @record: stats record returned by libvirt
+ * @rates: rates derived from @record, see virtDBusStatsGetRates(), or NULL
+ * @metric: pattern of summed fields, see virtDBusUtilFieldMatches()
+ * @value: return location for the sum
+ *
+ * Sums numeric fields of @record and @rates matching @metric, for example
+ * all disks of the domain for "block.*.wr.bytes".
+ *
+ * Returns FALSE if no field matches @metric.
+ */
+gboolean
+virtDBusStatsMetricValue(virDomainStatsRecordPtr record,
+                         GVariant *rates,
+                         const gchar *metric,
+                         gdouble *value)
+{
+    GVariantIter iter;
+    const gchar *name;
+    GVariant *rate;
+    gboolean found = FALSE;
+
+    *value = 0;
+
+    for (gint i = 0; i < record->nparams; i++) {
+        virTypedParameterPtr param = record->params + i;
+
+        if (!virtDBusUtilFieldMatches(metric, param->field))
+            continue;
+
+        switch (param->type) {
+        case VIR_TYPED_PARAM_INT:
+            *value += param->value.i;
+            break;
+        case VIR_TYPED_PARAM_UINT:
+            *value += param->value.ui;
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+            *value += param->value.l;
+            break;
+        case VIR_TYPED_PARAM_ULLONG:
+            *value += param->value.ul;
+            break;
+        case VIR_TYPED_PARAM_DOUBLE:
+            *value += param->value.d;
+            break;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            *value += param->value.b;
+            break;
+        case VIR_TYPED_PARAM_STRING:
+        default:
+            continue;
+        }
+
+        found = TRUE;
+    }
+
+    if (!rates)
+        return found;
+
+    g_variant_iter_init(&iter, rates);
+    while (g_variant_iter_loop(&iter, "{&sv}", &name, &rate)) {
+        if (!virtDBusUtilFieldMatches(metric, name))
+            continue;
+        *value += g_variant_get_double(rate);
+        found = TRUE;
+    }
+
+    return found;
+}
+
+static void
+virtDBusStatsHeapSiftDown(const gdouble *values,
+                          guint *heap,
+                          guint size,
+                          guint i)
+{
+    for (;;) {
+        guint smallest = i;
+        guint left = 2 * i + 1;
+        guint right = left + 1;
+        guint tmp;
+
+        if (left < size && values[heap[left]] < values[heap[smallest]])
+            smallest = left;
+        if (right < size && values[heap[right]] < values[heap[smallest]])
+            smallest = right;
+        if (smallest == i)
+            return;
+
+        tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+/**
+ * virtDBusStatsTopN:
+ * @values: values to select from
+ * @nvalues: number of @values
+ * @n: number of values to select
+ * @top: return location for MIN(@n, @nvalues) indexes into @values
+ *
+ * Selects the @n largest @values keeping only a min-heap of @n indexes,
+ * so that the cost is O(nvalues log n) instead of sorting all of them.
+ *
+ * Returns number of indexes stored in @top ordered from the largest value.
+ */
+guint
+virtDBusStatsTopN(const gdouble *values,
+                  guint nvalues,
+                  guint n,
+                  guint *top)
+{
+    guint size = MIN(n, nvalues);
+
+    if (size == 0)
+        return 0;
+
+    for (guint i = 0; i < size; i++)
+        top[i] = i;
+    for (guint i = size / 2; i-- > 0;)
+        virtDBusStatsHeapSiftDown(values, top, size, i);
+
+    for (guint i = size; i < nvalues; i++) {
+        if (values[i] <= values[top[0]])
+            continue;
+        top[0] = i;
+        virtDBusStatsHeapSiftDown(values, top, size, 0);
+    }
+
+    /* Sorting the heap moves the smallest values to the end. */
+    for (guint end = size - 1; end > 0; end--) {
+        guint tmp = top[0];
+
+        top[0] = top[end];
+        top[end] = tmp;
+        virtDBusStatsHeapSiftDown(values, top, end, 0);
+    }
+
+    return size;
+}
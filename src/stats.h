@@ -0,0 +1,89 @@
+#pragma once
+
+#include "util.h"
+
+#include <libvirt/libvirt.h>
+
+/* Key added to domain stats records served with VIRT_DBUS_STATS_STALE,
+ * see virtDBusStatsRecordToGVariant(). */
+#define VIRT_DBUS_STATS_SAMPLE_AGE "dbus.sample.age"
+
+/* Default maximum age of reused samples in seconds, see
+ * virtDBusStatsSetMaxStaleness(). */
+#define VIRT_DBUS_STATS_DEFAULT_MAX_STALENESS 60
+
+/* Flags of the stats methods handled by us and not passed to libvirt, see
+ * util.h. */
+#define VIRT_DBUS_STATS_FLAGS (VIRT_DBUS_STATS_RATES | VIRT_DBUS_STATS_STALE)
+
+typedef struct _virtDBusStatsCache virtDBusStatsCache;
+
+void
+virtDBusStatsSetMaxStaleness(gint64 maxStaleness);
+
+gboolean
+virtDBusStatsFieldInGroups(const gchar *field,
+                           guint stats) G_GNUC_PURE;
+
+guint
+virtDBusStatsGroupsForFields(const gchar *const *fields) G_GNUC_PURE;
+
+virtDBusStatsCache *
+virtDBusStatsCacheNew(void);
+
+void
+virtDBusStatsCacheFree(virtDBusStatsCache *cache);
+
+void
+virtDBusStatsCacheClear(virtDBusStatsCache *cache);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusStatsCache, virtDBusStatsCacheFree);
+
+gboolean
+virtDBusStatsCounterDelta(guint64 prev,
+                          guint64 cur,
+                          guint bits,
+                          guint64 *delta);
+
+gint
+virtDBusStatsGetAllDomainStats(virConnectPtr connection,
+                               guint stats,
+                               virDomainStatsRecordPtr **records,
+                               guint flags);
+
+gint
+virtDBusStatsListGetStats(virDomainPtr *domains,
+                          guint stats,
+                          virDomainStatsRecordPtr **records,
+                          guint flags);
+
+GVariant *
+virtDBusStatsRecordToGVariant(virtDBusStatsCache *cache,
+                              virDomainStatsRecordPtr record,
+                              guint stats,
+                              guint flags,
+                              const gchar *const *fields);
+
+GVariant *
+virtDBusStatsUpdateRates(virtDBusStatsCache *cache,
+                         const gchar *uuid,
+                         guint domainId,
+                         virTypedParameterPtr params,
+                         gint nparams,
+                         gint64 now);
+
+GVariant *
+virtDBusStatsGetRates(virtDBusStatsCache *cache,
+                      virDomainStatsRecordPtr record);
+
+gboolean
+virtDBusStatsMetricValue(virDomainStatsRecordPtr record,
+                         GVariant *rates,
+                         const gchar *metric,
+                         gdouble *value);
+
+guint
+virtDBusStatsTopN(const gdouble *values,
+                  guint nvalues,
+                  guint n,
+                  guint *top);
@@ -0,0 +1,341 @@
+#include "statsfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <grp.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+G_STATIC_ASSERT(sizeof(virtDBusStatsFileHeader) == 64);
+G_STATIC_ASSERT(sizeof(virtDBusStatsFileSlot) == 48);
+G_STATIC_ASSERT(VIR_UUID_STRING_BUFLEN <= VIRT_DBUS_STATS_FILE_UUID_LEN);
+
+/* Number of slots of a new file, it grows when there are more domains. */
+#define VIRT_DBUS_STATS_FILE_MIN_SLOTS 64
+
+struct _virtDBusStatsFile {
+    gchar *path;
+    gchar **fields;
+    guint nfields;
+    guint interval;
+    gsize size;
+    virtDBusStatsFileHeader *header;
+};
+
+static gchar *statsFileDir = NULL;
+static gid_t statsFileGroup = (gid_t)-1;
+static guint statsFileInterval = 0;
+static gchar **statsFileFields = NULL;
+
+/**
+ * virtDBusStatsFileSetDefaults:
+ * @dir: directory of the stats files, NULL disables them
+ * @group: group allowed to read the stats files, NULL for none
+ * @interval: sampling interval in milliseconds
+ * @fields: comma separated patterns of the columns, see
+ *   virtDBusStatsMetricValue()
+ * @error: return location for error
+ *
+ * Configures stats files created by virtDBusStatsFileNewDefault().  The
+ * files expose stats of all domains so they are readable only by the
+ * daemon user and @group.
+ *
+ * Returns FALSE if @group does not exist.
+ */
+gboolean
+virtDBusStatsFileSetDefaults(const gchar *dir,
+                             const gchar *group,
+                             guint interval,
+                             const gchar *fields,
+                             GError **error)
+{
+    statsFileGroup = (gid_t)-1;
+    if (group) {
+        struct group *grp = getgrnam(group);
+
+        if (!grp) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                        "unknown group '%s'", group);
+            return FALSE;
+        }
+        statsFileGroup = grp->gr_gid;
+    }
+
+    g_free(statsFileDir);
+    statsFileDir = g_strdup(dir);
+    statsFileInterval = interval;
+    g_strfreev(statsFileFields);
+    statsFileFields = g_strsplit(fields, ",", -1);
+
+    return TRUE;
+}
+
+static void
+virtDBusStatsFileSetError(GError **error,
+                          const gchar *message,
+                          const gchar *path)
+{
+    gint err = errno;
+
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                "%s '%s': %s", message, path, g_strerror(err));
+}
+
+static virtDBusStatsFileSlot *
+virtDBusStatsFileGetSlot(virtDBusStatsFile *file,
+                         guint i)
+{
+    gchar *slots = (gchar *)file->header + file->header->slotsOffset;
+
+    return (virtDBusStatsFileSlot *)(void *)(slots + (gsize)i * file->header->slotSize);
+}
+
+/*
+ * Creates the file with room for @nslots domains under a temporary name
+ * and renames it over the current one so that readers never see it half
+ * initialized.  Readers of the current file are told to open it again.
+ */
+static gboolean
+virtDBusStatsFileMap(virtDBusStatsFile *file,
+                     guint nslots,
+                     GError **error)
+{
+    g_autofree gchar *tmp = g_strdup_printf("%s.XXXXXX", file->path);
+    gsize fieldsOffset = sizeof(virtDBusStatsFileHeader);
+    gsize slotsOffset = fieldsOffset + (gsize)file->nfields * VIRT_DBUS_STATS_FILE_FIELD_LEN;
+    gsize slotSize = sizeof(virtDBusStatsFileSlot) + (gsize)file->nfields * sizeof(gdouble);
+    gsize size = slotsOffset + (gsize)nslots * slotSize;
+    virtDBusStatsFileHeader *header;
+    gint fd;
+
+    fd = g_mkstemp_full(tmp, O_RDWR | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        virtDBusStatsFileSetError(error, "failed to create stats file", tmp);
+        return FALSE;
+    }
+
+    if (statsFileGroup != (gid_t)-1 && fchown(fd, -1, statsFileGroup) < 0) {
+        virtDBusStatsFileSetError(error, "failed to change group of stats file", tmp);
+        close(fd);
+        g_unlink(tmp);
+        return FALSE;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        virtDBusStatsFileSetError(error, "failed to resize stats file", tmp);
+        close(fd);
+        g_unlink(tmp);
+        return FALSE;
+    }
+
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        virtDBusStatsFileSetError(error, "failed to map stats file", tmp);
+        close(fd);
+        g_unlink(tmp);
+        return FALSE;
+    }
+    close(fd);
+
+    /* The rest of the file reads as zeros, i.e. no domains. */
+    memcpy(header->magic, VIRT_DBUS_STATS_FILE_MAGIC, sizeof(header->magic));
+    header->version = VIRT_DBUS_STATS_FILE_VERSION;
+    header->nfields = file->nfields;
+    header->nslots = nslots;
+    header->fieldsOffset = fieldsOffset;
+    header->slotsOffset = slotsOffset;
+    header->slotSize = slotSize;
+
+    for (guint i = 0; i < file->nfields; i++) {
+        g_strlcpy((gchar *)header + fieldsOffset + i * VIRT_DBUS_STATS_FILE_FIELD_LEN,
+                  file->fields[i], VIRT_DBUS_STATS_FILE_FIELD_LEN);
+    }
+
+    if (g_rename(tmp, file->path) < 0) {
+        virtDBusStatsFileSetError(error, "failed to rename stats file", tmp);
+        munmap(header, size);
+        g_unlink(tmp);
+        return FALSE;
+    }
+
+    if (file->header) {
+        g_atomic_int_set(&file->header->stale, 1);
+        munmap(file->header, file->size);
+    }
+
+    file->header = header;
+    file->size = size;
+
+    return TRUE;
+}
+
+/**
+ * virtDBusStatsFileNew:
+ * @path: path of the file
+ * @interval: sampling interval in milliseconds
+ * @fields: NULL-terminated list of patterns of the columns
+ * @error: return location for error
+ *
+ * Creates a memory-mapped file at @path with stats of all domains for
+ * local readers which cannot afford D-Bus, see virtDBusStatsFileHeader.
+ * The file is removed by virtDBusStatsFileFree().
+ */
+virtDBusStatsFile *
+virtDBusStatsFileNew(const gchar *path,
+                     guint interval,
+                     const gchar *const *fields,
+                     GError **error)
+{
+    g_autoptr(virtDBusStatsFile) file = g_new0(virtDBusStatsFile, 1);
+
+    file->path = g_strdup(path);
+    file->fields = g_strdupv((gchar **)fields);
+    file->nfields = g_strv_length(file->fields);
+    file->interval = interval;
+
+    if (!virtDBusStatsFileMap(file, VIRT_DBUS_STATS_FILE_MIN_SLOTS, error))
+        return NULL;
+
+    return g_steal_pointer(&file);
+}
+
+/**
+ * virtDBusStatsFileNewDefault:
+ * @name: name of the file within the configured directory
+ * @error: return location for error
+ *
+ * Returns new stats file configured by virtDBusStatsFileSetDefaults() or
+ * NULL if stats files are disabled or on error.
+ */
+virtDBusStatsFile *
+virtDBusStatsFileNewDefault(const gchar *name,
+                            GError **error)
+{
+    g_autofree gchar *path = NULL;
+    gboolean exists;
+
+    if (!statsFileDir || !statsFileFields || !statsFileFields[0])
+        return NULL;
+
+    /* Permissions of an existing directory are left to the admin. */
+    exists = g_file_test(statsFileDir, G_FILE_TEST_IS_DIR);
+
+    if (g_mkdir_with_parents(statsFileDir, 0750) < 0) {
+        virtDBusStatsFileSetError(error, "failed to create directory",
+                                  statsFileDir);
+        return NULL;
+    }
+
+    if (!exists && statsFileGroup != (gid_t)-1 &&
+        chown(statsFileDir, -1, statsFileGroup) < 0) {
+        virtDBusStatsFileSetError(error, "failed to change group of directory",
+                                  statsFileDir);
+        return NULL;
+    }
+
+    path = g_strdup_printf("%s/%s.stats", statsFileDir, name);
+
+    return virtDBusStatsFileNew(path, statsFileInterval,
+                                (const gchar *const *)statsFileFields, error);
+}
+
+void
+virtDBusStatsFileFree(virtDBusStatsFile *file)
+{
+    if (file->header) {
+        g_atomic_int_set(&file->header->stale, 1);
+        munmap(file->header, file->size);
+        g_unlink(file->path);
+    }
+
+    g_free(file->path);
+    g_strfreev(file->fields);
+    g_free(file);
+}
+
+const gchar *const *
+virtDBusStatsFileGetFields(virtDBusStatsFile *file)
+{
+    return (const gchar *const *)file->fields;
+}
+
+guint
+virtDBusStatsFileGetInterval(virtDBusStatsFile *file)
+{
+    return file->interval;
+}
+
+/**
+ * virtDBusStatsFileUpdate:
+ * @file: stats file
+ * @cache: stats cache of the connection used to derive rates
+ * @records: stats records of all domains
+ * @nrecords: number of @records
+ * @timestamp: UNIX time of the sample in microseconds
+ * @error: return location for error
+ *
+ * Replaces the content of @file with @records.  Values are computed
+ * before the update starts so that readers retry only for the copying.
+ *
+ * Returns FALSE if the file could not grow for all @records, the first
+ * domains which fit are written anyway.
+ */
+gboolean
+virtDBusStatsFileUpdate(virtDBusStatsFile *file,
+                        virtDBusStatsCache *cache,
+                        virDomainStatsRecordPtr *records,
+                        gint nrecords,
+                        gint64 timestamp,
+                        GError **error)
+{
+    virtDBusStatsFileHeader *header;
+    g_autofree gdouble *values = NULL;
+    guint ndomains = MAX(nrecords, 0);
+    gboolean ret = TRUE;
+
+    if (ndomains > file->header->nslots) {
+        guint nslots = MAX(ndomains, file->header->nslots * 2);
+
+        if (!virtDBusStatsFileMap(file, nslots, error)) {
+            ndomains = file->header->nslots;
+            ret = FALSE;
+        }
+    }
+
+    values = g_new0(gdouble, (gsize)ndomains * file->nfields + 1);
+    for (guint i = 0; i < ndomains; i++) {
+        g_autoptr(GVariant) rates = virtDBusStatsGetRates(cache, records[i]);
+
+        for (guint j = 0; j < file->nfields; j++) {
+            gdouble *value = values + (gsize)i * file->nfields + j;
+
+            if (!virtDBusStatsMetricValue(records[i], rates, file->fields[j],
+                                          value)) {
+                *value = NAN;
+            }
+        }
+    }
+
+    header = file->header;
+
+    g_atomic_int_inc(&header->sequence);
+
+    for (guint i = 0; i < ndomains; i++) {
+        virtDBusStatsFileSlot *slot = virtDBusStatsFileGetSlot(file, i);
+
+        memset(slot->uuid, 0, sizeof(slot->uuid));
+        virDomainGetUUIDString(records[i]->dom, slot->uuid);
+        slot->id = virDomainGetID(records[i]->dom);
+        memcpy(slot->values, values + (gsize)i * file->nfields,
+               file->nfields * sizeof(gdouble));
+    }
+    header->ndomains = ndomains;
+    header->timestamp = timestamp;
+
+    g_atomic_int_inc(&header->sequence);
+
+    return ret;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "stats.h"
+
+/* Columns of the stats file unless configured otherwise. */
+#define VIRT_DBUS_STATS_FILE_DEFAULT_FIELDS \
+    "cpu.time,balloon.current,block.*.rd.bytes,block.*.wr.bytes,net.*.rx.bytes,net.*.tx.bytes"
+
+#define VIRT_DBUS_STATS_FILE_MAGIC "LVDBSTAT"
+#define VIRT_DBUS_STATS_FILE_VERSION 1
+#define VIRT_DBUS_STATS_FILE_FIELD_LEN 64
+#define VIRT_DBUS_STATS_FILE_UUID_LEN 40
+
+/*
+ * Layout of the stats file shared with local readers, in host byte order.
+ * The header is followed by @nfields names of @FIELD_LEN bytes at
+ * @fieldsOffset and by @nslots slots of @slotSize bytes at @slotsOffset,
+ * the first @ndomains of them are valid.
+ *
+ * The writer increments @sequence before and after every update so a
+ * reader copies what it needs while @sequence is even and retries if
+ * @sequence changed meanwhile.  Once @stale is set the file was replaced
+ * or removed and has to be opened again.
+ */
+struct _virtDBusStatsFileHeader {
+    gchar magic[8];
+    guint32 version;
+    gint32 sequence;
+    guint32 nfields;
+    guint32 nslots;
+    guint32 ndomains;
+    gint32 stale;
+    gint64 timestamp;
+    guint32 fieldsOffset;
+    guint32 slotsOffset;
+    guint32 slotSize;
+    guint32 reserved[3];
+};
+typedef struct _virtDBusStatsFileHeader virtDBusStatsFileHeader;
+
+/* Values are the sums of the fields matching a column, NaN if none does. */
+struct _virtDBusStatsFileSlot {
+    gchar uuid[VIRT_DBUS_STATS_FILE_UUID_LEN];
+    guint32 id;
+    guint32 reserved;
+    gdouble values[];
+};
+typedef struct _virtDBusStatsFileSlot virtDBusStatsFileSlot;
+
+typedef struct _virtDBusStatsFile virtDBusStatsFile;
+
+gboolean
+virtDBusStatsFileSetDefaults(const gchar *dir,
+                             const gchar *group,
+                             guint interval,
+                             const gchar *fields,
+                             GError **error);
+
+virtDBusStatsFile *
+virtDBusStatsFileNew(const gchar *path,
+                     guint interval,
+                     const gchar *const *fields,
+                     GError **error);
+
+virtDBusStatsFile *
+virtDBusStatsFileNewDefault(const gchar *name,
+                            GError **error);
+
+void
+virtDBusStatsFileFree(virtDBusStatsFile *file);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusStatsFile, virtDBusStatsFileFree);
+
+const gchar *const *
+virtDBusStatsFileGetFields(virtDBusStatsFile *file);
+
+guint
+virtDBusStatsFileGetInterval(virtDBusStatsFile *file);
+
+gboolean
+virtDBusStatsFileUpdate(virtDBusStatsFile *file,
+                        virtDBusStatsCache *cache,
+                        virDomainStatsRecordPtr *records,
+                        gint nrecords,
+                        gint64 timestamp,
+                        GError **error);
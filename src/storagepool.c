@@ -9,10 +9,16 @@ virtDBusStoragePoolGetVirStoragePool(virtDBusConnect *connect,
                                      GError **error)
 {
     virStoragePoolPtr storagePool;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    storagePool = virtDBusUtilHandleCacheLookup(connect->storagePoolCache, objectPath,
+                                                connect->connection, &generation);
+    if (storagePool)
+        return storagePool;
+
     storagePool = virtDBusUtilVirStoragePoolFromBusPath(connect->connection,
                                                         objectPath,
                                                         connect->storagePoolPath);
@@ -21,6 +27,9 @@ virtDBusStoragePoolGetVirStoragePool(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->storagePoolCache, objectPath,
+                                  connect->connection, storagePool, generation);
+
     return storagePool;
 }
 
@@ -118,17 +127,11 @@ virtDBusStoragePoolGetUUID(const gchar *objectPath,
                            GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virStoragePool) storagePool = NULL;
     gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
 
-    storagePool = virtDBusStoragePoolGetVirStoragePool(connect, objectPath,
-                                                       error);
-    if (!storagePool)
+    if (!virtDBusUtilUUIDFromBusPath(objectPath, connect->storagePoolPath, uuid, error))
         return;
 
-    if (virStoragePoolGetUUIDString(storagePool, uuid) < 0)
-        return virtDBusUtilSetLastVirtError(error);
-
     *value = g_variant_new("s", uuid);
 }
 
@@ -139,6 +142,7 @@ virtDBusStoragePoolSetAutostart(GVariant *value,
                                 GError **error)
 {
     virtDBusConnect *connect = userData;
+    static const gchar *const properties[] = { "Autostart", NULL };
     g_autoptr(virStoragePool) storagePool = NULL;
     gboolean autostart;
 
@@ -150,7 +154,10 @@ virtDBusStoragePoolSetAutostart(GVariant *value,
         return;
 
     if (virStoragePoolSetAutostart(storagePool, autostart) < 0)
-        virtDBusUtilSetLastVirtError(error);
+        return virtDBusUtilSetLastVirtError(error);
+
+    virtDBusGDBusEmitPropertiesChanged(connect->bus, objectPath,
+                                       VIRT_DBUS_STORAGEPOOL_INTERFACE, properties);
 }
 
 static void
@@ -175,6 +182,8 @@ virtDBusStoragePoolBuild(GVariant *inArgs,
 
     if (virStoragePoolBuild(storagePool, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, objectPath);
 }
 
 static void
@@ -199,6 +208,8 @@ virtDBusStoragePoolCreate(GVariant *inArgs,
 
     if (virStoragePoolCreate(storagePool, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, objectPath);
 }
 
 static void
@@ -223,6 +234,8 @@ virtDBusStoragePoolDelete(GVariant *inArgs,
 
     if (virStoragePoolDelete(storagePool, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, objectPath);
 }
 
 static void
@@ -244,6 +257,8 @@ virtDBusStoragePoolDestroy(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virStoragePoolDestroy(storagePool) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, objectPath);
 }
 
 static void
@@ -285,10 +300,18 @@ virtDBusStoragePoolGetXMLDesc(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virStoragePool) storagePool = NULL;
     g_autofree gchar *xml = NULL;
+    guint generation;
     guint flags;
 
     g_variant_get(inArgs, "(u)", &flags);
 
+    xml = virtDBusUtilXMLCacheLookup(connect->storagePoolXMLCache, objectPath,
+                                     flags, &generation);
+    if (xml) {
+        *outArgs = g_variant_new("(s)", xml);
+        return;
+    }
+
     storagePool = virtDBusStoragePoolGetVirStoragePool(connect, objectPath,
                                                        error);
     if (!storagePool)
@@ -298,6 +321,9 @@ virtDBusStoragePoolGetXMLDesc(GVariant *inArgs,
     if (!xml)
         return virtDBusUtilSetLastVirtError(error);
 
+    virtDBusUtilXMLCacheInsert(connect->storagePoolXMLCache, objectPath, flags, xml,
+                               generation);
+
     *outArgs = g_variant_new("(s)", xml);
 }
 
@@ -365,6 +391,8 @@ virtDBusStoragePoolRefresh(GVariant *inArgs,
 
     if (virStoragePoolRefresh(storagePool, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, objectPath);
 }
 
 static void
@@ -391,12 +419,17 @@ virtDBusStoragePoolStorageVolCreateXML(GVariant *inArgs,
         return;
 
     storageVol = virStorageVolCreateXML(storagePool, xml, flags);
+
+    virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
     if (!storageVol)
         return virtDBusUtilSetLastVirtError(error);
 
     path = virtDBusUtilBusPathForVirStorageVol(storageVol,
                                                connect->storageVolPath);
 
+    virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+
     *outArgs = g_variant_new("(o)", path);
 }
 
@@ -431,12 +464,17 @@ virtDBusStoragePoolStorageVolCreateXMLFrom(GVariant *inArgs,
 
     storageVol = virStorageVolCreateXMLFrom(storagePool, xml, storageVolOld,
                                             flags);
+
+    virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
     if (!storageVol)
         return virtDBusUtilSetLastVirtError(error);
 
     path = virtDBusUtilBusPathForVirStorageVol(storageVol,
                                                connect->storageVolPath);
 
+    virtDBusGDBusEmitInterfacesAdded(connect->bus, path);
+
     *outArgs = g_variant_new("(o)", path);
 }
 
@@ -492,31 +530,33 @@ virtDBusStoragePoolUndefine(GVariant *inArgs G_GNUC_UNUSED,
 
     if (virStoragePoolUndefine(storagePool) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storagePoolXMLCache, objectPath);
 }
 
 static virtDBusGDBusPropertyTable virtDBusStoragePoolPropertyTable[] = {
-    { "Active", virtDBusStoragePoolGetActive, NULL },
+    { "Active", virtDBusStoragePoolGetActive, NULL, 0, 0 },
     { "Autostart", virtDBusStoragePoolGetAutostart,
-                   virtDBusStoragePoolSetAutostart },
-    { "Name", virtDBusStoragePoolGetName, NULL },
-    { "Persistent", virtDBusStoragePoolGetPersistent, NULL },
-    { "UUID", virtDBusStoragePoolGetUUID, NULL },
+                   virtDBusStoragePoolSetAutostart, 0, 0 },
+    { "Name", virtDBusStoragePoolGetName, NULL, 0, 0 },
+    { "Persistent", virtDBusStoragePoolGetPersistent, NULL, 0, 0 },
+    { "UUID", virtDBusStoragePoolGetUUID, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusStoragePoolMethodTable[] = {
-    { "Build", virtDBusStoragePoolBuild },
-    { "Create", virtDBusStoragePoolCreate },
-    { "Delete", virtDBusStoragePoolDelete },
-    { "Destroy", virtDBusStoragePoolDestroy },
-    { "GetInfo", virtDBusStoragePoolGetInfo },
-    { "GetXMLDesc", virtDBusStoragePoolGetXMLDesc },
-    { "ListStorageVolumes", virtDBusStoragePoolListStorageVolumes },
-    { "Refresh", virtDBusStoragePoolRefresh },
-    { "StorageVolCreateXML", virtDBusStoragePoolStorageVolCreateXML },
-    { "StorageVolCreateXMLFrom", virtDBusStoragePoolStorageVolCreateXMLFrom },
-    { "StorageVolLookupByName", virtDBusStoragePoolStorageVolLookupByName },
-    { "Undefine", virtDBusStoragePoolUndefine },
+    { "Build", virtDBusStoragePoolBuild, 0 },
+    { "Create", virtDBusStoragePoolCreate, 0 },
+    { "Delete", virtDBusStoragePoolDelete, 0 },
+    { "Destroy", virtDBusStoragePoolDestroy, 0 },
+    { "GetInfo", virtDBusStoragePoolGetInfo, 0 },
+    { "GetXMLDesc", virtDBusStoragePoolGetXMLDesc, 0 },
+    { "ListStorageVolumes", virtDBusStoragePoolListStorageVolumes, 0 },
+    { "Refresh", virtDBusStoragePoolRefresh, 0 },
+    { "StorageVolCreateXML", virtDBusStoragePoolStorageVolCreateXML, 0 },
+    { "StorageVolCreateXMLFrom", virtDBusStoragePoolStorageVolCreateXMLFrom, 0 },
+    { "StorageVolLookupByName", virtDBusStoragePoolStorageVolLookupByName, 0 },
+    { "Undefine", virtDBusStoragePoolUndefine, 0 },
     { 0 }
 };
 
@@ -548,6 +588,19 @@ virtDBusStoragePoolEnumerate(gpointer userData)
     return ret;
 }
 
+static gboolean
+virtDBusStoragePoolExists(const gchar *objectPath,
+                          gpointer userData,
+                          GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virStoragePool) storagePool = NULL;
+
+    storagePool = virtDBusStoragePoolGetVirStoragePool(connect, objectPath, error);
+
+    return !!storagePool;
+}
+
 static GDBusInterfaceInfo *interfaceInfo;
 
 void
@@ -568,7 +621,10 @@ virtDBusStoragePoolRegister(virtDBusConnect *connect,
                                  connect->storagePoolPath,
                                  interfaceInfo,
                                  virtDBusStoragePoolEnumerate,
+                                 virtDBusStoragePoolExists,
                                  virtDBusStoragePoolMethodTable,
                                  virtDBusStoragePoolPropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
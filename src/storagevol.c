@@ -9,10 +9,16 @@ virtDBusStorageVolGetVirStorageVol(virtDBusConnect *connect,
                                    GError **error)
 {
     virStorageVolPtr storageVol;
+    guint generation;
 
     if (!virtDBusConnectOpen(connect, error))
         return NULL;
 
+    storageVol = virtDBusUtilHandleCacheLookup(connect->storageVolCache, objectPath,
+                                               connect->connection, &generation);
+    if (storageVol)
+        return storageVol;
+
     storageVol = virtDBusUtilVirStorageVolFromBusPath(connect->connection,
                                                       objectPath,
                                                       connect->storageVolPath);
@@ -21,6 +27,9 @@ virtDBusStorageVolGetVirStorageVol(virtDBusConnect *connect,
         return NULL;
     }
 
+    virtDBusUtilHandleCacheInsert(connect->storageVolCache, objectPath,
+                                  connect->connection, storageVol, generation);
+
     return storageVol;
 }
 
@@ -53,17 +62,11 @@ virtDBusStorageVolGetKey(const gchar *objectPath,
                          GError **error)
 {
     virtDBusConnect *connect = userData;
-    g_autoptr(virStorageVol) storageVol = NULL;
-    const gchar *key;
-
-    storageVol = virtDBusStorageVolGetVirStorageVol(connect, objectPath,
-                                                    error);
-    if (!storageVol)
-        return;
+    g_autofree gchar *key = NULL;
 
-    key = virStorageVolGetKey(storageVol);
+    key = virtDBusUtilNameFromBusPath(objectPath, connect->storageVolPath, error);
     if (!key)
-        return virtDBusUtilSetLastVirtError(error);
+        return;
 
     *value = g_variant_new("s", key);
 }
@@ -101,6 +104,7 @@ virtDBusStorageVolDelete(GVariant *inArgs,
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virStorageVol) storageVol = NULL;
+    gint ret;
     guint flags;
 
     g_variant_get(inArgs, "(u)", &flags);
@@ -110,8 +114,17 @@ virtDBusStorageVolDelete(GVariant *inArgs,
     if (!storageVol)
         return;
 
-    if (virStorageVolDelete(storageVol, flags) < 0)
-        virtDBusUtilSetLastVirtError(error);
+    virtDBusUtilHandleCacheRemove(connect->storageVolCache, objectPath);
+
+    ret = virStorageVolDelete(storageVol, flags);
+
+    virtDBusUtilXMLCacheRemove(connect->storageVolXMLCache, objectPath);
+    virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
+    if (ret < 0)
+        return virtDBusUtilSetLastVirtError(error);
+
+    virtDBusGDBusEmitInterfacesRemoved(connect->bus, objectPath);
 }
 
 static void
@@ -154,10 +167,18 @@ virtDBusStorageVolGetXMLDesc(GVariant *inArgs,
     virtDBusConnect *connect = userData;
     g_autoptr(virStorageVol) storageVol = NULL;
     g_autofree gchar *xml = NULL;
+    guint generation;
     guint flags;
 
     g_variant_get(inArgs, "(u)", &flags);
 
+    xml = virtDBusUtilXMLCacheLookup(connect->storageVolXMLCache, objectPath,
+                                     flags, &generation);
+    if (xml) {
+        *outArgs = g_variant_new("(s)", xml);
+        return;
+    }
+
     storageVol = virtDBusStorageVolGetVirStorageVol(connect, objectPath,
                                                     error);
     if (!storageVol)
@@ -167,6 +188,9 @@ virtDBusStorageVolGetXMLDesc(GVariant *inArgs,
     if (!xml)
         return virtDBusUtilSetLastVirtError(error);
 
+    virtDBusUtilXMLCacheInsert(connect->storageVolXMLCache, objectPath, flags, xml,
+                               generation);
+
     *outArgs = g_variant_new("(s)", xml);
 }
 
@@ -193,6 +217,8 @@ virtDBusStorageVolResize(GVariant *inArgs,
 
     if (virStorageVolResize(storageVol, capacity, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storageVolXMLCache, objectPath);
 }
 
 static void
@@ -218,30 +244,65 @@ virtDBusStorageVolWipe(GVariant *inArgs,
 
     if (virStorageVolWipePattern(storageVol, pattern, flags) < 0)
         virtDBusUtilSetLastVirtError(error);
+
+    virtDBusUtilXMLCacheRemove(connect->storageVolXMLCache, objectPath);
 }
 
 static virtDBusGDBusPropertyTable virtDBusStorageVolPropertyTable[] = {
-    { "Name", virtDBusStorageVolGetName, NULL },
-    { "Key", virtDBusStorageVolGetKey, NULL },
-    { "Path", virtDBusStorageVolGetPath, NULL },
+    { "Name", virtDBusStorageVolGetName, NULL, 0, 0 },
+    { "Key", virtDBusStorageVolGetKey, NULL, VIRT_DBUS_GDBUS_PROPERTY_INLINE, 0 },
+    { "Path", virtDBusStorageVolGetPath, NULL, 0, 0 },
     { 0 }
 };
 
 static virtDBusGDBusMethodTable virtDBusStorageVolMethodTable[] = {
-    { "Delete", virtDBusStorageVolDelete },
-    { "GetInfo", virtDBusStorageVolGetInfo },
-    { "GetXMLDesc", virtDBusStorageVolGetXMLDesc },
-    { "Resize", virtDBusStorageVolResize },
-    { "Wipe", virtDBusStorageVolWipe },
+    { "Delete", virtDBusStorageVolDelete, 0 },
+    { "GetInfo", virtDBusStorageVolGetInfo, 0 },
+    { "GetXMLDesc", virtDBusStorageVolGetXMLDesc, 0 },
+    { "Resize", virtDBusStorageVolResize, 0 },
+    { "Wipe", virtDBusStorageVolWipe, 0 },
     { 0 }
 };
 
+static gpointer
+virtDBusStorageVolListPool(gpointer item,
+                           gpointer userData)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virStorageVolPtr) storageVols = NULL;
+    gchar **volPaths;
+    gint numVols;
+
+    numVols = virStoragePoolListAllVolumes(item, &storageVols, 0);
+    if (numVols <= 0)
+        return NULL;
+
+    volPaths = g_new0(gchar *, numVols + 1);
+    for (gint i = 0; i < numVols; i++) {
+        volPaths[i] = virtDBusUtilBusPathForVirStorageVol(storageVols[i],
+                                                          connect->storageVolPath);
+    }
+
+    return volPaths;
+}
+
+static gchar *
+virtDBusStorageVolPoolKey(gpointer item,
+                          gpointer userData)
+{
+    virtDBusConnect *connect = userData;
+
+    return virtDBusUtilBusPathForVirStoragePool(item, connect->storagePoolPath);
+}
+
 static gchar **
 virtDBusStorageVolEnumerate(gpointer userData)
 {
     virtDBusConnect *connect = userData;
     g_autoptr(virStoragePoolPtr) storagePools = NULL;
+    g_autofree gpointer *results = NULL;
     gint numPools = 0;
+    gboolean partial;
     GPtrArray *list = NULL;
 
     if (!virtDBusConnectOpen(connect, NULL))
@@ -252,30 +313,54 @@ virtDBusStorageVolEnumerate(gpointer userData)
     if (numPools <= 0)
         return NULL;
 
+    /* A single unresponsive pool (e.g. a hung NFS mount) must not block
+     * the listing of all the others. */
+    results = virtDBusUtilFanOut((gpointer *)g_steal_pointer(&storagePools),
+                                 numPools,
+                                 (GDestroyNotify)virtDBusUtilVirStoragePoolListFree,
+                                 virtDBusStorageVolListPool,
+                                 virtDBusStorageVolPoolKey,
+                                 (GDestroyNotify)g_strfreev,
+                                 connect,
+                                 VIRT_DBUS_UTIL_FAN_OUT_TIMEOUT,
+                                 &partial);
+
     list = g_ptr_array_new();
 
     for (gint i = 0; i < numPools; i++) {
-        g_autoptr(virStorageVolPtr) storageVols = NULL;
-        gint numVols;
+        gchar **volPaths = results[i];
 
-        numVols = virStoragePoolListAllVolumes(storagePools[i],
-                                               &storageVols, 0);
-        if (numVols <= 0)
+        if (!volPaths)
             continue;
 
-        for (gint j = 0; j < numVols; j++) {
-            gchar *volPath = virtDBusUtilBusPathForVirStorageVol(storageVols[j],
-                                                                 connect->storageVolPath);
-            g_ptr_array_add(list, volPath);
-        }
+        for (gint j = 0; volPaths[j]; j++)
+            g_ptr_array_add(list, volPaths[j]);
+        g_free(volPaths);
     }
 
+    /* Do not keep the incomplete list in the enumerate cache. */
+    if (partial)
+        virtDBusGDBusInvalidateSubtree(connect->storageVolPath);
+
     if (list->len > 0)
         g_ptr_array_add(list, NULL);
 
     return (gchar **)g_ptr_array_free(list, FALSE);
 }
 
+static gboolean
+virtDBusStorageVolExists(const gchar *objectPath,
+                         gpointer userData,
+                         GError **error)
+{
+    virtDBusConnect *connect = userData;
+    g_autoptr(virStorageVol) storageVol = NULL;
+
+    storageVol = virtDBusStorageVolGetVirStorageVol(connect, objectPath, error);
+
+    return !!storageVol;
+}
+
 static GDBusInterfaceInfo *interfaceInfo;
 
 void
@@ -296,7 +381,10 @@ virtDBusStorageVolRegister(virtDBusConnect *connect,
                                  connect->storageVolPath,
                                  interfaceInfo,
                                  virtDBusStorageVolEnumerate,
+                                 virtDBusStorageVolExists,
                                  virtDBusStorageVolMethodTable,
                                  virtDBusStorageVolPropertyTable,
-                                 connect);
+                                 NULL,
+                                 connect,
+                                 error);
 }
@@ -0,0 +1,419 @@
+#include "threshold.h"
+
+/* Upper bound of rules of one owner.  Every rule is checked against all
+ * fields of all domains on every sample. */
+#define VIRT_DBUS_THRESHOLDS_MAX_RULES 256
+
+typedef enum {
+    VIRT_DBUS_THRESHOLD_LT,
+    VIRT_DBUS_THRESHOLD_LE,
+    VIRT_DBUS_THRESHOLD_GT,
+    VIRT_DBUS_THRESHOLD_GE,
+    VIRT_DBUS_THRESHOLD_EQ,
+    VIRT_DBUS_THRESHOLD_NE,
+} virtDBusThresholdComparison;
+
+/* Indexed by virtDBusThresholdComparison. */
+static const gchar *const virtDBusThresholdComparisons[] = {
+    "<",
+    "<=",
+    ">",
+    ">=",
+    "==",
+    "!=",
+    NULL
+};
+
+struct _virtDBusThresholdRule {
+    guint id;
+    gchar *owner;
+    gchar *metric;
+    virtDBusThresholdComparison comparison;
+    gdouble threshold;
+    gint64 hold;
+};
+typedef struct _virtDBusThresholdRule virtDBusThresholdRule;
+
+struct _virtDBusThresholdState {
+    gint64 since;
+    gint64 seen;
+    gboolean crossed;
+};
+typedef struct _virtDBusThresholdState virtDBusThresholdState;
+
+struct _virtDBusThresholds {
+    GHashTable *rules;
+    GHashTable *states;
+    guint nextId;
+};
+
+static void
+virtDBusThresholdRuleFree(gpointer opaque)
+{
+    virtDBusThresholdRule *rule = opaque;
+
+    g_free(rule->owner);
+    g_free(rule->metric);
+    g_free(rule);
+}
+
+/**
+ * virtDBusThresholdsNew:
+ *
+ * Creates an empty set of threshold rules.  The set is not thread-safe,
+ * the caller has to serialize access to it.
+ */
+virtDBusThresholds *
+virtDBusThresholdsNew(void)
+{
+    virtDBusThresholds *thresholds = g_new0(virtDBusThresholds, 1);
+
+    thresholds->rules = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              NULL, virtDBusThresholdRuleFree);
+    thresholds->states = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, g_free);
+
+    return thresholds;
+}
+
+void
+virtDBusThresholdsFree(virtDBusThresholds *thresholds)
+{
+    g_hash_table_unref(thresholds->rules);
+    g_hash_table_unref(thresholds->states);
+    g_free(thresholds);
+}
+
+static guint
+virtDBusThresholdsCountOwner(virtDBusThresholds *thresholds,
+                             const gchar *owner)
+{
+    GHashTableIter iter;
+    virtDBusThresholdRule *rule;
+    guint count = 0;
+
+    g_hash_table_iter_init(&iter, thresholds->rules);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&rule)) {
+        if (g_strcmp0(rule->owner, owner) == 0)
+            count++;
+    }
+
+    return count;
+}
+
+/**
+ * virtDBusThresholdsAdd:
+ * @thresholds: set of rules
+ * @owner: owner of the rule, typically unique bus name of a client
+ * @metric: pattern of checked fields, see virtDBusUtilFieldMatches()
+ * @comparison: one of "<", "<=", ">", ">=", "==" or "!="
+ * @threshold: value the fields are compared with
+ * @hold: time in milliseconds the comparison has to hold before the
+ *   threshold counts as crossed
+ * @error: return location for error
+ *
+ * Returns ID of the new rule or 0 on error.
+ */
+guint
+virtDBusThresholdsAdd(virtDBusThresholds *thresholds,
+                      const gchar *owner,
+                      const gchar *metric,
+                      const gchar *comparison,
+                      gdouble threshold,
+                      guint hold,
+                      GError **error)
+{
+    virtDBusThresholdRule *rule;
+    gint op = -1;
+
+    for (gint i = 0; virtDBusThresholdComparisons[i]; i++) {
+        if (g_str_equal(virtDBusThresholdComparisons[i], comparison)) {
+            op = i;
+            break;
+        }
+    }
+
+    if (op < 0) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "unknown comparison '%s'", comparison);
+        return 0;
+    }
+
+    if (!metric[0]) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "metric must not be empty");
+        return 0;
+    }
+
+    if (virtDBusThresholdsCountOwner(thresholds, owner) >= VIRT_DBUS_THRESHOLDS_MAX_RULES) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                    "too many threshold rules");
+        return 0;
+    }
+
+    /* The number of rules is limited only per owner so the IDs may wrap
+     * around to ones still in use. */
+    do {
+        if (++thresholds->nextId == 0)
+            ++thresholds->nextId;
+    } while (g_hash_table_contains(thresholds->rules,
+                                   GUINT_TO_POINTER(thresholds->nextId)));
+
+    rule = g_new0(virtDBusThresholdRule, 1);
+    rule->id = thresholds->nextId;
+    rule->owner = g_strdup(owner);
+    rule->metric = g_strdup(metric);
+    rule->comparison = op;
+    rule->threshold = threshold;
+    rule->hold = (gint64)hold * 1000;
+
+    g_hash_table_insert(thresholds->rules, GUINT_TO_POINTER(rule->id), rule);
+
+    return rule->id;
+}
+
+static void
+virtDBusThresholdsRemoveRule(virtDBusThresholds *thresholds,
+                             guint id)
+{
+    g_autofree gchar *prefix = g_strdup_printf("%u ", id);
+    GHashTableIter iter;
+    const gchar *key;
+
+    g_hash_table_iter_init(&iter, thresholds->states);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL)) {
+        if (g_str_has_prefix(key, prefix))
+            g_hash_table_iter_remove(&iter);
+    }
+
+    g_hash_table_remove(thresholds->rules, GUINT_TO_POINTER(id));
+}
+
+/**
+ * virtDBusThresholdsRemove:
+ * @thresholds: set of rules
+ * @owner: owner of the rule
+ * @id: ID returned by virtDBusThresholdsAdd()
+ * @error: return location for error
+ *
+ * Removes a rule of @owner.
+ */
+gboolean
+virtDBusThresholdsRemove(virtDBusThresholds *thresholds,
+                         const gchar *owner,
+                         guint id,
+                         GError **error)
+{
+    virtDBusThresholdRule *rule;
+
+    rule = g_hash_table_lookup(thresholds->rules, GUINT_TO_POINTER(id));
+    if (!rule || g_strcmp0(rule->owner, owner) != 0) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "no threshold rule with ID %u", id);
+        return FALSE;
+    }
+
+    virtDBusThresholdsRemoveRule(thresholds, id);
+
+    return TRUE;
+}
+
+void
+virtDBusThresholdsRemoveOwner(virtDBusThresholds *thresholds,
+                              const gchar *owner)
+{
+    g_autoptr(GArray) ids = g_array_new(FALSE, FALSE, sizeof(guint));
+    GHashTableIter iter;
+    virtDBusThresholdRule *rule;
+
+    g_hash_table_iter_init(&iter, thresholds->rules);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&rule)) {
+        if (g_strcmp0(rule->owner, owner) == 0)
+            g_array_append_val(ids, rule->id);
+    }
+
+    for (guint i = 0; i < ids->len; i++)
+        virtDBusThresholdsRemoveRule(thresholds, g_array_index(ids, guint, i));
+}
+
+guint
+virtDBusThresholdsCount(virtDBusThresholds *thresholds)
+{
+    return g_hash_table_size(thresholds->rules);
+}
+
+/**
+ * virtDBusThresholdsGetMetrics:
+ *
+ * Returns NULL-terminated list of metrics of all rules.
+ */
+gchar **
+virtDBusThresholdsGetMetrics(virtDBusThresholds *thresholds)
+{
+    gchar **metrics = g_new0(gchar *, g_hash_table_size(thresholds->rules) + 1);
+    GHashTableIter iter;
+    virtDBusThresholdRule *rule;
+    guint i = 0;
+
+    g_hash_table_iter_init(&iter, thresholds->rules);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&rule))
+        metrics[i++] = g_strdup(rule->metric);
+
+    return metrics;
+}
+
+static gboolean
+virtDBusThresholdsNumber(GVariant *value,
+                         gdouble *number)
+{
+    switch (g_variant_classify(value)) {
+    case G_VARIANT_CLASS_INT32:
+        *number = g_variant_get_int32(value);
+        return TRUE;
+    case G_VARIANT_CLASS_UINT32:
+        *number = g_variant_get_uint32(value);
+        return TRUE;
+    case G_VARIANT_CLASS_INT64:
+        *number = g_variant_get_int64(value);
+        return TRUE;
+    case G_VARIANT_CLASS_UINT64:
+        *number = g_variant_get_uint64(value);
+        return TRUE;
+    case G_VARIANT_CLASS_DOUBLE:
+        *number = g_variant_get_double(value);
+        return TRUE;
+    case G_VARIANT_CLASS_BOOLEAN:
+        *number = g_variant_get_boolean(value);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static gboolean
+virtDBusThresholdsCompare(virtDBusThresholdComparison comparison,
+                          gdouble value,
+                          gdouble threshold)
+{
+    switch (comparison) {
+    case VIRT_DBUS_THRESHOLD_LT:
+        return value < threshold;
+    case VIRT_DBUS_THRESHOLD_LE:
+        return value <= threshold;
+    case VIRT_DBUS_THRESHOLD_GT:
+        return value > threshold;
+    case VIRT_DBUS_THRESHOLD_GE:
+        return value >= threshold;
+    case VIRT_DBUS_THRESHOLD_EQ:
+        return value == threshold;
+    case VIRT_DBUS_THRESHOLD_NE:
+        return value != threshold;
+    }
+
+    return FALSE;
+}
+
+static void
+virtDBusThresholdsUpdate(virtDBusThresholds *thresholds,
+                         virtDBusThresholdRule *rule,
+                         const gchar *object,
+                         const gchar *field,
+                         gdouble value,
+                         gint64 now,
+                         virtDBusThresholdsCrossedFunc func,
+                         gpointer opaque)
+{
+    g_autofree gchar *key = g_strdup_printf("%u %s %s", rule->id, object, field);
+    virtDBusThresholdState *state;
+
+    state = g_hash_table_lookup(thresholds->states, key);
+    if (!state) {
+        state = g_new0(virtDBusThresholdState, 1);
+        state->since = -1;
+        g_hash_table_insert(thresholds->states, g_steal_pointer(&key), state);
+    }
+
+    state->seen = now;
+
+    if (virtDBusThresholdsCompare(rule->comparison, value, rule->threshold)) {
+        if (state->since < 0)
+            state->since = now;
+        if (!state->crossed && now - state->since >= rule->hold) {
+            state->crossed = TRUE;
+            func(rule->owner, object, rule->id, field, value, TRUE, opaque);
+        }
+    } else {
+        state->since = -1;
+        if (state->crossed) {
+            state->crossed = FALSE;
+            func(rule->owner, object, rule->id, field, value, FALSE, opaque);
+        }
+    }
+}
+
+/**
+ * virtDBusThresholdsEvaluate:
+ * @thresholds: set of rules
+ * @object: name of the object the record belongs to
+ * @record: a{sv} dictionary of stats fields
+ * @now: time of the sample in microseconds
+ * @func: called when a field crosses a threshold and when it returns
+ * @opaque: data passed to @func
+ *
+ * Checks numeric fields of @record matching the metric of a rule.  A
+ * threshold is crossed once the comparison holds for the hold time of the
+ * rule and returns once it does not hold any more.
+ */
+void
+virtDBusThresholdsEvaluate(virtDBusThresholds *thresholds,
+                           const gchar *object,
+                           GVariant *record,
+                           gint64 now,
+                           virtDBusThresholdsCrossedFunc func,
+                           gpointer opaque)
+{
+    GHashTableIter iter;
+    virtDBusThresholdRule *rule;
+
+    g_hash_table_iter_init(&iter, thresholds->rules);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&rule)) {
+        GVariantIter fields;
+        const gchar *name;
+        GVariant *value;
+
+        g_variant_iter_init(&fields, record);
+        while (g_variant_iter_loop(&fields, "{&sv}", &name, &value)) {
+            gdouble number;
+
+            if (!virtDBusUtilFieldMatches(rule->metric, name) ||
+                !virtDBusThresholdsNumber(value, &number)) {
+                continue;
+            }
+
+            virtDBusThresholdsUpdate(thresholds, rule, object, name, number,
+                                     now, func, opaque);
+        }
+    }
+}
+
+/**
+ * virtDBusThresholdsPrune:
+ * @thresholds: set of rules
+ * @before: time in microseconds
+ *
+ * Forgets the state of fields not evaluated since @before, typically of
+ * domains which do not exist any more.
+ */
+void
+virtDBusThresholdsPrune(virtDBusThresholds *thresholds,
+                        gint64 before)
+{
+    GHashTableIter iter;
+    virtDBusThresholdState *state;
+
+    g_hash_table_iter_init(&iter, thresholds->states);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&state)) {
+        if (state->seen < before)
+            g_hash_table_iter_remove(&iter);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "util.h"
+
+typedef struct _virtDBusThresholds virtDBusThresholds;
+
+typedef void
+(*virtDBusThresholdsCrossedFunc)(const gchar *owner,
+                                 const gchar *object,
+                                 guint id,
+                                 const gchar *field,
+                                 gdouble value,
+                                 gboolean crossed,
+                                 gpointer opaque);
+
+virtDBusThresholds *
+virtDBusThresholdsNew(void);
+
+void
+virtDBusThresholdsFree(virtDBusThresholds *thresholds);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusThresholds, virtDBusThresholdsFree);
+
+guint
+virtDBusThresholdsAdd(virtDBusThresholds *thresholds,
+                      const gchar *owner,
+                      const gchar *metric,
+                      const gchar *comparison,
+                      gdouble threshold,
+                      guint hold,
+                      GError **error);
+
+gboolean
+virtDBusThresholdsRemove(virtDBusThresholds *thresholds,
+                         const gchar *owner,
+                         guint id,
+                         GError **error);
+
+void
+virtDBusThresholdsRemoveOwner(virtDBusThresholds *thresholds,
+                              const gchar *owner);
+
+guint
+virtDBusThresholdsCount(virtDBusThresholds *thresholds);
+
+gchar **
+virtDBusThresholdsGetMetrics(virtDBusThresholds *thresholds);
+
+void
+virtDBusThresholdsEvaluate(virtDBusThresholds *thresholds,
+                           const gchar *object,
+                           GVariant *record,
+                           gint64 now,
+                           virtDBusThresholdsCrossedFunc func,
+                           gpointer opaque);
+
+void
+virtDBusThresholdsPrune(virtDBusThresholds *thresholds,
+                        gint64 before);
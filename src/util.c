@@ -12,6 +12,40 @@ static const GDBusErrorEntry virtDBusUtilErrorEntries[] = {
 
 G_STATIC_ASSERT(G_N_ELEMENTS(virtDBusUtilErrorEntries) == VIRT_DBUS_N_ERRORS);
 
+/* Flags of virConnectGetAllDomainStats and virDomainListGetStats. */
+#if LIBVIR_CHECK_VERSION(4, 5, 0)
+# define VIRT_DBUS_UTIL_STATS_NOWAIT VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT
+#else
+# define VIRT_DBUS_UTIL_STATS_NOWAIT 0
+#endif
+#define VIRT_DBUS_UTIL_LIBVIRT_STATS_FLAGS \
+    (VIR_CONNECT_GET_ALL_DOMAINS_STATS_ACTIVE | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_INACTIVE | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_PERSISTENT | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_TRANSIENT | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_RUNNING | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_PAUSED | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_SHUTOFF | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_OTHER | \
+     VIRT_DBUS_UTIL_STATS_NOWAIT | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING | \
+     VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS)
+
+/* Flags of virDomainGetHostname. */
+#if LIBVIR_CHECK_VERSION(6, 1, 0)
+# define VIRT_DBUS_UTIL_LIBVIRT_HOSTNAME_FLAGS \
+    (VIR_DOMAIN_GET_HOSTNAME_LEASE | \
+     VIR_DOMAIN_GET_HOSTNAME_AGENT)
+#else
+# define VIRT_DBUS_UTIL_LIBVIRT_HOSTNAME_FLAGS 0
+#endif
+
+/* The flags reserved by us, see util.h. */
+G_STATIC_ASSERT((VIRT_DBUS_STATS_STALE & VIRT_DBUS_UTIL_LIBVIRT_STATS_FLAGS) == 0);
+G_STATIC_ASSERT((VIRT_DBUS_STATS_RATES & VIRT_DBUS_UTIL_LIBVIRT_STATS_FLAGS) == 0);
+G_STATIC_ASSERT((VIRT_DBUS_STATS_RATES & VIRT_DBUS_STATS_STALE) == 0);
+G_STATIC_ASSERT((VIRT_DBUS_DOMAIN_AGENT_STALE & VIRT_DBUS_UTIL_LIBVIRT_HOSTNAME_FLAGS) == 0);
+
 GQuark
 virtDBusErrorQuark(void)
 {
@@ -29,47 +63,119 @@ virtDBusUtilTypedParamsClear(virtDBusUtilTypedParams *params)
     virTypedParamsFree(params->params, params->nparams);
 }
 
+/**
+ * virtDBusUtilFieldMatches:
+ * @pattern: field name pattern where '*' matches any sequence of characters
+ * @field: field name
+ *
+ * Returns TRUE if @field matches @pattern, for example "block.*.rd.bytes"
+ * matches "block.0.rd.bytes".
+ */
+gboolean
+virtDBusUtilFieldMatches(const gchar *pattern,
+                         const gchar *field)
+{
+    const gchar *star = NULL;
+    const gchar *resume = NULL;
+
+    while (*field) {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = field;
+        } else if (*pattern == *field) {
+            pattern++;
+            field++;
+        } else if (star) {
+            pattern = star + 1;
+            field = ++resume;
+        } else {
+            return FALSE;
+        }
+    }
+
+    while (*pattern == '*')
+        pattern++;
+
+    return !*pattern;
+}
+
+/**
+ * virtDBusUtilFieldSelected:
+ * @fields: NULL-terminated list of patterns, see virtDBusUtilFieldMatches()
+ * @field: name of a field
+ *
+ * Returns TRUE if @field matches any of @fields or if @fields is NULL or
+ * empty.
+ */
+gboolean
+virtDBusUtilFieldSelected(const gchar *const *fields,
+                          const gchar *field)
+{
+    if (!fields || !fields[0])
+        return TRUE;
+
+    for (gint i = 0; fields[i]; i++) {
+        if (virtDBusUtilFieldMatches(fields[i], field))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * virtDBusUtilTypedParamsToGVariant:
+ * @params: typed parameters
+ * @nparams: number of @params
+ * @fields: NULL-terminated list of patterns of fields to convert, see
+ *   virtDBusUtilFieldMatches(), NULL or empty list converts all of them
+ *
+ * Returns floating a{sv} dictionary.
+ */
 GVariant *
 virtDBusUtilTypedParamsToGVariant(virTypedParameterPtr params,
-                                  gint nparams)
+                                  gint nparams,
+                                  const gchar *const *fields)
 {
-    GVariantBuilder builder;
-
-    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_autofree GVariant **entries = g_new(GVariant *, MAX(nparams, 1));
+    gint nentries = 0;
 
+    /* The entries are collected into a single array sized up front rather
+     * than through GVariantBuilder which grows its array as it goes. */
     for (gint i = 0; i < nparams; i++) {
         GVariant *value = NULL;
 
+        if (!virtDBusUtilFieldSelected(fields, params[i].field))
+            continue;
+
         switch (params[i].type) {
         case VIR_TYPED_PARAM_INT:
-            value = g_variant_new("i", params[i].value.i);
+            value = g_variant_new_int32(params[i].value.i);
             break;
         case VIR_TYPED_PARAM_UINT:
-            value = g_variant_new("u", params[i].value.ui);
+            value = g_variant_new_uint32(params[i].value.ui);
             break;
         case VIR_TYPED_PARAM_LLONG:
-            value = g_variant_new("x", params[i].value.l);
+            value = g_variant_new_int64(params[i].value.l);
             break;
         case VIR_TYPED_PARAM_ULLONG:
-            value = g_variant_new("t", params[i].value.ul);
+            value = g_variant_new_uint64(params[i].value.ul);
             break;
         case VIR_TYPED_PARAM_DOUBLE:
-            value = g_variant_new("d", params[i].value.d);
+            value = g_variant_new_double(params[i].value.d);
             break;
         case VIR_TYPED_PARAM_BOOLEAN:
-            value = g_variant_new("b", params[i].value.b);
+            value = g_variant_new_boolean(params[i].value.b);
             break;
         case VIR_TYPED_PARAM_STRING:
-            value = g_variant_new("s", params[i].value.s);
+            value = g_variant_new_string(params[i].value.s);
             break;
         }
 
-        g_variant_builder_add(&builder, "{sv}",
-                              params[i].field,
-                              g_variant_new_variant(value));
+        entries[nentries++] = g_variant_new_dict_entry(g_variant_new_string(params[i].field),
+                                                       g_variant_new_variant(value));
     }
 
-    return g_variant_builder_end(&builder);
+    return g_variant_new_array(G_VARIANT_TYPE("{sv}"), entries, nentries);
 }
 
 gboolean
@@ -249,6 +355,91 @@ virtDBusUtilDecodeStr(const gchar *str)
     return ret;
 }
 
+static const gchar *
+virtDBusUtilBusPathSuffix(const gchar *path,
+                          const gchar *prefixPath,
+                          GError **error)
+{
+    gsize prefixLen = strlen(prefixPath);
+
+    if (!g_str_has_prefix(path, prefixPath) ||
+        path[prefixLen] != '/' || path[prefixLen + 1] == 0) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                    "invalid object path '%s'", path);
+        return NULL;
+    }
+
+    return path + prefixLen + 1;
+}
+
+/**
+ * virtDBusUtilUUIDFromBusPath:
+ * @path: object path of an UUID based object
+ * @prefixPath: object path of the subtree the object belongs to
+ * @uuid: return location of VIR_UUID_STRING_BUFLEN bytes
+ * @error: return location for error
+ *
+ * Decodes the UUID encoded in @path without asking libvirt.
+ *
+ * Returns TRUE on success, FALSE if @path does not encode an UUID.
+ */
+gboolean
+virtDBusUtilUUIDFromBusPath(const gchar *path,
+                            const gchar *prefixPath,
+                            gchar *uuid,
+                            GError **error)
+{
+    const gchar *suffix = virtDBusUtilBusPathSuffix(path, prefixPath, error);
+
+    if (!suffix)
+        return FALSE;
+
+    if (strlen(suffix) != VIRT_DBUS_UUID_LEN || suffix[0] != '_') {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                    "invalid object path '%s'", path);
+        return FALSE;
+    }
+
+    for (gint i = 1; i < VIRT_DBUS_UUID_LEN; i++) {
+        if (suffix[i] == '_') {
+            uuid[i - 1] = '-';
+        } else if (g_ascii_isxdigit(suffix[i])) {
+            uuid[i - 1] = suffix[i];
+        } else {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                        "invalid object path '%s'", path);
+            return FALSE;
+        }
+    }
+    uuid[VIRT_DBUS_UUID_LEN - 1] = 0;
+
+    return TRUE;
+}
+
+/**
+ * virtDBusUtilNameFromBusPath:
+ * @path: object path of a name based object
+ * @prefixPath: object path of the subtree the object belongs to
+ * @error: return location for error
+ *
+ * Decodes the name, key or MAC address encoded in @path without asking
+ * libvirt.
+ *
+ * Returns newly allocated string or NULL if @path is invalid.
+ */
+gchar *
+virtDBusUtilNameFromBusPath(const gchar *path,
+                            const gchar *prefixPath,
+                            GError **error)
+{
+    const gchar *suffix = virtDBusUtilBusPathSuffix(path, prefixPath, error);
+
+    if (!suffix)
+        return NULL;
+
+    return virtDBusUtilDecodeStr(suffix);
+}
+
 gchar *
 virtDBusUtilBusPathForVirDomain(virDomainPtr domain,
                                 const gchar *domainPath)
@@ -576,3 +767,699 @@ virtDBusUtilVirStorageVolListFree(virStorageVolPtr *storageVols)
 
     g_free(storageVols);
 }
+
+/* Upper bound of cached handles, objects without lifecycle events are
+ * never invalidated individually so the oldest handles are dropped. */
+#define VIRT_DBUS_UTIL_HANDLE_CACHE_MAX 4096
+
+struct _virtDBusUtilHandleCacheEntry {
+    gpointer handle;
+    virConnectPtr connection;
+    const gchar *key;
+    GList link;
+};
+typedef struct _virtDBusUtilHandleCacheEntry virtDBusUtilHandleCacheEntry;
+
+struct _virtDBusUtilHandleCache {
+    GMutex lock;
+    GHashTable *entries;
+    GQueue order;
+    guint generation;
+    virtDBusUtilHandleRefFunc refFunc;
+    virtDBusUtilHandleFreeFunc freeFunc;
+};
+
+static void
+virtDBusUtilHandleCacheEntryFree(gpointer opaque,
+                                 gpointer userData)
+{
+    virtDBusUtilHandleCacheEntry *entry = opaque;
+    virtDBusUtilHandleCache *cache = userData;
+
+    cache->freeFunc(entry->handle);
+    g_free(entry);
+}
+
+static gboolean
+virtDBusUtilHandleCacheEntryRemove(gpointer key G_GNUC_UNUSED,
+                                   gpointer value,
+                                   gpointer userData)
+{
+    virtDBusUtilHandleCacheEntryFree(value, userData);
+    return TRUE;
+}
+
+/* Has to be called with the cache lock held. */
+static void
+virtDBusUtilHandleCacheDrop(virtDBusUtilHandleCache *cache,
+                            virtDBusUtilHandleCacheEntry *entry)
+{
+    g_queue_unlink(&cache->order, &entry->link);
+    g_hash_table_remove(cache->entries, entry->key);
+    virtDBusUtilHandleCacheEntryFree(entry, cache);
+}
+
+/**
+ * virtDBusUtilHandleCacheNew:
+ * @refFunc: function adding a reference to a handle, e.g. virDomainRef
+ * @freeFunc: function releasing a reference of a handle, e.g. virDomainFree
+ *
+ * Creates a cache mapping object paths to libvirt object handles so
+ * repeated calls on the same object do not need a lookup RPC.
+ *
+ * Returns a new cache.
+ */
+virtDBusUtilHandleCache *
+virtDBusUtilHandleCacheNew(virtDBusUtilHandleRefFunc refFunc,
+                           virtDBusUtilHandleFreeFunc freeFunc)
+{
+    virtDBusUtilHandleCache *cache = g_new0(virtDBusUtilHandleCache, 1);
+
+    g_mutex_init(&cache->lock);
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, NULL);
+    g_queue_init(&cache->order);
+    cache->refFunc = refFunc;
+    cache->freeFunc = freeFunc;
+
+    return cache;
+}
+
+void
+virtDBusUtilHandleCacheFree(virtDBusUtilHandleCache *cache)
+{
+    if (!cache)
+        return;
+
+    virtDBusUtilHandleCacheClear(cache);
+    g_hash_table_unref(cache->entries);
+    g_mutex_clear(&cache->lock);
+    g_free(cache);
+}
+
+/**
+ * virtDBusUtilHandleCacheLookup:
+ * @cache: handle cache
+ * @path: object path
+ * @connection: the current libvirt connection
+ * @generation: return location for the cache generation
+ *
+ * Looks up a handle cached for @path.  Handles obtained through a
+ * different connection than @connection are dropped.  The @generation
+ * has to be passed to virtDBusUtilHandleCacheInsert() when the handle is
+ * looked up from libvirt after a miss.
+ *
+ * Returns a new reference of the handle or NULL.
+ */
+gpointer
+virtDBusUtilHandleCacheLookup(virtDBusUtilHandleCache *cache,
+                              const gchar *path,
+                              virConnectPtr connection,
+                              guint *generation)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    virtDBusUtilHandleCacheEntry *entry;
+
+    *generation = cache->generation;
+
+    entry = g_hash_table_lookup(cache->entries, path);
+    if (!entry)
+        return NULL;
+
+    if (entry->connection != connection) {
+        virtDBusUtilHandleCacheDrop(cache, entry);
+        return NULL;
+    }
+
+    cache->refFunc(entry->handle);
+
+    return entry->handle;
+}
+
+/**
+ * virtDBusUtilHandleCacheInsert:
+ * @cache: handle cache
+ * @path: object path
+ * @connection: libvirt connection @handle was looked up with
+ * @handle: the handle, the cache takes its own reference
+ * @generation: generation returned by virtDBusUtilHandleCacheLookup()
+ *
+ * Stores @handle for @path unless the cache was invalidated since the
+ * lookup which returned @generation.  The oldest handle is dropped if the
+ * cache is full.
+ */
+void
+virtDBusUtilHandleCacheInsert(virtDBusUtilHandleCache *cache,
+                              const gchar *path,
+                              virConnectPtr connection,
+                              gpointer handle,
+                              guint generation)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    virtDBusUtilHandleCacheEntry *entry;
+    gchar *key;
+
+    if (generation != cache->generation)
+        return;
+
+    entry = g_hash_table_lookup(cache->entries, path);
+    if (entry)
+        virtDBusUtilHandleCacheDrop(cache, entry);
+
+    key = g_strdup(path);
+
+    if (g_hash_table_size(cache->entries) >= VIRT_DBUS_UTIL_HANDLE_CACHE_MAX)
+        virtDBusUtilHandleCacheDrop(cache, g_queue_peek_head(&cache->order));
+
+    entry = g_new0(virtDBusUtilHandleCacheEntry, 1);
+    cache->refFunc(handle);
+    entry->handle = handle;
+    entry->connection = connection;
+    entry->key = key;
+    entry->link.data = entry;
+
+    g_queue_push_tail_link(&cache->order, &entry->link);
+    g_hash_table_insert(cache->entries, key, entry);
+}
+
+/**
+ * virtDBusUtilHandleCacheRemove:
+ * @cache: handle cache
+ * @path: object path
+ *
+ * Drops the handle cached for @path, used when the object changes or
+ * disappears.
+ */
+void
+virtDBusUtilHandleCacheRemove(virtDBusUtilHandleCache *cache,
+                              const gchar *path)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    virtDBusUtilHandleCacheEntry *entry;
+
+    cache->generation++;
+
+    entry = g_hash_table_lookup(cache->entries, path);
+    if (entry)
+        virtDBusUtilHandleCacheDrop(cache, entry);
+}
+
+void
+virtDBusUtilHandleCacheClear(virtDBusUtilHandleCache *cache)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+
+    cache->generation++;
+
+    g_queue_init(&cache->order);
+    g_hash_table_foreach_remove(cache->entries,
+                                virtDBusUtilHandleCacheEntryRemove,
+                                cache);
+}
+
+/* Upper bound of the total size of cached XML descriptions in bytes. */
+#define VIRT_DBUS_UTIL_XML_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+struct _virtDBusUtilXMLCacheEntry {
+    gchar *xml;
+    gsize size;
+    gint64 timestamp;
+    const gchar *key;
+    GList link;
+};
+typedef struct _virtDBusUtilXMLCacheEntry virtDBusUtilXMLCacheEntry;
+
+struct _virtDBusUtilXMLCache {
+    GMutex lock;
+    GHashTable *entries;
+    GQueue order;
+    gsize size;
+    guint generation;
+    gint64 maxAge;
+};
+
+static void
+virtDBusUtilXMLCacheEntryFree(gpointer opaque)
+{
+    virtDBusUtilXMLCacheEntry *entry = opaque;
+
+    g_free(entry->xml);
+    g_free(entry);
+}
+
+/* Entries are keyed by "path flags" so that all entries of one object
+ * share the path prefix. */
+static gchar *
+virtDBusUtilXMLCacheKey(const gchar *path,
+                        guint flags)
+{
+    return g_strdup_printf("%s %u", path, flags);
+}
+
+/* Has to be called with the cache lock held, before the entry is removed
+ * from the table. */
+static void
+virtDBusUtilXMLCacheUnlink(virtDBusUtilXMLCache *cache,
+                           virtDBusUtilXMLCacheEntry *entry)
+{
+    cache->size -= entry->size;
+    g_queue_unlink(&cache->order, &entry->link);
+}
+
+static gboolean
+virtDBusUtilXMLCacheKeyMatches(const gchar *key,
+                               const gchar *path)
+{
+    gsize len = strlen(path);
+
+    return strncmp(key, path, len) == 0 && key[len] == ' ';
+}
+
+/**
+ * virtDBusUtilXMLCacheNew:
+ * @maxAge: time in microseconds after which entries are not used anymore
+ *
+ * Creates a cache of XML descriptions of objects keyed by object path
+ * and flags.  Entries have to be removed whenever the object changes,
+ * @maxAge bounds the staleness of changes we are not notified about.
+ *
+ * Returns a new cache.
+ */
+virtDBusUtilXMLCache *
+virtDBusUtilXMLCacheNew(gint64 maxAge)
+{
+    virtDBusUtilXMLCache *cache = g_new0(virtDBusUtilXMLCache, 1);
+
+    g_mutex_init(&cache->lock);
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           virtDBusUtilXMLCacheEntryFree);
+    g_queue_init(&cache->order);
+    cache->maxAge = maxAge;
+
+    return cache;
+}
+
+void
+virtDBusUtilXMLCacheFree(virtDBusUtilXMLCache *cache)
+{
+    if (!cache)
+        return;
+
+    g_hash_table_unref(cache->entries);
+    g_mutex_clear(&cache->lock);
+    g_free(cache);
+}
+
+/**
+ * virtDBusUtilXMLCacheLookup:
+ * @cache: XML cache
+ * @path: object path
+ * @flags: flags the description was requested with
+ * @generation: return location for the cache generation
+ *
+ * Looks up the XML description of @path cached for @flags.  The
+ * @generation has to be passed to virtDBusUtilXMLCacheInsert() when the
+ * description is read from libvirt after a miss.
+ *
+ * Returns a copy of the cached description or NULL.
+ */
+gchar *
+virtDBusUtilXMLCacheLookup(virtDBusUtilXMLCache *cache,
+                           const gchar *path,
+                           guint flags,
+                           guint *generation)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    g_autofree gchar *key = virtDBusUtilXMLCacheKey(path, flags);
+    virtDBusUtilXMLCacheEntry *entry;
+
+    *generation = cache->generation;
+
+    entry = g_hash_table_lookup(cache->entries, key);
+    if (!entry)
+        return NULL;
+
+    if (g_get_monotonic_time() - entry->timestamp >= cache->maxAge) {
+        virtDBusUtilXMLCacheUnlink(cache, entry);
+        g_hash_table_remove(cache->entries, key);
+        return NULL;
+    }
+
+    return g_strdup(entry->xml);
+}
+
+/**
+ * virtDBusUtilXMLCacheInsert:
+ * @cache: XML cache
+ * @path: object path
+ * @flags: flags the description was requested with
+ * @xml: the XML description
+ * @generation: generation returned by virtDBusUtilXMLCacheLookup()
+ *
+ * Stores a copy of @xml unless the cache was invalidated since the
+ * lookup which returned @generation.  The oldest entries are dropped to
+ * keep the cache within its size limit, descriptions exceeding the limit
+ * on their own are not stored.
+ */
+void
+virtDBusUtilXMLCacheInsert(virtDBusUtilXMLCache *cache,
+                           const gchar *path,
+                           guint flags,
+                           const gchar *xml,
+                           guint generation)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    virtDBusUtilXMLCacheEntry *entry;
+    gchar *key;
+    gsize size;
+
+    if (generation != cache->generation)
+        return;
+
+    key = virtDBusUtilXMLCacheKey(path, flags);
+    size = strlen(xml) + strlen(key);
+
+    /* The previous description is outdated even if the new one is not
+     * stored. */
+    entry = g_hash_table_lookup(cache->entries, key);
+    if (entry) {
+        virtDBusUtilXMLCacheUnlink(cache, entry);
+        g_hash_table_remove(cache->entries, key);
+    }
+
+    if (size > VIRT_DBUS_UTIL_XML_CACHE_MAX_SIZE) {
+        g_free(key);
+        return;
+    }
+
+    while (cache->size + size > VIRT_DBUS_UTIL_XML_CACHE_MAX_SIZE) {
+        virtDBusUtilXMLCacheEntry *oldest = g_queue_peek_head(&cache->order);
+
+        virtDBusUtilXMLCacheUnlink(cache, oldest);
+        g_hash_table_remove(cache->entries, oldest->key);
+    }
+
+    entry = g_new0(virtDBusUtilXMLCacheEntry, 1);
+    entry->xml = g_strdup(xml);
+    entry->size = size;
+    entry->timestamp = g_get_monotonic_time();
+    entry->key = key;
+    entry->link.data = entry;
+
+    cache->size += size;
+    g_queue_push_tail_link(&cache->order, &entry->link);
+    g_hash_table_insert(cache->entries, key, entry);
+}
+
+/**
+ * virtDBusUtilXMLCacheRemove:
+ * @cache: XML cache
+ * @path: object path
+ *
+ * Drops all descriptions cached for @path, used when the object changes
+ * or disappears.
+ */
+void
+virtDBusUtilXMLCacheRemove(virtDBusUtilXMLCache *cache,
+                           const gchar *path)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    cache->generation++;
+
+    g_hash_table_iter_init(&iter, cache->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        virtDBusUtilXMLCacheEntry *entry = value;
+
+        if (!virtDBusUtilXMLCacheKeyMatches(key, path))
+            continue;
+
+        virtDBusUtilXMLCacheUnlink(cache, entry);
+        g_hash_table_iter_remove(&iter);
+    }
+}
+
+void
+virtDBusUtilXMLCacheClear(virtDBusUtilXMLCache *cache)
+{
+    virtDBusUtilAutoLock lock = g_mutex_locker_new(&cache->lock);
+
+    cache->generation++;
+    cache->size = 0;
+
+    g_queue_init(&cache->order);
+    g_hash_table_remove_all(cache->entries);
+}
+
+typedef enum {
+    VIRT_DBUS_UTIL_FAN_OUT_QUEUED,
+    VIRT_DBUS_UTIL_FAN_OUT_RUNNING,
+    VIRT_DBUS_UTIL_FAN_OUT_DONE,
+} virtDBusUtilFanOutState;
+
+typedef struct _virtDBusUtilFanOut virtDBusUtilFanOut;
+
+struct _virtDBusUtilFanOutTask {
+    virtDBusUtilFanOut *fanOut;
+    guint index;
+};
+typedef struct _virtDBusUtilFanOutTask virtDBusUtilFanOutTask;
+
+struct _virtDBusUtilFanOut {
+    gint refs;
+    GMutex lock;
+    GCond cond;
+    gpointer *items;
+    GDestroyNotify itemsFree;
+    gpointer *results;
+    GDestroyNotify resultFree;
+    virtDBusUtilFanOutTask *tasks;
+    virtDBusUtilFanOutState *states;
+    guint pending;
+    gboolean abandoned;
+    virtDBusUtilFanOutFunc func;
+    gpointer userData;
+};
+
+/* All fan-outs share one pool so that concurrent callers together never
+ * run more than VIRT_DBUS_UTIL_FAN_OUT_MAX_THREADS items.  Items that were
+ * still running when their caller gave up are skipped by later fan-outs
+ * until they expire or are forgotten, see virtDBusUtilFanOutForget(). */
+static GMutex fanOutLock;
+static GThreadPool *fanOutPool = NULL;
+static GHashTable *fanOutTimedOut = NULL;
+
+static void
+virtDBusUtilFanOutUnref(virtDBusUtilFanOut *fanOut)
+{
+    if (!g_atomic_int_dec_and_test(&fanOut->refs))
+        return;
+
+    if (fanOut->itemsFree)
+        fanOut->itemsFree(fanOut->items);
+    g_free(fanOut->tasks);
+    g_free(fanOut->states);
+    g_mutex_clear(&fanOut->lock);
+    g_cond_clear(&fanOut->cond);
+    g_free(fanOut);
+}
+
+static void
+virtDBusUtilFanOutThread(gpointer opaque,
+                         gpointer userData G_GNUC_UNUSED)
+{
+    virtDBusUtilFanOutTask *task = opaque;
+    virtDBusUtilFanOut *fanOut = task->fanOut;
+    guint i = task->index;
+    gboolean abandoned;
+    gpointer result = NULL;
+
+    /* Items of abandoned fan-outs which did not start yet are not
+     * processed at all so they do not hold up the shared pool. */
+    g_mutex_lock(&fanOut->lock);
+    abandoned = fanOut->abandoned;
+    if (!abandoned)
+        fanOut->states[i] = VIRT_DBUS_UTIL_FAN_OUT_RUNNING;
+    g_mutex_unlock(&fanOut->lock);
+
+    if (!abandoned)
+        result = fanOut->func(fanOut->items[i], fanOut->userData);
+
+    g_mutex_lock(&fanOut->lock);
+    fanOut->states[i] = VIRT_DBUS_UTIL_FAN_OUT_DONE;
+    if (fanOut->abandoned) {
+        if (result)
+            fanOut->resultFree(result);
+    } else {
+        fanOut->results[i] = result;
+        fanOut->pending--;
+        g_cond_signal(&fanOut->cond);
+    }
+    g_mutex_unlock(&fanOut->lock);
+
+    virtDBusUtilFanOutUnref(fanOut);
+}
+
+/* Has to be called with the fan-out lock held. */
+static gboolean
+virtDBusUtilFanOutIsTimedOut(const gchar *key,
+                             gint64 now)
+{
+    gint64 *expires;
+
+    if (!key || !fanOutTimedOut)
+        return FALSE;
+
+    expires = g_hash_table_lookup(fanOutTimedOut, key);
+    if (!expires)
+        return FALSE;
+
+    if (now < *expires)
+        return TRUE;
+
+    g_hash_table_remove(fanOutTimedOut, key);
+    return FALSE;
+}
+
+/**
+ * virtDBusUtilFanOut:
+ * @items: array of items to process, the function takes ownership
+ * @nitems: number of items
+ * @itemsFree: function freeing @items once no worker uses them anymore
+ * @func: function called for every item in a worker thread
+ * @keyFunc: function returning a unique name of an item
+ * @resultFree: function freeing a result of @func
+ * @userData: data passed to @func and @keyFunc
+ * @timeout: time in microseconds to wait for the results
+ * @partial: return location for whether any item timed out
+ *
+ * Calls @func for every item of @items in the shared fan-out pool.  Items
+ * which are not processed within @timeout are left to finish in the
+ * background, their results are dropped.  Items that were already running
+ * at that point are skipped by later calls for
+ * VIRT_DBUS_UTIL_FAN_OUT_TIMED_OUT_TTL or until virtDBusUtilFanOutForget()
+ * is called with their key.
+ *
+ * Returns an array of @nitems results, NULL for items which failed, timed
+ * out or were skipped.  @partial is set to TRUE if any item timed out.
+ */
+gpointer *
+virtDBusUtilFanOut(gpointer *items,
+                   guint nitems,
+                   GDestroyNotify itemsFree,
+                   virtDBusUtilFanOutFunc func,
+                   virtDBusUtilFanOutKeyFunc keyFunc,
+                   GDestroyNotify resultFree,
+                   gpointer userData,
+                   gint64 timeout,
+                   gboolean *partial)
+{
+    virtDBusUtilFanOut *fanOut = g_new0(virtDBusUtilFanOut, 1);
+    gint64 now = g_get_monotonic_time();
+    gint64 deadline = now + timeout;
+    g_autoptr(GPtrArray) keys = g_ptr_array_new_full(nitems, g_free);
+    gpointer *ret;
+
+    g_mutex_init(&fanOut->lock);
+    g_cond_init(&fanOut->cond);
+    fanOut->refs = 1;
+    fanOut->items = items;
+    fanOut->itemsFree = itemsFree;
+    fanOut->results = g_new0(gpointer, MAX(nitems, 1));
+    fanOut->resultFree = resultFree;
+    fanOut->tasks = g_new0(virtDBusUtilFanOutTask, MAX(nitems, 1));
+    fanOut->states = g_new0(virtDBusUtilFanOutState, MAX(nitems, 1));
+    fanOut->func = func;
+    fanOut->userData = userData;
+
+    *partial = FALSE;
+
+    for (guint i = 0; i < nitems; i++)
+        g_ptr_array_add(keys, keyFunc(items[i], userData));
+
+    g_mutex_lock(&fanOutLock);
+    if (!fanOutPool) {
+        fanOutPool = g_thread_pool_new(virtDBusUtilFanOutThread, NULL,
+                                       VIRT_DBUS_UTIL_FAN_OUT_MAX_THREADS,
+                                       FALSE, NULL);
+    }
+
+    for (guint i = 0; i < nitems; i++) {
+        fanOut->tasks[i].fanOut = fanOut;
+        fanOut->tasks[i].index = i;
+
+        if (virtDBusUtilFanOutIsTimedOut(g_ptr_array_index(keys, i), now)) {
+            fanOut->states[i] = VIRT_DBUS_UTIL_FAN_OUT_DONE;
+            continue;
+        }
+
+        fanOut->pending++;
+        g_atomic_int_inc(&fanOut->refs);
+        if (fanOutPool)
+            g_thread_pool_push(fanOutPool, &fanOut->tasks[i], NULL);
+    }
+    g_mutex_unlock(&fanOutLock);
+
+    if (!fanOutPool) {
+        for (guint i = 0; i < nitems; i++) {
+            if (fanOut->states[i] == VIRT_DBUS_UTIL_FAN_OUT_QUEUED)
+                virtDBusUtilFanOutThread(&fanOut->tasks[i], NULL);
+        }
+    }
+
+    g_mutex_lock(&fanOut->lock);
+    while (fanOut->pending > 0) {
+        if (!g_cond_wait_until(&fanOut->cond, &fanOut->lock, deadline)) {
+            *partial = TRUE;
+            break;
+        }
+    }
+    fanOut->abandoned = TRUE;
+    ret = g_steal_pointer(&fanOut->results);
+
+    if (*partial) {
+        gint64 expires = g_get_monotonic_time() + VIRT_DBUS_UTIL_FAN_OUT_TIMED_OUT_TTL;
+
+        g_mutex_lock(&fanOutLock);
+        if (!fanOutTimedOut) {
+            fanOutTimedOut = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   g_free, g_free);
+        }
+        for (guint i = 0; i < nitems; i++) {
+            const gchar *key = g_ptr_array_index(keys, i);
+            gint64 *value;
+
+            if (fanOut->states[i] != VIRT_DBUS_UTIL_FAN_OUT_RUNNING || !key)
+                continue;
+
+            value = g_new(gint64, 1);
+            *value = expires;
+            g_hash_table_replace(fanOutTimedOut, g_strdup(key), value);
+        }
+        g_mutex_unlock(&fanOutLock);
+    }
+    g_mutex_unlock(&fanOut->lock);
+
+    virtDBusUtilFanOutUnref(fanOut);
+
+    return ret;
+}
+
+/**
+ * virtDBusUtilFanOutForget:
+ * @key: key of an item, see virtDBusUtilFanOut()
+ *
+ * Lets the next fan-out process the item again even if it timed out
+ * recently, typically because an event shows it responds again.
+ */
+void
+virtDBusUtilFanOutForget(const gchar *key)
+{
+    g_mutex_lock(&fanOutLock);
+    if (fanOutTimedOut)
+        g_hash_table_remove(fanOutTimedOut, key);
+    g_mutex_unlock(&fanOutLock);
+}
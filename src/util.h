@@ -18,6 +18,31 @@ typedef enum {
 GQuark
 virtDBusErrorQuark(void);
 
+/*
+ * Flags of D-Bus methods which are handled by libvirt-dbus and never passed
+ * to libvirt.  They are taken from high bits libvirt does not use for the
+ * wrapped APIs and util.c checks them against the libvirt flag enums.  The
+ * values are part of the D-Bus API so they must never change.
+ */
+
+/* GetState reads the state from libvirt instead of the state cache.
+ * virDomainGetState defines no flags so there is nothing to check. */
+#define VIRT_DBUS_DOMAIN_GET_STATE_LIVE (1 << 30)
+
+/* The stats methods accept values of busy domains from their last complete
+ * sample instead of waiting for their jobs, see
+ * virtDBusStatsRecordToGVariant(). */
+#define VIRT_DBUS_STATS_STALE (1 << 26)
+
+/* The stats methods add rates derived from counters, see
+ * virtDBusStatsRecordToGVariant(). */
+#define VIRT_DBUS_STATS_RATES (1 << 27)
+
+/* The cached guest agent methods of Domain accept results up to
+ * VIRT_DBUS_DOMAIN_AGENT_CACHE_MAX_STALENESS old.  Only GetHostname of
+ * them has libvirt flags. */
+#define VIRT_DBUS_DOMAIN_AGENT_STALE (1 << 27)
+
 struct _virtDBusUtilTypedParams {
     virTypedParameterPtr params;
     gint nparams;
@@ -29,9 +54,18 @@ virtDBusUtilTypedParamsClear(virtDBusUtilTypedParams *params);
 
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(virtDBusUtilTypedParams, virtDBusUtilTypedParamsClear);
 
+gboolean
+virtDBusUtilFieldMatches(const gchar *pattern,
+                         const gchar *field) G_GNUC_PURE;
+
+gboolean
+virtDBusUtilFieldSelected(const gchar *const *fields,
+                          const gchar *field) G_GNUC_PURE;
+
 GVariant *
 virtDBusUtilTypedParamsToGVariant(virTypedParameterPtr params,
-                                  gint nparams);
+                                  gint nparams,
+                                  const gchar *const *fields);
 
 gboolean
 virtDBusUtilGVariantToTypedParams(GVariantIter *iter,
@@ -48,6 +82,17 @@ virtDBusUtilEncodeStr(const gchar *str);
 gchar *
 virtDBusUtilDecodeStr(const gchar *str);
 
+gboolean
+virtDBusUtilUUIDFromBusPath(const gchar *path,
+                            const gchar *prefixPath,
+                            gchar *uuid,
+                            GError **error);
+
+gchar *
+virtDBusUtilNameFromBusPath(const gchar *path,
+                            const gchar *prefixPath,
+                            GError **error);
+
 gchar *
 virtDBusUtilBusPathForVirDomain(virDomainPtr domain,
                                 const gchar *domainPath);
@@ -195,3 +240,93 @@ virtDBusUtilVirStorageVolListFree(virStorageVolPtr *storageVols);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virStorageVol, virStorageVolFree);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virStorageVolPtr,
                               virtDBusUtilVirStorageVolListFree);
+
+typedef gint (*virtDBusUtilHandleRefFunc)(gpointer handle);
+typedef gint (*virtDBusUtilHandleFreeFunc)(gpointer handle);
+
+typedef struct _virtDBusUtilHandleCache virtDBusUtilHandleCache;
+
+virtDBusUtilHandleCache *
+virtDBusUtilHandleCacheNew(virtDBusUtilHandleRefFunc refFunc,
+                           virtDBusUtilHandleFreeFunc freeFunc);
+
+void
+virtDBusUtilHandleCacheFree(virtDBusUtilHandleCache *cache);
+
+gpointer
+virtDBusUtilHandleCacheLookup(virtDBusUtilHandleCache *cache,
+                              const gchar *path,
+                              virConnectPtr connection,
+                              guint *generation);
+
+void
+virtDBusUtilHandleCacheInsert(virtDBusUtilHandleCache *cache,
+                              const gchar *path,
+                              virConnectPtr connection,
+                              gpointer handle,
+                              guint generation);
+
+void
+virtDBusUtilHandleCacheRemove(virtDBusUtilHandleCache *cache,
+                              const gchar *path);
+
+void
+virtDBusUtilHandleCacheClear(virtDBusUtilHandleCache *cache);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusUtilHandleCache, virtDBusUtilHandleCacheFree);
+
+typedef struct _virtDBusUtilXMLCache virtDBusUtilXMLCache;
+
+virtDBusUtilXMLCache *
+virtDBusUtilXMLCacheNew(gint64 maxAge);
+
+void
+virtDBusUtilXMLCacheFree(virtDBusUtilXMLCache *cache);
+
+gchar *
+virtDBusUtilXMLCacheLookup(virtDBusUtilXMLCache *cache,
+                           const gchar *path,
+                           guint flags,
+                           guint *generation);
+
+void
+virtDBusUtilXMLCacheInsert(virtDBusUtilXMLCache *cache,
+                           const gchar *path,
+                           guint flags,
+                           const gchar *xml,
+                           guint generation);
+
+void
+virtDBusUtilXMLCacheRemove(virtDBusUtilXMLCache *cache,
+                           const gchar *path);
+
+void
+virtDBusUtilXMLCacheClear(virtDBusUtilXMLCache *cache);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virtDBusUtilXMLCache, virtDBusUtilXMLCacheFree);
+
+/* Bounds of the parallel listing of nested objects like volumes of all
+ * storage pools, see virtDBusUtilFanOut(). */
+#define VIRT_DBUS_UTIL_FAN_OUT_MAX_THREADS 8
+#define VIRT_DBUS_UTIL_FAN_OUT_TIMEOUT (5 * G_USEC_PER_SEC)
+#define VIRT_DBUS_UTIL_FAN_OUT_TIMED_OUT_TTL (60 * G_USEC_PER_SEC)
+
+typedef gpointer (*virtDBusUtilFanOutFunc)(gpointer item,
+                                           gpointer userData);
+
+typedef gchar *(*virtDBusUtilFanOutKeyFunc)(gpointer item,
+                                            gpointer userData);
+
+gpointer *
+virtDBusUtilFanOut(gpointer *items,
+                   guint nitems,
+                   GDestroyNotify itemsFree,
+                   virtDBusUtilFanOutFunc func,
+                   virtDBusUtilFanOutKeyFunc keyFunc,
+                   GDestroyNotify resultFree,
+                   gpointer userData,
+                   gint64 timeout,
+                   gboolean *partial);
+
+void
+virtDBusUtilFanOutForget(const gchar *key);
@@ -257,6 +257,10 @@ class DomainEventUndefinedDetailType(IntEnum):
     LAST = 2
 
 
+class DomainGetStateFlags(IntEnum):
+    LIVE = 1 << 30
+
+
 class DomainState(IntEnum):
     NOSTATE = 0
     RUNNING = 1
@@ -281,6 +285,11 @@ class NodeDeviceEvent(IntEnum):
     DELETED = 1
 
 
+class StatsFlags(IntEnum):
+    STALE = 1 << 26
+    RATES = 1 << 27
+
+
 class StoragePoolBuildFlags(IntEnum):
     NEW = 0
     REPAIR = 1
@@ -51,6 +51,87 @@ class TestConnect(libvirttest.BaseTestClass):
         path = getattr(self.connect, lookup_method_name)(props[lookup_item])
         assert original_path == path
 
+    def test_connect_batch(self):
+        domain_path = self.connect.ListDomains(0)[0]
+        results = self.connect.Batch([
+            (domain_path, 'org.libvirt.Domain', 'GetXMLDesc', [dbus.UInt32(0)]),
+            (domain_path, dbus.PROPERTIES_IFACE, 'Get', ['org.libvirt.Domain', 'Name']),
+            (domain_path, 'org.libvirt.Domain', 'NoSuchMethod', []),
+        ])
+        assert len(results) == 3
+
+        xml, error_name, _ = results[0]
+        assert error_name == ''
+        assert isinstance(xml[0], dbus.String)
+
+        name, error_name, _ = results[1]
+        assert error_name == ''
+        assert name[0] == 'test'
+
+        _, error_name, _ = results[2]
+        assert error_name == 'org.freedesktop.DBus.Error.UnknownMethod'
+
+    def test_connect_batch_properties(self):
+        domain_path = self.connect.ListDomains(0)[0]
+        results = self.connect.Batch([
+            (domain_path, dbus.PROPERTIES_IFACE, 'Set',
+             ['org.libvirt.Domain', 'Name', dbus.String('foo', variant_level=2)]),
+            (domain_path, dbus.PROPERTIES_IFACE, 'Set',
+             ['org.libvirt.Domain', 'Autostart', dbus.String('yes', variant_level=2)]),
+            (domain_path, dbus.PROPERTIES_IFACE, 'Get',
+             ['org.libvirt.Domain', 'NoSuchProperty']),
+        ])
+
+        _, error_name, _ = results[0]
+        assert error_name == 'org.freedesktop.DBus.Error.PropertyReadOnly'
+
+        _, error_name, _ = results[1]
+        assert error_name == 'org.freedesktop.DBus.Error.InvalidArgs'
+
+        _, error_name, _ = results[2]
+        assert error_name == 'org.freedesktop.DBus.Error.InvalidArgs'
+
+    def test_connect_batch_nested(self):
+        results = self.connect.Batch([
+            (self.connect.object_path, 'org.libvirt.Connect', 'Batch',
+             [dbus.Array([], signature='(osssav)')]),
+        ])
+
+        _, error_name, _ = results[0]
+        assert error_name == 'org.freedesktop.DBus.Error.NotSupported'
+
+    def test_connect_batch_limit(self):
+        domain_path = self.connect.ListDomains(0)[0]
+        calls = [(domain_path, 'org.libvirt.Domain', 'GetXMLDesc', [dbus.UInt32(0)])] * 257
+        with pytest.raises(dbus.exceptions.DBusException) as e:
+            self.connect.Batch(calls)
+        assert e.value.get_dbus_name() == 'org.freedesktop.DBus.Error.LimitsExceeded'
+
+    def test_connect_get_managed_objects(self):
+        obj = self.bus.get_object('org.libvirt', '/org/libvirt/Test')
+        manager = dbus.Interface(obj, 'org.freedesktop.DBus.ObjectManager')
+        objects = manager.GetManagedObjects()
+
+        domain_path = self.connect.ListDomains(0)[0]
+        assert objects[domain_path]['org.libvirt.Domain']['Name'] == 'test'
+
+        for path in self.connect.ListNetworks(0):
+            assert 'org.libvirt.Network' in objects[path]
+
+    def test_connect_interfaces_added(self):
+        def interfaces_added(path, interfaces):
+            assert isinstance(path, dbus.ObjectPath)
+            assert interfaces['org.libvirt.Domain']['Name'] == 'foo'
+            self.loop.quit()
+
+        obj = self.bus.get_object('org.libvirt', '/org/libvirt/Test')
+        manager = dbus.Interface(obj, 'org.freedesktop.DBus.ObjectManager')
+        manager.connect_to_signal('InterfacesAdded', interfaces_added)
+
+        self.connect.DomainDefineXML(xmldata.minimal_domain_xml)
+
+        self.main_loop()
+
     def test_connect_find_storage_pool_sources(self):
         storageType = "logical"
         sources = self.connect.FindStoragePoolSources(storageType, "", 0)
@@ -114,9 +195,86 @@ class TestConnect(libvirttest.BaseTestClass):
             # ensure the path exists by calling Introspect on it
             network.Introspect(dbus_interface=dbus.INTROSPECTABLE_IFACE)
 
+    def test_connect_get_all_domain_stats_page(self):
+        self.connect.DomainDefineXML(xmldata.minimal_domain_xml)
+        names = []
+        cursor = ''
+        while True:
+            records, cursor = self.connect.GetAllDomainStatsPage(0, 0, cursor, 1, [])
+            assert len(records) == 1
+            names.extend(name for name, _ in records)
+            if not cursor:
+                break
+            assert cursor == names[-1]
+        assert names == ['foo', 'test']
+
+    def test_connect_get_all_domain_stats_stale(self):
+        for _, stats in self.connect.GetAllDomainStats(0, 0):
+            assert 'dbus.sample.age' not in stats
+        for _, stats in self.connect.GetAllDomainStats(0, libvirttest.StatsFlags.STALE):
+            assert isinstance(stats['dbus.sample.age'], dbus.UInt64)
+
+    def test_connect_get_domain_stats_list(self):
+        domain_path = self.connect.ListDomains(0)[0]
+        records = self.connect.GetDomainStatsList([domain_path], 0, 0)
+        assert len(records) == 1
+        path, stats = records[0]
+        assert path == domain_path
+        assert isinstance(stats, dbus.Dictionary)
+
+    def test_connect_subscribe_domain_stats(self):
+        domain_path = self.connect.ListDomains(0)[0]
+        subscription = None
+
+        def domain_stats_changed(sub_id, records):
+            assert sub_id == subscription
+            paths = [path for path, _ in records]
+            assert domain_path in paths
+            for _, stats in records:
+                assert all(name.startswith('state.') for name in stats)
+            self.loop.quit()
+
+        self.connect.connect_to_signal('DomainStatsChanged', domain_stats_changed)
+
+        subscription = self.connect.SubscribeDomainStats(1, 100, 0)
+        self.main_loop()
+        self.connect.UnsubscribeDomainStats(subscription)
+
+        with pytest.raises(dbus.exceptions.DBusException):
+            self.connect.UnsubscribeDomainStats(subscription)
+
+    def test_connect_get_stats_history_disabled(self):
+        domain_path = self.connect.ListDomains(0)[0]
+        with pytest.raises(dbus.exceptions.DBusException) as e:
+            self.connect.GetStatsHistory(domain_path, [], 60)
+        assert e.value.get_dbus_name() == 'org.freedesktop.DBus.Error.NotSupported'
+
+    def test_connect_top_domains(self):
+        domains = self.connect.ListDomains(0)
+        top = self.connect.TopDomains('state.state', 20, 0)
+        assert len(top) == min(20, len(domains))
+        for path, value in top:
+            assert path in domains
+            assert isinstance(value, dbus.Double)
+        values = [value for _, value in top]
+        assert values == sorted(values, reverse=True)
+
+        with pytest.raises(dbus.exceptions.DBusException):
+            self.connect.TopDomains('state.state', 0, 0)
+
     def test_connect_get_capabilities(self):
         assert isinstance(self.connect.GetCapabilities(), dbus.String)
 
+    def test_connect_get_capabilities_cached(self):
+        first = self.connect.GetCapabilities()
+        assert self.connect.GetCapabilities() == first
+        results = self.connect.Batch([
+            (self.connect.object_path, 'org.libvirt.Connect', 'GetCapabilities', []),
+        ])
+        capabilities, error_name, _ = results[0]
+        assert error_name == ''
+        assert capabilities[0] == first
+
     def test_connect_get_cpu_model_names(self):
         arch = "x86_64"
         assert isinstance(self.connect.GetCPUModelNames(arch, 0), dbus.Array)
@@ -113,6 +113,21 @@ class TestDomain(libvirttest.BaseTestClass):
 
         self.main_loop()
 
+    def test_shutdown_properties_changed(self):
+        def properties_changed(interface, changed, invalidated):
+            assert interface == 'org.libvirt.Domain'
+            assert changed['Active'] == dbus.Boolean(False)
+            assert changed['Id'] == dbus.UInt32(0)
+            self.loop.quit()
+
+        obj, domain = self.get_test_domain()
+        obj.connect_to_signal('PropertiesChanged', properties_changed,
+                              dbus_interface=dbus.PROPERTIES_IFACE)
+
+        domain.Shutdown(0)
+
+        self.main_loop()
+
     def test_suspend(self):
         def domain_suspended(path, event, detail):
             if event != libvirttest.DomainEvent.SUSPENDED:
@@ -131,6 +146,43 @@ class TestDomain(libvirttest.BaseTestClass):
 
         self.main_loop()
 
+    def test_domain_state_cache(self):
+        obj, domain = self.get_test_domain()
+        assert domain.GetState(0) == domain.GetState(libvirttest.DomainGetStateFlags.LIVE)
+
+        domain.Suspend()
+        state, _ = domain.GetState(0)
+        assert state == libvirttest.DomainState.PAUSED
+        active = obj.Get('org.libvirt.Domain', 'Active', dbus_interface=dbus.PROPERTIES_IFACE)
+        assert active == dbus.Boolean(True)
+
+        domain.Destroy(0)
+        state, _ = domain.GetState(0)
+        assert state == libvirttest.DomainState.SHUTOFF
+        active = obj.Get('org.libvirt.Domain', 'Active', dbus_interface=dbus.PROPERTIES_IFACE)
+        assert active == dbus.Boolean(False)
+
+    def test_domain_threshold_crossed(self):
+        rule = None
+
+        def threshold_crossed(rule_id, field, value, crossed):
+            assert rule_id == rule
+            assert field == 'state.state'
+            assert value == libvirttest.DomainState.RUNNING
+            assert crossed == dbus.Boolean(True)
+            self.loop.quit()
+
+        obj, domain = self.get_test_domain()
+        domain.connect_to_signal('ThresholdCrossed', threshold_crossed)
+
+        rule = self.connect.AddThresholdRule(
+            'state.state', '==', dbus.Double(libvirttest.DomainState.RUNNING), 0)
+        self.main_loop()
+        self.connect.RemoveThresholdRule(rule)
+
+        with pytest.raises(dbus.exceptions.DBusException):
+            self.connect.RemoveThresholdRule(rule)
+
     def test_undefine(self):
         def domain_undefined(path, event, detail):
             if event != libvirttest.DomainEvent.UNDEFINED:
@@ -147,6 +199,14 @@ class TestDomain(libvirttest.BaseTestClass):
 
         self.main_loop()
 
+    def test_domain_unknown_uuid(self):
+        obj, _ = self.get_test_domain()
+        path = obj.object_path[:obj.object_path.rindex('/')]
+        obj = self.bus.get_object('org.libvirt', path + '/_00000000_0000_0000_0000_000000000000')
+        with pytest.raises(dbus.exceptions.DBusException) as e:
+            obj.Get('org.libvirt.Domain', 'UUID', dbus_interface=dbus.PROPERTIES_IFACE)
+        assert e.value.get_dbus_name() == 'org.libvirt.Error'
+
     def test_domain_vcpus(self):
         obj, domain = self.get_test_domain()
         vcpus_expected = 2
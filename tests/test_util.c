@@ -1,6 +1,13 @@
+#include "history.h"
+#include "stats.h"
+#include "statsfile.h"
+#include "threshold.h"
 #include "util.h"
 
+#include <glib/gstdio.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 static gint
 virtTestEncodeStr(const gchar *input,
@@ -32,6 +39,704 @@ virtTestDecodeStr(const gchar *input,
     return 0;
 }
 
+static gint
+virtTestUUIDFromBusPath(const gchar *path,
+                        const gchar *expected)
+{
+    gchar uuid[VIR_UUID_STRING_BUFLEN] = "";
+    g_autoptr(GError) error = NULL;
+
+    if (!virtDBusUtilUUIDFromBusPath(path, "/org/libvirt/Test/domain",
+                                     uuid, &error)) {
+        if (!expected)
+            return 0;
+        g_printerr("uuid decode failed: %s\n", error->message);
+        return -1;
+    }
+
+    if (!expected || !g_str_equal(uuid, expected)) {
+        g_printerr("uuid decode failed: expected '%s' actual '%s'\n",
+                   VIRT_DBUS_EMPTY_STR(expected), uuid);
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestHistory(void)
+{
+    const gchar *const fields[] = { "cpu.time", "block.*.rd.bytes", NULL };
+    const gchar *const cpuFields[] = { "cpu.*", NULL };
+    g_autoptr(virtDBusHistory) history = NULL;
+    g_autoptr(GVariant) values = NULL;
+    g_autoptr(GVariant) series = NULL;
+    g_autoptr(GVariant) array = NULL;
+    const gdouble *data;
+    const gchar *field;
+    gint64 start;
+    guint resolution;
+    gsize ndata;
+
+    /* Room for two fields only. */
+    history = virtDBusHistoryNew(2 * 17 * 1024, fields);
+
+    virtDBusHistoryAdd(history, "/dom1", "cpu.time", 1000, 1);
+    virtDBusHistoryAdd(history, "/dom1", "cpu.time", 1001, 2);
+    virtDBusHistoryAdd(history, "/dom1", "cpu.time", 1003, 4);
+    virtDBusHistoryAdd(history, "/dom1", "block.0.rd.bytes", 1003, 10);
+
+    values = g_variant_ref_sink(virtDBusHistoryGet(history, "/dom1", cpuFields,
+                                                   1004, 5));
+    if (g_variant_n_children(values) != 1) {
+        g_printerr("history: expected 1 field, got %" G_GSIZE_FORMAT "\n",
+                   g_variant_n_children(values));
+        return -1;
+    }
+
+    series = g_variant_get_child_value(values, 0);
+    g_variant_get(series, "(&sxu@ad)", &field, &start, &resolution, &array);
+    data = g_variant_get_fixed_array(array, &ndata, sizeof(gdouble));
+
+    if (!g_str_equal(field, "cpu.time") || start != 1000 || resolution != 1 ||
+        ndata != 5 || data[0] != 1 || data[1] != 2 || !isnan(data[2]) ||
+        data[3] != 4 || !isnan(data[4])) {
+        g_printerr("history: unexpected values of '%s' from %" G_GINT64_FORMAT "\n",
+                   field, start);
+        return -1;
+    }
+
+    g_clear_pointer(&values, g_variant_unref);
+    g_clear_pointer(&series, g_variant_unref);
+    g_clear_pointer(&array, g_variant_unref);
+
+    /* The minute tier averages all samples of the minute. */
+    values = g_variant_ref_sink(virtDBusHistoryGet(history, "/dom1", cpuFields,
+                                                   1004, 3600));
+    series = g_variant_get_child_value(values, 0);
+    g_variant_get(series, "(&sxu@ad)", &field, &start, &resolution, &array);
+    data = g_variant_get_fixed_array(array, &ndata, sizeof(gdouble));
+
+    if (resolution != 60 || ndata != 60 || data[ndata - 1] != 7.0 / 3) {
+        g_printerr("history: unexpected downsampled values\n");
+        return -1;
+    }
+
+    g_clear_pointer(&values, g_variant_unref);
+    g_clear_pointer(&series, g_variant_unref);
+    g_clear_pointer(&array, g_variant_unref);
+
+    /* The third field is not recorded while the others are updated... */
+    virtDBusHistoryAdd(history, "/dom2", "cpu.time", 1004, 5);
+
+    values = g_variant_ref_sink(virtDBusHistoryGet(history, "/dom2", NULL,
+                                                   1004, 5));
+    if (g_variant_n_children(values) != 0) {
+        g_printerr("history: recent field was evicted\n");
+        return -1;
+    }
+    g_clear_pointer(&values, g_variant_unref);
+
+    /* ... but evicts the one updated longest ago once it gets old. */
+    virtDBusHistoryAdd(history, "/dom1", "block.0.rd.bytes", 1060, 11);
+    virtDBusHistoryAdd(history, "/dom2", "cpu.time", 1063, 5);
+
+    values = g_variant_ref_sink(virtDBusHistoryGet(history, "/dom1", NULL,
+                                                   1063, 5));
+    if (g_variant_n_children(values) != 1) {
+        g_printerr("history: field was not evicted\n");
+        return -1;
+    }
+    g_clear_pointer(&values, g_variant_unref);
+
+    values = g_variant_ref_sink(virtDBusHistoryGet(history, "/dom2", NULL,
+                                                   1063, 5));
+    if (g_variant_n_children(values) != 1) {
+        g_printerr("history: new field was not recorded\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+virtTestThresholdCrossed(const gchar *owner G_GNUC_UNUSED,
+                         const gchar *object G_GNUC_UNUSED,
+                         guint id G_GNUC_UNUSED,
+                         const gchar *field G_GNUC_UNUSED,
+                         gdouble value G_GNUC_UNUSED,
+                         gboolean crossed,
+                         gpointer opaque)
+{
+    gint *state = opaque;
+
+    *state = crossed ? 1 : -1;
+}
+
+static gint
+virtTestThresholdSample(virtDBusThresholds *thresholds,
+                        guint64 value,
+                        gint64 now,
+                        gint expected)
+{
+    g_autoptr(GVariant) record = NULL;
+    GVariantBuilder builder;
+    gint state = 0;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&builder, "{sv}", "block.0.wr.bytes",
+                          g_variant_new_uint64(value));
+    g_variant_builder_add(&builder, "{sv}", "block.0.name",
+                          g_variant_new_string("vda"));
+    record = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+    virtDBusThresholdsEvaluate(thresholds, "/dom1", record, now,
+                               virtTestThresholdCrossed, &state);
+
+    if (state != expected) {
+        g_printerr("threshold at %" G_GINT64_FORMAT ": expected %d actual %d\n",
+                   now, expected, state);
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestThresholds(void)
+{
+    g_autoptr(virtDBusThresholds) thresholds = virtDBusThresholdsNew();
+    g_autoptr(GError) error = NULL;
+    guint id;
+
+    if (virtDBusThresholdsAdd(thresholds, ":1.1", "block.*.wr.bytes", "=>",
+                              0, 0, &error) != 0 || !error) {
+        g_printerr("threshold with invalid comparison was added\n");
+        return -1;
+    }
+
+    /* Crossed after the value stays above 100 for 2 seconds. */
+    id = virtDBusThresholdsAdd(thresholds, ":1.1", "block.*.wr.bytes", ">",
+                               100, 2000, NULL);
+
+    if (virtTestThresholdSample(thresholds, 200, 0, 0) < 0 ||
+        virtTestThresholdSample(thresholds, 50, 1000000, 0) < 0 ||
+        virtTestThresholdSample(thresholds, 200, 2000000, 0) < 0 ||
+        virtTestThresholdSample(thresholds, 200, 3000000, 0) < 0 ||
+        virtTestThresholdSample(thresholds, 200, 4000000, 1) < 0 ||
+        virtTestThresholdSample(thresholds, 200, 5000000, 0) < 0 ||
+        virtTestThresholdSample(thresholds, 100, 6000000, -1) < 0) {
+        return -1;
+    }
+
+    if (virtDBusThresholdsRemove(thresholds, ":1.2", id, NULL) ||
+        !virtDBusThresholdsRemove(thresholds, ":1.1", id, NULL) ||
+        virtDBusThresholdsCount(thresholds) != 0) {
+        g_printerr("threshold removal failed\n");
+        return -1;
+    }
+
+    /* Rules are limited per owner. */
+    for (guint i = 0; i < 256; i++) {
+        if (virtDBusThresholdsAdd(thresholds, ":1.1", "cpu.time", ">",
+                                  0, 0, NULL) == 0) {
+            g_printerr("threshold rule %u was not added\n", i);
+            return -1;
+        }
+    }
+
+    if (virtDBusThresholdsAdd(thresholds, ":1.1", "cpu.time", ">",
+                              0, 0, NULL) != 0 ||
+        virtDBusThresholdsAdd(thresholds, ":1.2", "cpu.time", ">",
+                              0, 0, NULL) == 0) {
+        g_printerr("threshold rules are not limited per owner\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestTopN(void)
+{
+    const gdouble values[] = { 3, 9, 1, 7, 5, 9.5, 0, 8 };
+    const guint expected[] = { 5, 1, 7, 3 };
+    guint top[G_N_ELEMENTS(values)];
+    guint ntop;
+
+    ntop = virtDBusStatsTopN(values, G_N_ELEMENTS(values), 4, top);
+    if (ntop != G_N_ELEMENTS(expected)) {
+        g_printerr("top n: expected %u values, got %u\n",
+                   (guint)G_N_ELEMENTS(expected), ntop);
+        return -1;
+    }
+
+    for (guint i = 0; i < ntop; i++) {
+        if (top[i] != expected[i]) {
+            g_printerr("top n: expected index %u at %u, got %u\n",
+                       expected[i], i, top[i]);
+            return -1;
+        }
+    }
+
+    /* Asking for more than there is sorts all of them. */
+    ntop = virtDBusStatsTopN(values, 3, 10, top);
+    if (ntop != 3 || top[0] != 1 || top[1] != 0 || top[2] != 2) {
+        g_printerr("top n: unexpected order of all values\n");
+        return -1;
+    }
+
+    if (virtDBusStatsTopN(values, 0, 10, top) != 0) {
+        g_printerr("top n: selected from no values\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestStatsFile(void)
+{
+    const gchar *const fields[] = { "cpu.time", "block.*.wr.bytes.rate", NULL };
+    g_autoptr(virtDBusStatsCache) cache = virtDBusStatsCacheNew();
+    g_autoptr(virtDBusStatsFile) file = NULL;
+    g_autoptr(GMappedFile) mapped = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *path = NULL;
+    const virtDBusStatsFileHeader *header;
+    const gchar *names;
+    GStatBuf st;
+
+    dir = g_dir_make_tmp("virt-dbus-XXXXXX", &error);
+    if (!dir) {
+        g_printerr("stats file: %s\n", error->message);
+        return -1;
+    }
+    path = g_build_filename(dir, "Test.stats", NULL);
+
+    file = virtDBusStatsFileNew(path, 1000, fields, &error);
+    if (!file) {
+        g_printerr("stats file: %s\n", error->message);
+        return -1;
+    }
+
+    if (g_stat(path, &st) < 0 || (st.st_mode & 0777) & ~0640) {
+        g_printerr("stats file: readable by other users\n");
+        return -1;
+    }
+
+    if (!virtDBusStatsFileUpdate(file, cache, NULL, 0, 1000, &error)) {
+        g_printerr("stats file: %s\n", error->message);
+        return -1;
+    }
+
+    mapped = g_mapped_file_new(path, FALSE, &error);
+    if (!mapped) {
+        g_printerr("stats file: %s\n", error->message);
+        return -1;
+    }
+
+    header = (const virtDBusStatsFileHeader *)(const void *)g_mapped_file_get_contents(mapped);
+    names = (const gchar *)header + header->fieldsOffset;
+
+    if (memcmp(header->magic, VIRT_DBUS_STATS_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != VIRT_DBUS_STATS_FILE_VERSION ||
+        header->sequence != 2 || header->stale || header->ndomains != 0 ||
+        header->timestamp != 1000 || header->nfields != 2 ||
+        header->slotSize != sizeof(virtDBusStatsFileSlot) + 2 * sizeof(gdouble) ||
+        !g_str_equal(names, "cpu.time") ||
+        !g_str_equal(names + VIRT_DBUS_STATS_FILE_FIELD_LEN, "block.*.wr.bytes.rate")) {
+        g_printerr("stats file: unexpected header\n");
+        return -1;
+    }
+
+    g_clear_pointer(&file, virtDBusStatsFileFree);
+
+    if (!header->stale || g_file_test(path, G_FILE_TEST_EXISTS)) {
+        g_printerr("stats file: not removed\n");
+        return -1;
+    }
+
+    g_rmdir(dir);
+
+    return 0;
+}
+
+static gboolean
+virtTestRateEquals(GVariant *rates,
+                   const gchar *name,
+                   gdouble expected)
+{
+    gdouble rate;
+
+    return rates && g_variant_lookup(rates, name, "d", &rate) &&
+           fabs(rate - expected) < 1e-6;
+}
+
+/* Busy domains may report only some stats groups, alternating records
+ * must not lose the rates of the counters they do not carry. */
+static gint
+virtTestPartialRates(void)
+{
+    g_autoptr(virtDBusStatsCache) cache = virtDBusStatsCacheNew();
+    const gchar *uuid = "c7a5fdbd-edaf-9455-926a-d65c16db1809";
+    virTypedParameter cpu = { .field = "cpu.time", .type = VIR_TYPED_PARAM_ULLONG };
+    virTypedParameter block = { .field = "block.0.rd.bytes", .type = VIR_TYPED_PARAM_ULLONG };
+    g_autoptr(GVariant) rates = NULL;
+
+    cpu.value.ul = 0;
+    rates = virtDBusStatsUpdateRates(cache, uuid, 1, &cpu, 1, 0);
+    block.value.ul = 0;
+    g_clear_pointer(&rates, g_variant_unref);
+    rates = virtDBusStatsUpdateRates(cache, uuid, 1, &block, 1, G_USEC_PER_SEC);
+    if (rates) {
+        g_printerr("partial rates: rates without two samples\n");
+        return -1;
+    }
+
+    /* One second of CPU time in two seconds. */
+    cpu.value.ul = 1000000000;
+    rates = virtDBusStatsUpdateRates(cache, uuid, 1, &cpu, 1, 2 * G_USEC_PER_SEC);
+    if (!virtTestRateEquals(rates, "cpu.utilization", 50)) {
+        g_printerr("partial rates: missing CPU utilization\n");
+        return -1;
+    }
+
+    block.value.ul = 4000;
+    g_clear_pointer(&rates, g_variant_unref);
+    rates = virtDBusStatsUpdateRates(cache, uuid, 1, &block, 1, 3 * G_USEC_PER_SEC);
+    if (!virtTestRateEquals(rates, "block.0.rd.bytes.rate", 2000) ||
+        !virtTestRateEquals(rates, "cpu.utilization", 50)) {
+        g_printerr("partial rates: block record dropped CPU rate\n");
+        return -1;
+    }
+
+    cpu.value.ul = 3000000000;
+    g_clear_pointer(&rates, g_variant_unref);
+    rates = virtDBusStatsUpdateRates(cache, uuid, 1, &cpu, 1, 4 * G_USEC_PER_SEC);
+    if (!virtTestRateEquals(rates, "cpu.utilization", 100) ||
+        !virtTestRateEquals(rates, "block.0.rd.bytes.rate", 2000)) {
+        g_printerr("partial rates: CPU record dropped block rate\n");
+        return -1;
+    }
+
+    /* A restarted domain starts over. */
+    g_clear_pointer(&rates, g_variant_unref);
+    rates = virtDBusStatsUpdateRates(cache, uuid, 2, &cpu, 1, 5 * G_USEC_PER_SEC);
+    if (rates) {
+        g_printerr("partial rates: rates kept after restart\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestCounterDelta(guint64 prev,
+                     guint64 cur,
+                     guint bits,
+                     gboolean known,
+                     guint64 expected)
+{
+    guint64 delta = 0;
+
+    if (virtDBusStatsCounterDelta(prev, cur, bits, &delta) != known ||
+        (known && delta != expected)) {
+        g_printerr("counter delta failed: %" G_GUINT64_FORMAT " -> %"
+                   G_GUINT64_FORMAT " (%u bits) expected %" G_GUINT64_FORMAT
+                   " got %" G_GUINT64_FORMAT "\n",
+                   prev, cur, bits, expected, delta);
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestFieldInGroups(const gchar *field,
+                      guint stats,
+                      gboolean expected)
+{
+    if (virtDBusStatsFieldInGroups(field, stats) != expected) {
+        g_printerr("stats group check failed: field '%s' stats 0x%x expected %d\n",
+                   field, stats, expected);
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestFieldMatches(const gchar *pattern,
+                     const gchar *field,
+                     gboolean expected)
+{
+    if (virtDBusUtilFieldMatches(pattern, field) != expected) {
+        g_printerr("field match failed: pattern '%s' field '%s' expected %d\n",
+                   pattern, field, expected);
+        return -1;
+    }
+
+    return 0;
+}
+
+struct virtTestHandle {
+    gint refs;
+};
+
+static gint
+virtTestHandleRef(gpointer opaque)
+{
+    struct virtTestHandle *handle = opaque;
+    handle->refs++;
+    return 0;
+}
+
+static gint
+virtTestHandleFree(gpointer opaque)
+{
+    struct virtTestHandle *handle = opaque;
+    handle->refs--;
+    return 0;
+}
+
+static gint
+virtTestHandleCache(void)
+{
+    g_autoptr(virtDBusUtilHandleCache) cache = NULL;
+    struct virtTestHandle handle = { 1 };
+    virConnectPtr conn = GINT_TO_POINTER(1);
+    virConnectPtr otherConn = GINT_TO_POINTER(2);
+    const gchar *path = "/org/libvirt/Test/domain/_6695eb01_f6a4_8304_79aa_97f2502e193f";
+    guint generation;
+    guint staleGeneration;
+
+    cache = virtDBusUtilHandleCacheNew(virtTestHandleRef, virtTestHandleFree);
+
+    if (virtDBusUtilHandleCacheLookup(cache, path, conn, &generation)) {
+        g_printerr("handle cache: lookup in empty cache succeeded\n");
+        return -1;
+    }
+
+    virtDBusUtilHandleCacheInsert(cache, path, conn, &handle, generation);
+
+    if (virtDBusUtilHandleCacheLookup(cache, path, conn, &generation) != &handle ||
+        handle.refs != 3) {
+        g_printerr("handle cache: cached handle not returned\n");
+        return -1;
+    }
+    handle.refs--;
+
+    if (virtDBusUtilHandleCacheLookup(cache, path, otherConn, &generation) ||
+        handle.refs != 1) {
+        g_printerr("handle cache: handle of other connection returned\n");
+        return -1;
+    }
+
+    virtDBusUtilHandleCacheLookup(cache, path, conn, &staleGeneration);
+    virtDBusUtilHandleCacheRemove(cache, path);
+    virtDBusUtilHandleCacheInsert(cache, path, conn, &handle, staleGeneration);
+
+    if (virtDBusUtilHandleCacheLookup(cache, path, conn, &generation) ||
+        handle.refs != 1) {
+        g_printerr("handle cache: stale handle inserted after removal\n");
+        return -1;
+    }
+
+    /* Filling the cache drops only the oldest handle. */
+    virtDBusUtilHandleCacheInsert(cache, path, conn, &handle, generation);
+    for (guint i = 0; i < 4096; i++) {
+        g_autofree gchar *other = g_strdup_printf("%s_%u", path, i);
+
+        virtDBusUtilHandleCacheLookup(cache, other, conn, &generation);
+        virtDBusUtilHandleCacheInsert(cache, other, conn, &handle, generation);
+    }
+
+    if (virtDBusUtilHandleCacheLookup(cache, path, conn, &generation) ||
+        handle.refs != 4097) {
+        g_printerr("handle cache: oldest handle not dropped\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint
+virtTestXMLCache(void)
+{
+    g_autoptr(virtDBusUtilXMLCache) cache = NULL;
+    g_autofree gchar *xml = NULL;
+    g_autofree gchar *large = NULL;
+    guint generation;
+    guint staleGeneration;
+
+    cache = virtDBusUtilXMLCacheNew(G_USEC_PER_SEC * 60);
+
+    if (virtDBusUtilXMLCacheLookup(cache, "/obj/a", 0, &generation)) {
+        g_printerr("xml cache: lookup in empty cache succeeded\n");
+        return -1;
+    }
+    virtDBusUtilXMLCacheInsert(cache, "/obj/a", 0, "<a/>", generation);
+    virtDBusUtilXMLCacheInsert(cache, "/obj/a", 1, "<a live/>", generation);
+    virtDBusUtilXMLCacheInsert(cache, "/obj/ab", 0, "<ab/>", generation);
+
+    xml = virtDBusUtilXMLCacheLookup(cache, "/obj/a", 1, &generation);
+    if (g_strcmp0(xml, "<a live/>") != 0) {
+        g_printerr("xml cache: expected '<a live/>', actual '%s'\n", xml);
+        return -1;
+    }
+    g_clear_pointer(&xml, g_free);
+
+    virtDBusUtilXMLCacheLookup(cache, "/obj/c", 0, &staleGeneration);
+    virtDBusUtilXMLCacheRemove(cache, "/obj/a");
+
+    if ((xml = virtDBusUtilXMLCacheLookup(cache, "/obj/a", 0, &generation)) ||
+        (xml = virtDBusUtilXMLCacheLookup(cache, "/obj/a", 1, &generation))) {
+        g_printerr("xml cache: entry survived removal\n");
+        return -1;
+    }
+
+    xml = virtDBusUtilXMLCacheLookup(cache, "/obj/ab", 0, &generation);
+    if (g_strcmp0(xml, "<ab/>") != 0) {
+        g_printerr("xml cache: removal dropped an unrelated entry\n");
+        return -1;
+    }
+    g_clear_pointer(&xml, g_free);
+
+    virtDBusUtilXMLCacheInsert(cache, "/obj/c", 0, "<c/>", staleGeneration);
+    if ((xml = virtDBusUtilXMLCacheLookup(cache, "/obj/c", 0, &generation))) {
+        g_printerr("xml cache: stale description inserted after removal\n");
+        return -1;
+    }
+
+    /* Three 6 MiB descriptions exceed the 16 MiB limit. */
+    large = g_strnfill(6 * 1024 * 1024, 'x');
+    virtDBusUtilXMLCacheLookup(cache, "/obj/large", 0, &generation);
+    virtDBusUtilXMLCacheInsert(cache, "/obj/large", 0, large, generation);
+    virtDBusUtilXMLCacheInsert(cache, "/obj/large", 1, large, generation);
+    virtDBusUtilXMLCacheInsert(cache, "/obj/large", 2, large, generation);
+
+    if ((xml = virtDBusUtilXMLCacheLookup(cache, "/obj/ab", 0, &generation)) ||
+        (xml = virtDBusUtilXMLCacheLookup(cache, "/obj/large", 0, &generation))) {
+        g_printerr("xml cache: oldest entries not evicted\n");
+        return -1;
+    }
+    xml = virtDBusUtilXMLCacheLookup(cache, "/obj/large", 1, &generation);
+    if (!xml) {
+        g_printerr("xml cache: eviction dropped a recent entry\n");
+        return -1;
+    }
+    g_clear_pointer(&xml, g_free);
+
+    g_clear_pointer(&large, g_free);
+    large = g_strnfill(17 * 1024 * 1024, 'x');
+    virtDBusUtilXMLCacheInsert(cache, "/obj/huge", 0, large, generation);
+
+    if ((xml = virtDBusUtilXMLCacheLookup(cache, "/obj/huge", 0, &generation))) {
+        g_printerr("xml cache: entry exceeding the limit was stored\n");
+        return -1;
+    }
+    xml = virtDBusUtilXMLCacheLookup(cache, "/obj/large", 2, &generation);
+    if (!xml) {
+        g_printerr("xml cache: entry exceeding the limit evicted others\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static gpointer
+virtTestFanOutFunc(gpointer item,
+                   gpointer userData G_GNUC_UNUSED)
+{
+    gint value = GPOINTER_TO_INT(item);
+
+    /* Simulate an unresponsive item. */
+    if (value < 0)
+        g_usleep(G_USEC_PER_SEC / 5);
+
+    return g_strdup_printf("%d", value);
+}
+
+static gchar *
+virtTestFanOutKey(gpointer item,
+                  gpointer userData G_GNUC_UNUSED)
+{
+    return g_strdup_printf("%d", GPOINTER_TO_INT(item));
+}
+
+static gpointer *
+virtTestFanOutRun(const gint *values,
+                  guint nvalues,
+                  gboolean *partial)
+{
+    gpointer *items = g_new0(gpointer, nvalues);
+
+    for (guint i = 0; i < nvalues; i++)
+        items[i] = GINT_TO_POINTER(values[i]);
+
+    return virtDBusUtilFanOut(items, nvalues, g_free,
+                              virtTestFanOutFunc, virtTestFanOutKey,
+                              g_free, NULL, G_USEC_PER_SEC / 20, partial);
+}
+
+static gint
+virtTestFanOut(void)
+{
+    gint values[] = { 1, -1, 2, 3 };
+    gpointer *results;
+    gboolean partial;
+
+    results = virtTestFanOutRun(values, G_N_ELEMENTS(values), &partial);
+
+    if (!partial || results[1]) {
+        g_printerr("fan out: slow item was not abandoned\n");
+        return -1;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++) {
+        g_autofree gchar *expected = NULL;
+
+        if (values[i] < 0)
+            continue;
+
+        expected = g_strdup_printf("%d", values[i]);
+        if (g_strcmp0(results[i], expected) != 0) {
+            g_printerr("fan out: expected '%s', actual '%s'\n",
+                       expected, (gchar *)results[i]);
+            return -1;
+        }
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++)
+        g_free(results[i]);
+    g_free(results);
+
+    /* The slow item is skipped until it is forgotten. */
+    results = virtTestFanOutRun(values, G_N_ELEMENTS(values), &partial);
+    if (partial || results[1] || g_strcmp0(results[0], "1") != 0) {
+        g_printerr("fan out: timed out item was not skipped\n");
+        return -1;
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++)
+        g_free(results[i]);
+    g_free(results);
+
+    virtDBusUtilFanOutForget("-1");
+
+    results = virtTestFanOutRun(values, G_N_ELEMENTS(values), &partial);
+    if (!partial) {
+        g_printerr("fan out: forgotten item was skipped\n");
+        return -1;
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++)
+        g_free(results[i]);
+    g_free(results);
+
+    return 0;
+}
+
 gint
 main(void)
 {
@@ -45,5 +750,88 @@ main(void)
     TEST_ENCODE_DECODE("_", "_5f");
     TEST_ENCODE_DECODE("/path/to/some/file.img", "_2fpath_2fto_2fsome_2ffile_2eimg");
 
+#define TEST_UUID_FROM_BUS_PATH(path, uuid) \
+    if (virtTestUUIDFromBusPath(path, uuid) < 0) \
+        return EXIT_FAILURE;
+
+    TEST_UUID_FROM_BUS_PATH("/org/libvirt/Test/domain/_6695eb01_f6a4_8304_79aa_97f2502e193f",
+                            "6695eb01-f6a4-8304-79aa-97f2502e193f");
+    TEST_UUID_FROM_BUS_PATH("/org/libvirt/Test/domain/_6695eb01", NULL);
+    TEST_UUID_FROM_BUS_PATH("/org/libvirt/Test/network/_6695eb01_f6a4_8304_79aa_97f2502e193f",
+                            NULL);
+
+#define TEST_FIELD_MATCHES(pattern, field, expected) \
+    if (virtTestFieldMatches(pattern, field, expected) < 0) \
+        return EXIT_FAILURE;
+
+    TEST_FIELD_MATCHES("block.*.rd.bytes", "block.0.rd.bytes", TRUE);
+    TEST_FIELD_MATCHES("block.*.rd.bytes", "block.12.rd.bytes", TRUE);
+    TEST_FIELD_MATCHES("block.*.rd.bytes", "block.0.rd.reqs", FALSE);
+    TEST_FIELD_MATCHES("block.*.rd.bytes", "block.0.wr.bytes", FALSE);
+    TEST_FIELD_MATCHES("block.*", "block.count", TRUE);
+    TEST_FIELD_MATCHES("*.bytes", "net.1.rx.bytes", TRUE);
+    TEST_FIELD_MATCHES("*", "state.state", TRUE);
+    TEST_FIELD_MATCHES("state.state", "state.state", TRUE);
+    TEST_FIELD_MATCHES("state.state", "state.reason", FALSE);
+    TEST_FIELD_MATCHES("state", "state.state", FALSE);
+    TEST_FIELD_MATCHES("a*b*c", "aXbYbZc", TRUE);
+    TEST_FIELD_MATCHES("a*b*c", "aXbYcZ", FALSE);
+
+#define TEST_FIELD_IN_GROUPS(field, stats, expected) \
+    if (virtTestFieldInGroups(field, stats, expected) < 0) \
+        return EXIT_FAILURE;
+
+    TEST_FIELD_IN_GROUPS("state.state", 0, TRUE);
+    TEST_FIELD_IN_GROUPS("state.state", VIR_DOMAIN_STATS_STATE, TRUE);
+    TEST_FIELD_IN_GROUPS("cpu.time", VIR_DOMAIN_STATS_STATE, FALSE);
+    TEST_FIELD_IN_GROUPS("block.0.rd.bytes",
+                         VIR_DOMAIN_STATS_STATE | VIR_DOMAIN_STATS_BLOCK, TRUE);
+    TEST_FIELD_IN_GROUPS("net.count", VIR_DOMAIN_STATS_BLOCK, FALSE);
+    TEST_FIELD_IN_GROUPS("unknown.field", VIR_DOMAIN_STATS_BLOCK, FALSE);
+    TEST_FIELD_IN_GROUPS("unknown.field", 1U << 31, TRUE);
+
+#define TEST_COUNTER_DELTA(prev, cur, bits, known, expected) \
+    if (virtTestCounterDelta(prev, cur, bits, known, expected) < 0) \
+        return EXIT_FAILURE;
+
+    TEST_COUNTER_DELTA(100, 150, 64, TRUE, 50);
+    TEST_COUNTER_DELTA(100, 100, 32, TRUE, 0);
+    TEST_COUNTER_DELTA(G_MAXUINT32 - 9, 10, 32, TRUE, 20);
+    TEST_COUNTER_DELTA(G_MAXUINT32, 0, 32, TRUE, 1);
+    TEST_COUNTER_DELTA(G_MAXUINT32 - 9, 10, 64, FALSE, 0);
+    TEST_COUNTER_DELTA(G_GUINT64_CONSTANT(1) << 40, 5, 64, FALSE, 0);
+
+    if (virtDBusStatsGroupsForFields(NULL) != 0 ||
+        virtDBusStatsGroupsForFields((const gchar *const []){ "cpu.time", "block.*", NULL }) !=
+        (VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_BLOCK) ||
+        virtDBusStatsGroupsForFields((const gchar *const []){ "cpu.time", "*.bytes", NULL }) != 0) {
+        g_printerr("stats groups for fields failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if (virtTestPartialRates() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestHistory() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestThresholds() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestTopN() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestStatsFile() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestHandleCache() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestXMLCache() < 0)
+        return EXIT_FAILURE;
+
+    if (virtTestFanOut() < 0)
+        return EXIT_FAILURE;
+
     return EXIT_SUCCESS;
 }